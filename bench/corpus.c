@@ -0,0 +1,196 @@
+// Synthetic .cx corpora, scaled to a size in bytes. `bench/corpus <kind> <bytes> [seed]` writes
+// one to stdout, bench/suite generates them in memory. A kind, size and seed always give the same
+// bytes, so numbers measured on them can be compared over time.
+//
+//   functions  many small functions, with a few nested blocks and short expressions each
+//   nesting    functions whose blocks nest thousands of levels deep
+//   tokens     functions returning expressions hundreds of thousands of terms long
+//   strings    functions returning string literals of a megabyte each
+
+#ifndef CORPUS_NO_MAIN
+#define CX_NO_MAIN
+#include "../cx.c"
+#endif
+
+#define CORPUS_NESTING_DEPTH 4096
+#define CORPUS_EXPRESSION_TERMS (256 * 1024)
+#define CORPUS_STRING_SIZE (1024 * 1024)
+
+// xorshift64*
+typedef struct {
+	u64 state;
+} Corpus_Random;
+
+u64 Corpus_Random_next(Corpus_Random *random) {
+	random->state ^= random->state >> 12;
+	random->state ^= random->state << 25;
+	random->state ^= random->state >> 27;
+	return random->state * 0x2545f4914f6cdd1dull;
+}
+
+size_t Corpus_Random_below(Corpus_Random *random, size_t n) {
+	return Corpus_Random_next(random) % n;
+}
+
+const char *corpus_types[] = { "b8", "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "f32", "f64" };
+const char *corpus_binary_operators[] = { "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "&&", "||", "==", "!=", "<", "<=", ">", ">=" };
+const char *corpus_prefix_operators[] = { "-", "!", "~" };
+const char *corpus_literal_operators[] = { "+", "-", "*" };
+
+#define CORPUS_PICK(random, table) (table)[Corpus_Random_below(random, sizeof(table) / sizeof((table)[0]))]
+
+// Literals only meet other literals in small sums and products, which cx folds, so every operator
+// over constants is well defined whatever operators the expression around it picks
+void corpus_operand(DARRAY(char) *out, Corpus_Random *random) {
+	switch(Corpus_Random_below(random, 8)) {
+		case 0:
+			sb_append_cstr(out, CORPUS_PICK(random, corpus_prefix_operators));
+			sb_append_cstr(out, "value_");
+			sb_append_int(out, Corpus_Random_below(random, 64));
+			break;
+		case 1:
+		case 2:
+			sb_append_char(out, '(');
+			sb_append_int(out, Corpus_Random_below(random, 1000));
+			sb_append_char(out, ' ');
+			sb_append_cstr(out, CORPUS_PICK(random, corpus_literal_operators));
+			sb_append_char(out, ' ');
+			sb_append_int(out, Corpus_Random_below(random, 1000));
+			sb_append_cstr(out, " + value_");
+			sb_append_int(out, Corpus_Random_below(random, 64));
+			sb_append_char(out, ')');
+			break;
+		default:
+			sb_append_cstr(out, "value_");
+			sb_append_int(out, Corpus_Random_below(random, 64));
+			break;
+	}
+}
+
+void corpus_expression(DARRAY(char) *out, Corpus_Random *random, size_t terms) {
+	corpus_operand(out, random);
+	for(size_t i = 1; i < terms; ++i) {
+		sb_append_char(out, ' ');
+		sb_append_cstr(out, CORPUS_PICK(random, corpus_binary_operators));
+		sb_append_char(out, ' ');
+		corpus_operand(out, random);
+	}
+}
+
+void corpus_function_header(DARRAY(char) *out, Corpus_Random *random, const char *name, size_t i) {
+	sb_append_cstr(out, CORPUS_PICK(random, corpus_types));
+	sb_append_char(out, ' ');
+	sb_append_cstr(out, name);
+	sb_append_int(out, i);
+	sb_append_cstr(out, "() {\n");
+}
+
+void corpus_functions(DARRAY(char) *out, Corpus_Random *random, size_t size) {
+	for(size_t i = 0; out->len < size; ++i) {
+		corpus_function_header(out, random, "function_", i);
+		size_t statements = 1 + Corpus_Random_below(random, 4);
+		for(size_t j = 0; j < statements; ++j) {
+			size_t depth = Corpus_Random_below(random, 4);
+			sb_append_char(out, '\t');
+			sb_append_chars(out, '{', depth);
+			sb_append_cstr(out, " return ");
+			corpus_expression(out, random, 1 + Corpus_Random_below(random, 8));
+			sb_append_cstr(out, "; ");
+			sb_append_chars(out, '}', depth);
+			sb_append_char(out, '\n');
+		}
+		sb_append_cstr(out, "}\n\n");
+	}
+}
+
+void corpus_nesting(DARRAY(char) *out, Corpus_Random *random, size_t size) {
+	for(size_t i = 0; out->len < size; ++i) {
+		corpus_function_header(out, random, "nested_", i);
+		for(size_t depth = 0; depth < CORPUS_NESTING_DEPTH; ++depth) {
+			sb_append_char(out, '{');
+			if(depth % 64 == 63) { // a statement every now and then, so not every block is empty
+				sb_append_cstr(out, " return ");
+				corpus_expression(out, random, 2);
+				sb_append_cstr(out, "; ");
+			}
+		}
+		sb_append_chars(out, '}', CORPUS_NESTING_DEPTH);
+		sb_append_cstr(out, "\n}\n\n");
+	}
+}
+
+void corpus_tokens(DARRAY(char) *out, Corpus_Random *random, size_t size) {
+	for(size_t i = 0; out->len < size; ++i) {
+		corpus_function_header(out, random, "expression_", i);
+		sb_append_cstr(out, "\treturn ");
+		corpus_expression(out, random, CORPUS_EXPRESSION_TERMS);
+		sb_append_cstr(out, ";\n}\n\n");
+	}
+}
+
+void corpus_strings(DARRAY(char) *out, Corpus_Random *random, size_t size) {
+	for(size_t i = 0; out->len < size; ++i) {
+		corpus_function_header(out, random, "text_", i);
+		sb_append_cstr(out, "\treturn \"");
+		DARRAY_RESERVE(char)(out, out->len + CORPUS_STRING_SIZE + 16);
+		for(size_t j = 0; j < CORPUS_STRING_SIZE; ++j) {
+			char c = ' ' + Corpus_Random_below(random, 95);
+			if(c == '"' || c == '\\') {
+				out->data[out->len++] = '\\';
+				++j;
+			}
+			out->data[out->len++] = c;
+		}
+		sb_append_cstr(out, "\";\n}\n\n");
+	}
+}
+
+typedef struct {
+	const char *name;
+	void (*generate)(DARRAY(char) *out, Corpus_Random *random, size_t size);
+	bool few_nodes; // a handful of nodes per megabyte, so the parser is measured in bytes/s
+} Corpus_Kind;
+
+const Corpus_Kind corpus_kinds[] = {
+	{ "functions", corpus_functions, false },
+	{ "nesting", corpus_nesting, false },
+	{ "tokens", corpus_tokens, false },
+	{ "strings", corpus_strings, true },
+};
+
+#define CORPUS_KIND_COUNT (sizeof(corpus_kinds) / sizeof(corpus_kinds[0]))
+
+const Corpus_Kind *corpus_kind(const char *name) {
+	for(size_t i = 0; i < CORPUS_KIND_COUNT; ++i)
+		if(strcmp(corpus_kinds[i].name, name) == 0) return &corpus_kinds[i];
+	return NULL;
+}
+
+// At least `size` bytes of the corpus, ending at a function boundary
+void corpus_generate(DARRAY(char) *out, const Corpus_Kind *kind, size_t size, u64 seed) {
+	Corpus_Random random = { .state = seed * 0x9e3779b97f4a7c15ull + 1 };
+	out->len = 0;
+	kind->generate(out, &random, size);
+}
+
+#ifndef CORPUS_NO_MAIN
+
+int main(int argc, char **argv) {
+	if(argc < 3 || !corpus_kind(argv[1])) {
+		fprintf(stderr, "Usage: %s <kind> <bytes> [seed]\n", argv[0]);
+		fprintf(stderr, "Kinds:");
+		for(size_t i = 0; i < CORPUS_KIND_COUNT; ++i) fprintf(stderr, " %s", corpus_kinds[i].name);
+		fprintf(stderr, "\n");
+		return 1;
+	}
+
+	DARRAY(char) out;
+	DARRAY_INIT(char)(&out, 1024 * 1024);
+	corpus_generate(&out, corpus_kind(argv[1]), strtoull(argv[2], NULL, 10), argc > 3 ? strtoull(argv[3], NULL, 10) : 0);
+	fwrite(out.data, 1, out.len, stdout);
+	DARRAY_FREE(char)(&out);
+
+	return 0;
+}
+
+#endif // CORPUS_NO_MAIN
@@ -0,0 +1,44 @@
+// Microbenchmark for HashMap: average insert and lookup cost as the table grows.
+// The cost per operation should stay flat, independent of the number of keys.
+
+#define CX_NO_MAIN
+#include "../cx.c"
+
+int main(void) {
+	const size_t max_keys = 1000000;
+	const size_t key_size = 16;
+
+	char *key_storage = malloc(max_keys * key_size);
+	StringView *keys = malloc(max_keys * sizeof(StringView));
+	for(size_t i = 0; i < max_keys; ++i) {
+		keys[i].data = key_storage + i * key_size;
+		keys[i].size = snprintf(keys[i].data, key_size, "key_%zu", i);
+	}
+
+	printf("%10s %14s %14s\n", "keys", "put ns/op", "at ns/op");
+
+	for(size_t n = 1000; n <= max_keys; n *= 10) {
+		HashMap h;
+		HashMap_init(&h);
+
+		u64 start = clock_wall_ns();
+		for(size_t i = 0; i < n; ++i) HashMap_put(&h, keys[i], keys[i]);
+		double put_time = (clock_wall_ns() - start) / 1e9;
+
+		size_t found = 0;
+		start = clock_wall_ns();
+		for(size_t i = 0; i < n; ++i) found += HashMap_at(&h, keys[(i * 7919) % n]) != NULL;
+		double at_time = (clock_wall_ns() - start) / 1e9;
+
+		if(found != n) panic("HashMap lost keys: found %zu out of %zu\n", found, n);
+
+		printf("%10zu %14.1f %14.1f\n", n, put_time * 1e9 / n, at_time * 1e9 / n);
+
+		HashMap_free(&h);
+	}
+
+	free(keys);
+	free(key_storage);
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+// Lexer throughput: tokenizes synthetic sources held in memory and reports MB/s.
+
+#define CX_NO_MAIN
+#include "../cx.c"
+
+// Roughly what generated code looks like: indentation, long names, comments and string literals
+const char *mixed_snippet =
+	"// ---------------------------------------------------------------------------------\n"
+	"// generated from schema entry %zu, do not edit by hand\n"
+	"// ---------------------------------------------------------------------------------\n"
+	"i32 generated_function_name_number_%zu() {\n"
+	"\t\treturn 12345;\n"
+	"\t\t{ return (first_operand + second_operand) * some_coefficient - 42 / divisor; }\n"
+	"\t\tprint(\"a fairly long string literal with an escaped \\\"quote\\\" and some more text in it\", 'c', x += y <= z);\n"
+	"}\n\n";
+
+void append_mixed(DARRAY(char) *source) {
+	source->len += snprintf(source->data + source->len, source->_allocated - source->len, mixed_snippet, source->len, source->len);
+}
+
+// Embedded data: long comments, deep indentation and big string literals
+void append_literals(DARRAY(char) *source) {
+	const size_t line_count = 16, line_size = 200;
+	for(size_t i = 0; i < line_count && source->len + line_size + 8 < source->_allocated; ++i) {
+		source->data[source->len++] = '/';
+		source->data[source->len++] = '/';
+		for(size_t j = 0; j < line_size; ++j) source->data[source->len++] = 'a' + (j + i) % 26;
+		source->data[source->len++] = '\n';
+	}
+	for(size_t i = 0; i < 64; ++i) source->data[source->len++] = i % 16 ? ' ' : '\n';
+	source->data[source->len++] = '"';
+	for(size_t i = 0; i < line_count * line_size && source->len + 4 < source->_allocated; ++i)
+		source->data[source->len++] = i % 97 == 96 ? '\\' : ' ' + i % 90 + (i % 90 == 2); // no lone quotes
+	source->data[source->len++] = '"';
+	source->data[source->len++] = '\n';
+}
+
+void run(char *name, void (*append)(DARRAY(char)*)) {
+	const size_t target_size = 32 * 1024 * 1024;
+	const int runs = 5;
+
+	DARRAY(char) source;
+	DARRAY_INIT(char)(&source, target_size + 8 * 1024);
+	while(source.len < target_size) append(&source);
+
+	Symbols_init(); // interned names point into the source
+
+	double best = 0;
+	size_t token_count = 0;
+	for(int run = 0; run < runs; ++run) {
+		Lexer lexer = {
+			.file = 0,
+			.source = source.data,
+			.source_len = source.len,
+			.eof = false
+		};
+
+		token_count = 0;
+		u64 start = clock_wall_ns();
+		while(Lexer_is_not_empty(&lexer)) {
+			Token token = Lexer_next_token(&lexer);
+			token_count += token.type != TOKEN_NULL;
+		}
+		double elapsed = (clock_wall_ns() - start) / 1e9;
+
+		if(!best || elapsed < best) best = elapsed;
+	}
+
+	printf("lexer %-9s %zu bytes, %zu tokens, best of %d: %.3f s, %.1f MB/s, %.1f Mtokens/s\n",
+		name, source.len, token_count, runs, best, source.len / best / 1e6, token_count / best / 1e6);
+
+	Symbols_free();
+	DARRAY_FREE(char)(&source);
+}
+
+int main(void) {
+	run("mixed", append_mixed);
+	run("literals", append_literals);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+// Stress: runs every pass over a function nested 1M blocks deep and over a 1M term expression,
+// none of them may recurse per nesting level. Reports the time of each pass and the peak RSS.
+
+#define CX_NO_MAIN
+#include "../cx.c"
+
+// i32 main() { { { ... { return 0; } ... } } }
+void generate_nested(DARRAY(char) *source, size_t depth) {
+	sb_append_cstr(source, "i32 main() ");
+	for(size_t i = 0; i < depth; ++i) DARRAY_PUSH(char)(source, '{');
+	sb_append_cstr(source, " return 0; ");
+	for(size_t i = 0; i < depth; ++i) DARRAY_PUSH(char)(source, '}');
+	DARRAY_PUSH(char)(source, '\n');
+}
+
+// i32 main(i32 x) { return -(-(-(... x + 1 + ... + 1 ...))); }
+// x is not a constant, so the chain is not folded away before code generation
+void generate_chain(DARRAY(char) *source, size_t terms) {
+	sb_append_cstr(source, "i32 main(i32 x) { return ");
+	for(size_t i = 0; i < terms / 2; ++i) sb_append_cstr(source, "-(");
+	sb_append_cstr(source, "x");
+	for(size_t i = 1; i < terms / 2; ++i) sb_append_cstr(source, " + 1");
+	for(size_t i = 0; i < terms / 2; ++i) DARRAY_PUSH(char)(source, ')');
+	sb_append_cstr(source, "; }\n");
+}
+
+void run(char *name, void (*generate)(DARRAY(char)*, size_t), size_t n) {
+	DARRAY(char) source;
+	DARRAY_INIT(char)(&source, 8 * n + 64);
+	generate(&source, n);
+
+	Symbols_init(); // interned names point into the source
+
+	// number literals are read back from their source file
+	SourceFile file = { .path = name, .data = source.data, .len = source.len };
+	DARRAY_INIT(SourceFile)(&source_files, 1);
+	DARRAY_PUSH(SourceFile)(&source_files, file);
+
+	SymbolMap data_type_translations;
+	SymbolMap_init(&data_type_translations);
+	SymbolMap_put(&data_type_translations, SYMBOL_I32, Symbol_intern(sv_from_cstr("signed int")));
+
+	Lexer lexer = {
+		.file = 0,
+		.source = source.data,
+		.source_len = source.len,
+		.eof = false
+	};
+
+	TokenStream tokens;
+	CX_AST ast;
+	Parser parser;
+	TokenStream_init(&tokens, lexer);
+	CX_AST_init(&ast, 0, 2 * n + 16);
+	Parser_init(&parser, &tokens, &ast);
+
+	CX_AST_walk_peak_depth = 0;
+	u64 start = clock_wall_ns();
+	CX_AST_Index function = Parser_next_root_child(&parser);
+	if(!function) panic("parsing failed for %s %zu\n", name, n);
+	ast.root = CX_AST_push_node(&ast, CX_AST_NODE_TYPE_ROOT, (Token) { 0 }, &function, 1);
+	u64 parsed = clock_wall_ns();
+
+	SemanticStructure semantic_structure = {
+		.data_type_translations = &data_type_translations
+	};
+	analyse_semantics(&ast, &semantic_structure);
+	u64 analysed = clock_wall_ns();
+
+	Constants constants;
+	if(!evaluate_constants(&ast, &constants)) panic("constant evaluation failed for %s %zu\n", name, n);
+	u64 evaluated = clock_wall_ns();
+
+	FILE *null = fopen("/dev/null", "w");
+	if(!null) panic("opening /dev/null failed: %s\n", strerror(errno));
+
+	CodeGenerator code_gen = {
+		.data_type_translations = &data_type_translations,
+		.constants = &constants
+	};
+	generate_code(&code_gen, &ast, null);
+	u64 generated = clock_wall_ns();
+
+	CX_AST_print_json(&ast, ast.root, null);
+	u64 dumped = clock_wall_ns();
+
+	fclose(null);
+
+	printf("nesting %-6s n = %zu, %zu nodes: parse %.3f s, analyse %.3f s, evaluate %.3f s, generate %.3f s, dump %.3f s, walked %zu deep, peak RSS %zu KB\n",
+		name, n, ast.kinds.len, (parsed - start) / 1e9, (analysed - parsed) / 1e9, (evaluated - analysed) / 1e9, (generated - evaluated) / 1e9,
+		(dumped - generated) / 1e9, CX_AST_walk_peak_depth, peak_rss_bytes() / 1024);
+
+	Parser_free(&parser);
+	Constants_free(&constants);
+	CX_AST_free(&ast);
+	TokenStream_free(&tokens);
+	SymbolMap_free(&data_type_translations);
+	Symbols_free();
+	DARRAY_FREE(SourceFile)(&source_files);
+	DARRAY_FREE(char)(&source);
+}
+
+int main(void) {
+	run("blocks", generate_nested, 1000000);
+	run("chain", generate_chain, 1000000);
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+// Parser scaling: parses one function built around a construct repeated `n` times and reports
+// the time per repetition, which should stay flat as `n` grows.
+
+#define CX_NO_MAIN
+#include "../cx.c"
+
+// i32 main() { { { ... { return 0; } { return 1; } ... } } }
+void generate_nested(DARRAY(char) *source, size_t depth) {
+	sb_append_cstr(source, "i32 main() ");
+	for(size_t i = 0; i < depth; ++i) DARRAY_PUSH(char)(source, '{');
+	sb_append_cstr(source, " return 0; } { return 1; ");
+	for(size_t i = 0; i < depth; ++i) DARRAY_PUSH(char)(source, '}');
+	DARRAY_PUSH(char)(source, '\n');
+}
+
+// i32 main() { return 1 * 2 + 3 * 4 + ... + (1 - -2) << 3 ...; }
+void generate_chain(DARRAY(char) *source, size_t terms) {
+	const char *operators[] = { " + ", " * ", " - ", " << ", " == ", " && " };
+	sb_append_cstr(source, "i32 main() { return 1");
+	for(size_t i = 1; i < terms; ++i) {
+		sb_append_cstr(source, operators[i % 6]);
+		sb_append_cstr(source, i % 7 ? "2" : "(1 - -2)");
+	}
+	sb_append_cstr(source, "; }\n");
+}
+
+void run(char *name, void (*generate)(DARRAY(char)*, size_t), size_t n) {
+	const int runs = 5;
+
+	DARRAY(char) source;
+	DARRAY_INIT(char)(&source, 16 * n + 64);
+	generate(&source, n);
+
+	Symbols_init(); // interned names point into the source
+
+	double best = 0;
+	size_t node_count = 0, peak_tokens = 0;
+	for(int run = 0; run < runs; ++run) {
+		Lexer lexer = {
+			.file = 0,
+			.source = source.data,
+			.source_len = source.len,
+			.eof = false
+		};
+
+		TokenStream tokens;
+		CX_AST ast;
+		TokenStream_init(&tokens, lexer);
+		CX_AST_init(&ast, 0, 2 * n + 16);
+
+		Parser parser;
+		Parser_init(&parser, &tokens, &ast);
+
+		u64 start = clock_wall_ns();
+		CX_AST_Index root = Parser_next_root_child(&parser);
+		double elapsed = (clock_wall_ns() - start) / 1e9;
+
+		if(!root) panic("parsing failed for %s %zu\n", name, n);
+		node_count = ast.kinds.len;
+		peak_tokens = tokens.peak;
+
+		Parser_free(&parser);
+		CX_AST_free(&ast);
+		TokenStream_free(&tokens);
+
+		if(!best || elapsed < best) best = elapsed;
+	}
+
+	printf("parser %-6s n = %-7zu %zu nodes, at most %zu tokens held, best of %d: %.6f s, %.1f ns/n\n",
+		name, n, node_count, peak_tokens, runs, best, best / n * 1e9);
+
+	Symbols_free();
+	DARRAY_FREE(char)(&source);
+}
+
+int main(void) {
+	for(size_t depth = 1000; depth <= 16000; depth *= 2) run("nested", generate_nested, depth);
+	for(size_t terms = 1000; terms <= 1000000; terms *= 10) run("chain", generate_chain, terms);
+
+	return 0;
+}
@@ -0,0 +1,261 @@
+// Benchmark suite: generates each bench/corpus kind in memory and measures, over several runs,
+// the lexer (MB/s), the parser (AST nodes/s, lexing included as the parser drives it, or MB/s on
+// corpora with few nodes), code generation (bytes/s) and the whole compiler end to end, on a file
+// and through the same path as the command line. Reports the median, minimum, mean and standard
+// deviation of every measurement on stderr and writes them all as JSON, to stdout or to --json
+// <file>.
+//
+// Usage: bench/suite [--size <MB>] [--runs <N>] [--json <file>] [kind...]
+
+#define CX_NO_MAIN
+#include "../cx.c"
+
+#define CORPUS_NO_MAIN
+#include "corpus.c"
+
+#include <math.h>
+
+#define SUITE_DEFAULT_SIZE (16 * 1024 * 1024)
+#define SUITE_DEFAULT_RUNS 7
+#define SUITE_MAX_RUNS 64
+
+typedef struct {
+	double seconds[SUITE_MAX_RUNS]; // sorted once all runs are in
+	double median, min, mean, stddev;
+} Samples;
+
+int compare_doubles(const void *a, const void *b) {
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+void Samples_summarize(Samples *samples, int runs) {
+	qsort(samples->seconds, runs, sizeof(double), compare_doubles);
+	samples->min = samples->seconds[0];
+	samples->median = runs % 2 ? samples->seconds[runs / 2] : (samples->seconds[runs / 2 - 1] + samples->seconds[runs / 2]) / 2;
+
+	double sum = 0, squares = 0;
+	for(int i = 0; i < runs; ++i) sum += samples->seconds[i];
+	samples->mean = sum / runs;
+	for(int i = 0; i < runs; ++i) squares += (samples->seconds[i] - samples->mean) * (samples->seconds[i] - samples->mean);
+	samples->stddev = runs > 1 ? sqrt(squares / (runs - 1)) : 0;
+}
+
+typedef struct {
+	const Corpus_Kind *kind;
+	size_t bytes, tokens, nodes, output_bytes;
+	Samples lexer, parser, codegen, end_to_end;
+} Result;
+
+double seconds_since(u64 start) {
+	return (clock_wall_ns() - start) / 1e9;
+}
+
+double measure_lexer(DARRAY(char) *source, Result *result) {
+	Symbols_init_from_seed();
+	Lexer lexer = {
+		.file = 0,
+		.source = source->data,
+		.source_len = source->len,
+		.eof = false
+	};
+
+	size_t tokens = 0;
+	u64 start = clock_wall_ns();
+	while(Lexer_is_not_empty(&lexer)) tokens += Lexer_next_token(&lexer).type != TOKEN_NULL;
+	double seconds = seconds_since(start);
+
+	Symbols_free();
+	result->tokens = tokens;
+	return seconds;
+}
+
+// Parses into `ast`, which code generation goes on with, the caller frees it and the symbols
+double measure_parser(DARRAY(char) *source, CX_AST *ast, Result *result) {
+	Symbols_init_from_seed();
+	Lexer lexer = {
+		.file = 0,
+		.source = source->data,
+		.source_len = source->len,
+		.eof = false
+	};
+
+	TokenStream tokens;
+	Parser parser;
+	TokenStream_init(&tokens, lexer);
+	CX_AST_init(ast, 0, source->len / 8 + 16);
+	Parser_init(&parser, &tokens, ast);
+
+	u64 start = clock_wall_ns();
+	while(!parser.eof && Parser_peek_token(&parser).type != TOKEN_EOF) {
+		CX_AST_Index child = Parser_next_root_child(&parser);
+		if(!child) panic("the %s corpus does not parse\n", result->kind->name);
+		DARRAY_PUSH(u32)(&parser.pending_children, child);
+	}
+	ast->root = CX_AST_push_node(ast, CX_AST_NODE_TYPE_ROOT, (Token) { 0 }, parser.pending_children.data, parser.pending_children.len);
+	double seconds = seconds_since(start);
+
+	Parser_free(&parser);
+	TokenStream_free(&tokens);
+	result->nodes = ast->kinds.len;
+	return seconds;
+}
+
+// Constants are evaluated beforehand, as Unit_compile does, but not measured
+double measure_codegen(CX_AST *ast, FILE *sink, Result *result) {
+	Constants constants;
+	if(!evaluate_constants(ast, &constants)) panic("the %s corpus has invalid constant expressions\n", result->kind->name);
+
+	CodeGenerator code_gen = {
+		.data_type_translations = &data_type_translations,
+		.constants = &constants
+	};
+
+	u64 start = clock_wall_ns();
+	if(!generate_code(&code_gen, ast, sink)) panic("generating code failed: %s\n", strerror(errno));
+	double seconds = seconds_since(start);
+
+	Constants_free(&constants);
+	result->output_bytes = code_gen.bytes_emitted;
+	return seconds;
+}
+
+double measure_end_to_end(char *source_filename) {
+	char *argv[] = { source_filename, "-o", "/dev/null" };
+	u64 start = clock_wall_ns();
+	if(compile_command_line("cx", 3, argv)) panic("compiling the corpus failed\n");
+	return seconds_since(start);
+}
+
+void run(const Corpus_Kind *kind, size_t size, int runs, Result *result) {
+	result->kind = kind;
+
+	DARRAY(char) source;
+	DARRAY_INIT(char)(&source, size + 2 * CORPUS_STRING_SIZE);
+	corpus_generate(&source, kind, size, 0);
+	result->bytes = source.len;
+
+	// the lexer and parser read source_files through diagnostics, the corpus is file 0
+	SourceFile file = { .path = (char*) kind->name, .data = source.data, .len = source.len };
+	DARRAY_INIT(SourceFile)(&source_files, 1);
+	DARRAY_PUSH(SourceFile)(&source_files, file);
+
+	char source_filename[] = "/tmp/cx-bench-XXXXXX";
+	int fd = mkstemp(source_filename);
+	if(fd < 0 || !write_all(fd, source.data, source.len)) panic("writing the %s corpus failed: %s\n", kind->name, strerror(errno));
+	close(fd);
+
+	FILE *null = fopen("/dev/null", "w");
+	if(!null) panic("opening /dev/null failed: %s\n", strerror(errno));
+
+	for(int i = -1; i < runs; ++i) { // run -1 warms up caches and the allocator
+		double lexer = measure_lexer(&source, result);
+
+		CX_AST ast;
+		double parser = measure_parser(&source, &ast, result);
+		double codegen = measure_codegen(&ast, null, result);
+		CX_AST_free(&ast);
+		Symbols_free();
+
+		DARRAY_FREE(SourceFile)(&source_files); // compile_command_line opens the file itself
+		double end_to_end = measure_end_to_end(source_filename);
+		DARRAY_INIT(SourceFile)(&source_files, 1);
+		DARRAY_PUSH(SourceFile)(&source_files, file);
+
+		if(i < 0) continue;
+		result->lexer.seconds[i] = lexer;
+		result->parser.seconds[i] = parser;
+		result->codegen.seconds[i] = codegen;
+		result->end_to_end.seconds[i] = end_to_end;
+	}
+
+	Samples_summarize(&result->lexer, runs);
+	Samples_summarize(&result->parser, runs);
+	Samples_summarize(&result->codegen, runs);
+	Samples_summarize(&result->end_to_end, runs);
+
+	char parser_rate[32];
+	if(kind->few_nodes) snprintf(parser_rate, sizeof(parser_rate), "%8.1f MB/s    ", result->bytes / result->parser.median / 1e6);
+	else snprintf(parser_rate, sizeof(parser_rate), "%8.2f Mnodes/s", result->nodes / result->parser.median / 1e6);
+	fprintf(stderr, "%-9s %6.1f MB  lexer %8.1f MB/s  parser %s  codegen %8.1f MB/s  end to end %7.3f s (±%.1f%%)\n",
+		kind->name, result->bytes / 1e6, result->bytes / result->lexer.median / 1e6, parser_rate,
+		result->output_bytes / result->codegen.median / 1e6, result->end_to_end.median, 100 * result->end_to_end.stddev / result->end_to_end.mean);
+
+	fclose(null);
+	remove(source_filename);
+	DARRAY_FREE(SourceFile)(&source_files);
+	DARRAY_FREE(char)(&source);
+}
+
+void Samples_print_json(FILE *sink, const char *name, Samples *samples, const char *rate_name, double amount) {
+	fprintf(sink, "\"%s\":{\"median_s\":%.9f,\"min_s\":%.9f,\"mean_s\":%.9f,\"stddev_s\":%.9f,\"%s\":%.1f}",
+		name, samples->median, samples->min, samples->mean, samples->stddev, rate_name, amount / samples->median);
+}
+
+void print_json(FILE *sink, Result *results, size_t count, int runs) {
+	fprintf(sink, "{\"cx_build\":\"%s\",\"runs\":%d,\"results\":[", CX_BUILD_ID, runs);
+	for(size_t i = 0; i < count; ++i) {
+		Result *result = &results[i];
+		fprintf(sink, "%s\n{\"corpus\":\"%s\",\"bytes\":%zu,\"tokens\":%zu,\"nodes\":%zu,\"output_bytes\":%zu,",
+			i ? "," : "", result->kind->name, result->bytes, result->tokens, result->nodes, result->output_bytes);
+		Samples_print_json(sink, "lexer", &result->lexer, "bytes_per_s", result->bytes);
+		putc(',', sink);
+		if(result->kind->few_nodes) Samples_print_json(sink, "parser", &result->parser, "bytes_per_s", result->bytes);
+		else Samples_print_json(sink, "parser", &result->parser, "nodes_per_s", result->nodes);
+		putc(',', sink);
+		Samples_print_json(sink, "codegen", &result->codegen, "bytes_per_s", result->output_bytes);
+		putc(',', sink);
+		Samples_print_json(sink, "end_to_end", &result->end_to_end, "bytes_per_s", result->bytes);
+		putc('}', sink);
+	}
+	fprintf(sink, "\n]}\n");
+}
+
+int main(int argc, char **argv) {
+	char *program_name = consume_arg(&argc, &argv);
+	size_t size = SUITE_DEFAULT_SIZE;
+	int runs = SUITE_DEFAULT_RUNS;
+	char *json_filename = NULL;
+	const Corpus_Kind *kinds[CORPUS_KIND_COUNT];
+	size_t kind_count = 0;
+
+	while(argc) {
+		char *flag = consume_arg(&argc, &argv);
+		if(streq(flag, "--size") && argc) {
+			size = strtoull(consume_arg(&argc, &argv), NULL, 10) * 1024 * 1024;
+		} else if(streq(flag, "--runs") && argc) {
+			runs = atoi(consume_arg(&argc, &argv));
+		} else if(streq(flag, "--json") && argc) {
+			json_filename = consume_arg(&argc, &argv);
+		} else if(corpus_kind(flag) && kind_count < CORPUS_KIND_COUNT) {
+			kinds[kind_count++] = corpus_kind(flag);
+		} else {
+			fprintf(stderr, "Usage: %s [--size <MB>] [--runs <N>] [--json <file>] [kind...]\n", program_name);
+			return 1;
+		}
+	}
+	if(runs < 1 || runs > SUITE_MAX_RUNS || !size) {
+		fprintf(stderr, "%s: --runs must be between 1 and %d, --size positive\n", program_name, SUITE_MAX_RUNS);
+		return 1;
+	}
+	if(!kind_count)
+		for(; kind_count < CORPUS_KIND_COUNT; ++kind_count) kinds[kind_count] = &corpus_kinds[kind_count];
+
+	Symbols_init();
+	data_type_translations_init();
+	Symbols_seed();
+	Symbols_free();
+
+	fprintf(stderr, "median of %d runs on %zu MB corpora\n", runs, size / (1024 * 1024));
+	Result results[CORPUS_KIND_COUNT] = { 0 };
+	for(size_t i = 0; i < kind_count; ++i) run(kinds[i], size, runs, &results[i]);
+
+	FILE *json = json_filename ? fopen(json_filename, "w") : stdout;
+	if(!json) panic("opening %s failed: %s\n", json_filename, strerror(errno));
+	print_json(json, results, kind_count, runs);
+	if(json != stdout) fclose(json);
+
+	SymbolMap_free(&data_type_translations);
+	HashMap_free(&seed_symbols);
+	return 0;
+}
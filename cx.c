@@ -1,12 +1,33 @@
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h>
+#include <setjmp.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <pthread.h>
+#	include <signal.h>
+#	include <sys/mman.h>
+#	include <sys/resource.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#	include <time.h>
+#	include <unistd.h>
+#	include <utime.h>
+#endif
+
 // debug
 
 #define DEBUG 0
@@ -19,14 +40,33 @@
 
 // helpers
 
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t i64;
+
+// Files are compiled on several threads at once, diagnostics hold the stream while they print
+#ifdef _WIN32
+#	define lock_stream(stream) _lock_file(stream)
+#	define unlock_stream(stream) _unlock_file(stream)
+#else
+#	define lock_stream(stream) flockfile(stream)
+#	define unlock_stream(stream) funlockfile(stream)
+#endif
+
 void info(char *format, ...) {
 	va_list val;
 	va_start(val, format);
+	lock_stream(stderr);
 	fprintf(stderr, "info: ");
 	vfprintf(stderr, format, val);
+	unlock_stream(stderr);
 	va_end(val);
 }
 
+_Thread_local size_t error_count = 0; // errors reported by this thread
+
 // void warn(char *format, ...) {
 // 	va_list val;
 // 	va_start(val, format);
@@ -38,20 +78,33 @@ void info(char *format, ...) {
 void error(char *format, ...) {
 	va_list val;
 	va_start(val, format);
+	++error_count;
+	lock_stream(stderr);
 	fprintf(stderr, "error: ");
 	vfprintf(stderr, format, val);
+	unlock_stream(stderr);
 	va_end(val);
 }
 
+// Where panics on this thread unwind to instead of exiting, set by Unit_try_compile and the server
+_Thread_local jmp_buf *panic_handler = NULL;
+
 void panic(char *format, ...) {
 	va_list val;
 	va_start(val, format);
+	lock_stream(stderr);
 	fprintf(stderr, "fatal error: ");
 	vfprintf(stderr, format, val);
+	unlock_stream(stderr);
 	va_end(val);
+	if(panic_handler) longjmp(*panic_handler, 1);
 	exit(1);
 }
 
+bool streq(char *a, char *b) {
+	return strcmp(a, b) == 0;
+}
+
 char *consume_arg(int *argc, char ***argv)
 {
 	assert(*argc > 0);
@@ -61,14 +114,149 @@ char *consume_arg(int *argc, char ***argv)
 	return result;
 }
 
+// threads
+
+#ifdef _WIN32
+typedef HANDLE Thread;
+typedef DWORD (WINAPI *Thread_Function)(LPVOID);
+
+bool Thread_start(Thread *thread, Thread_Function function, void *arg) {
+	*thread = CreateThread(NULL, 0, function, arg, 0, NULL);
+	return *thread != NULL;
+}
+
+void Thread_join(Thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+typedef CRITICAL_SECTION Mutex;
+
+void Mutex_init(Mutex *mutex) {
+	InitializeCriticalSection(mutex);
+}
+
+void Mutex_lock(Mutex *mutex) {
+	EnterCriticalSection(mutex);
+}
+
+void Mutex_unlock(Mutex *mutex) {
+	LeaveCriticalSection(mutex);
+}
+
+void Mutex_free(Mutex *mutex) {
+	DeleteCriticalSection(mutex);
+}
+#else
+typedef pthread_t Thread;
+typedef void *(*Thread_Function)(void*);
+
+bool Thread_start(Thread *thread, Thread_Function function, void *arg) {
+	return pthread_create(thread, NULL, function, arg) == 0;
+}
+
+void Thread_join(Thread thread) {
+	pthread_join(thread, NULL);
+}
+
+typedef pthread_mutex_t Mutex;
+
+void Mutex_init(Mutex *mutex) {
+	pthread_mutex_init(mutex, NULL);
+}
+
+void Mutex_lock(Mutex *mutex) {
+	pthread_mutex_lock(mutex);
+}
+
+void Mutex_unlock(Mutex *mutex) {
+	pthread_mutex_unlock(mutex);
+}
+
+void Mutex_free(Mutex *mutex) {
+	pthread_mutex_destroy(mutex);
+}
+#endif
+
+// clocks
+
+// Nanosecond counters for --time-passes and --trace: a monotonic wall clock, the CPU time of the
+// calling thread and of the whole process, and the process' peak resident set size in bytes.
+
+#ifdef _WIN32
+u64 clock_wall_ns(void) {
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (u64) (counter.QuadPart / frequency.QuadPart) * 1000000000ull + (u64) (counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+}
+
+u64 filetime_ns(FILETIME time) {
+	return (((u64) time.dwHighDateTime << 32) | time.dwLowDateTime) * 100;
+}
+
+u64 clock_thread_cpu_ns(void) {
+	FILETIME creation, exit, kernel, user;
+	if(!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+	return filetime_ns(kernel) + filetime_ns(user);
+}
+
+u64 clock_process_cpu_ns(void) {
+	FILETIME creation, exit, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+	return filetime_ns(kernel) + filetime_ns(user);
+}
+
+size_t peak_rss_bytes(void) {
+	PROCESS_MEMORY_COUNTERS counters;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+}
+#else
+u64 timespec_ns(struct timespec time) {
+	return (u64) time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+u64 clock_wall_ns(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return timespec_ns(time);
+}
+
+u64 clock_thread_cpu_ns(void) {
+	struct timespec time;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time)) return 0;
+	return timespec_ns(time);
+}
+
+u64 clock_process_cpu_ns(void) {
+	struct timespec time;
+	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time)) return 0;
+	return timespec_ns(time);
+}
+
+size_t peak_rss_bytes(void) {
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (size_t) usage.ru_maxrss * 1024;
+#endif
+}
+#endif
+
 // darray
 
 #define DARRAY(T) darray_##T
 #define DARRAY_INIT(T) darray_init_##T
 #define DARRAY_PUSH(T) darray_push_##T
+#define DARRAY_RESERVE(T) darray_reserve_##T
 #define DARRAY_FREE(T) darray_free_##T
 #define FORWARD_DECLARE_DARRAY(T)	\
 typedef struct DARRAY(T) DARRAY(T);
+_Thread_local size_t darray_allocations = 0; // reported by --stats
+
 #define DECLARE_DARRAY(T)										\
 																\
 struct DARRAY(T) {												\
@@ -79,18 +267,28 @@ struct DARRAY(T) {												\
 																\
 void DARRAY_INIT(T)(DARRAY(T) *da, size_t n) {					\
 	da->data = malloc(n * sizeof(T));							\
+	++darray_allocations;										\
 	da->len = 0;												\
 	da->_allocated = n;											\
 }																\
 																\
 void DARRAY_PUSH(T)(DARRAY(T) *da, T t) {						\
 	if (da->len == da->_allocated) {							\
-	  da->_allocated *= 2;										\
+	  da->_allocated = da->_allocated ? da->_allocated * 2 : 1;	\
 	  da->data = realloc(da->data, da->_allocated * sizeof(T));	\
+	  ++darray_allocations;										\
 	}															\
 	da->data[da->len++] = t;									\
 }																\
 																\
+void DARRAY_RESERVE(T)(DARRAY(T) *da, size_t n) {				\
+	if(n <= da->_allocated) return;								\
+	while(da->_allocated < n)									\
+	  da->_allocated = da->_allocated ? da->_allocated * 2 : 1;	\
+	da->data = realloc(da->data, da->_allocated * sizeof(T));	\
+	++darray_allocations;										\
+}																\
+																\
 void DARRAY_FREE(T)(DARRAY(T) *da) {							\
 	free(da->data);												\
 	da->data = NULL;											\
@@ -100,6 +298,15 @@ void DARRAY_FREE(T)(DARRAY(T) *da) {							\
 FORWARD_DECLARE_DARRAY(char)
 DECLARE_DARRAY(char)
 
+FORWARD_DECLARE_DARRAY(u8)
+DECLARE_DARRAY(u8)
+
+FORWARD_DECLARE_DARRAY(u32)
+DECLARE_DARRAY(u32)
+
+FORWARD_DECLARE_DARRAY(u64)
+DECLARE_DARRAY(u64)
+
 // StringView
 
 typedef struct {
@@ -129,48 +336,655 @@ bool sveq(StringView a, StringView b) {
 	return sveqp(&a, &b);
 }
 
-// "HashMap"
+// String builder, appends to a DARRAY(char) without going through a format string
+
+void sb_append(DARRAY(char) *sb, const char *data, size_t size) {
+	DARRAY_RESERVE(char)(sb, sb->len + size);
+	memcpy(sb->data + sb->len, data, size);
+	sb->len += size;
+}
+
+void sb_append_cstr(DARRAY(char) *sb, const char *cstr) {
+	sb_append(sb, cstr, strlen(cstr));
+}
+
+void sb_append_sv(DARRAY(char) *sb, StringView sv) {
+	sb_append(sb, sv.data, sv.size);
+}
+
+void sb_append_char(DARRAY(char) *sb, char c) {
+	DARRAY_PUSH(char)(sb, c);
+}
+
+// Appends `count` copies of `c`
+void sb_append_chars(DARRAY(char) *sb, char c, size_t count) {
+	DARRAY_RESERVE(char)(sb, sb->len + count);
+	memset(sb->data + sb->len, c, count);
+	sb->len += count;
+}
+
+void sb_append_int(DARRAY(char) *sb, long long value) {
+	char digits[24];
+	size_t i = sizeof(digits);
+	unsigned long long magnitude = value < 0 ? -(unsigned long long) value : (unsigned long long) value;
+	do {
+		digits[--i] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while(magnitude);
+	if(value < 0) digits[--i] = '-';
+	sb_append(sb, digits + i, sizeof(digits) - i);
+}
+
+// HashMap
+
+u32 sv_hash(StringView sv) {
+	u32 hash = 2166136261u; // FNV-1a
+	for(size_t i = 0; i < sv.size; ++i) {
+		hash ^= (u8) sv.data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
 FORWARD_DECLARE_DARRAY(StringView)
 DECLARE_DARRAY(StringView)
 
+// Open addressing with linear probing. Entries live densely in _from/_to in insertion order,
+// _slots only holds each entry's hash and index, so a probe stays within a cache line or two
+// and growing the table never rehashes the keys.
+
+typedef struct {
+	u32 hash;
+	u32 index; // index into _from/_to plus one, 0 marks an empty slot
+} HashMap_Slot;
+
 typedef struct {
 	DARRAY(StringView) _from, _to;
+	HashMap_Slot *_slots;
+	size_t _capacity; // always a power of two
 } HashMap;
 
+#define HASHMAP_INITIAL_CAPACITY 16
+
 void HashMap_init(HashMap *h) {
 	DARRAY_INIT(StringView)(&h->_from, 1);
 	DARRAY_INIT(StringView)(&h->_to, 1);
+	h->_capacity = HASHMAP_INITIAL_CAPACITY;
+	h->_slots = calloc(h->_capacity, sizeof(HashMap_Slot));
 }
 
-StringView *HashMap_at(HashMap *h, StringView from) {
-	for(size_t i = 0; i < h->_from.len; ++i) {
-		if(sveqp(&h->_from.data[i], &from)) {
-			return &h->_to.data[i];
-		}
+HashMap_Slot *HashMap_find_slot(HashMap *h, StringView *key, u32 hash) {
+	size_t mask = h->_capacity - 1;
+	for(size_t i = hash & mask;; i = (i + 1) & mask) {
+		HashMap_Slot *slot = &h->_slots[i];
+		if(!slot->index) return slot;
+		if(slot->hash == hash && sveqp(&h->_from.data[slot->index - 1], key)) return slot;
 	}
-	return NULL;
 }
 
-void HashMap_put(HashMap *h, StringView from, StringView to) {
-	for(size_t i = 0; i < h->_from.len; ++i) {
-		if(sveqp(&h->_from.data[i], &from)) {
-			h->_to.data[i] = to;
-			return;
-		}
+void HashMap_grow(HashMap *h) {
+	size_t old_capacity = h->_capacity;
+	HashMap_Slot *old_slots = h->_slots;
+
+	h->_capacity *= 2;
+	h->_slots = calloc(h->_capacity, sizeof(HashMap_Slot));
+
+	size_t mask = h->_capacity - 1;
+	for(size_t i = 0; i < old_capacity; ++i) {
+		if(!old_slots[i].index) continue;
+		size_t j = old_slots[i].hash & mask;
+		while(h->_slots[j].index) j = (j + 1) & mask;
+		h->_slots[j] = old_slots[i];
 	}
+
+	free(old_slots);
+}
+
+StringView *HashMap_at(HashMap *h, StringView from) {
+	HashMap_Slot *slot = HashMap_find_slot(h, &from, sv_hash(from));
+	return slot->index ? &h->_to.data[slot->index - 1] : NULL;
+}
+
+// Fills an empty slot returned by HashMap_find_slot, the slot pointer may be stale afterwards
+void HashMap_insert(HashMap *h, HashMap_Slot *slot, u32 hash, StringView from, StringView to) {
 	DARRAY_PUSH(StringView)(&h->_from, from);
 	DARRAY_PUSH(StringView)(&h->_to, to);
+	slot->hash = hash;
+	slot->index = h->_from.len;
+	if(h->_from.len * 2 > h->_capacity) HashMap_grow(h); // keep the load factor at or below 1/2
+}
+
+void HashMap_put(HashMap *h, StringView from, StringView to) {
+	u32 hash = sv_hash(from);
+	HashMap_Slot *slot = HashMap_find_slot(h, &from, hash);
+	if(slot->index) {
+		h->_to.data[slot->index - 1] = to;
+		return;
+	}
+	HashMap_insert(h, slot, hash, from, to);
+}
+
+void HashMap_copy(HashMap *h, HashMap *from) {
+	DARRAY_INIT(StringView)(&h->_from, from->_from._allocated);
+	DARRAY_INIT(StringView)(&h->_to, from->_to._allocated);
+	memcpy(h->_from.data, from->_from.data, from->_from.len * sizeof(StringView));
+	memcpy(h->_to.data, from->_to.data, from->_to.len * sizeof(StringView));
+	h->_from.len = from->_from.len;
+	h->_to.len = from->_to.len;
+	h->_capacity = from->_capacity;
+	h->_slots = malloc(h->_capacity * sizeof(HashMap_Slot));
+	memcpy(h->_slots, from->_slots, h->_capacity * sizeof(HashMap_Slot));
 }
 
 void HashMap_free(HashMap *h) {
 	DARRAY_FREE(StringView)(&h->_from);
 	DARRAY_FREE(StringView)(&h->_to);
+	free(h->_slots);
+	h->_slots = NULL;
+	h->_capacity = 0;
+}
+
+// Symbol
+
+// Every distinct identifier is interned once into a dense id, so later stages compare names
+// as integers. The symbols' names are the keys of the `symbols` HashMap, a symbol is its entry index.
+
+typedef u32 Symbol;
+
+FORWARD_DECLARE_DARRAY(Symbol)
+DECLARE_DARRAY(Symbol)
+
+// Keywords and built-in type names are interned first and in this order, so they are constants
+typedef enum {
+	SYMBOL_NULL,
+	SYMBOL_RETURN,
+	SYMBOL_CONST,
+	SYMBOL_COMPTIME,
+	SYMBOL_IF,
+	SYMBOL_ELSE,
+	SYMBOL_WHILE,
+	SYMBOL_B8,
+	SYMBOL_I8,
+	SYMBOL_I16,
+	SYMBOL_I32,
+	SYMBOL_I64,
+	SYMBOL_U8,
+	SYMBOL_U16,
+	SYMBOL_U32,
+	SYMBOL_U64,
+	SYMBOL_F32,
+	SYMBOL_F64,
+	SYMBOL_BUILTIN_COUNT,
+} Builtin_Symbol;
+
+const char *builtin_symbol_names[SYMBOL_BUILTIN_COUNT] = {
+	[SYMBOL_NULL] = "",
+	[SYMBOL_RETURN] = "return",
+	[SYMBOL_CONST] = "const",
+	[SYMBOL_COMPTIME] = "comptime",
+	[SYMBOL_IF] = "if",
+	[SYMBOL_ELSE] = "else",
+	[SYMBOL_WHILE] = "while",
+	[SYMBOL_B8] = "b8",
+	[SYMBOL_I8] = "i8",
+	[SYMBOL_I16] = "i16",
+	[SYMBOL_I32] = "i32",
+	[SYMBOL_I64] = "i64",
+	[SYMBOL_U8] = "u8",
+	[SYMBOL_U16] = "u16",
+	[SYMBOL_U32] = "u32",
+	[SYMBOL_U64] = "u64",
+	[SYMBOL_F32] = "f32",
+	[SYMBOL_F64] = "f64",
+};
+
+bool Symbol_is_keyword(Symbol symbol) {
+	return symbol >= SYMBOL_RETURN && symbol <= SYMBOL_WHILE;
+}
+
+// Each compilation unit interns into a table of its own, on the thread compiling it. Units start
+// from a copy of `seed_symbols`, the builtins and any names interned before the units started.
+_Thread_local HashMap symbols;
+HashMap seed_symbols;
+
+Symbol Symbol_intern(StringView name) {
+	u32 hash = sv_hash(name);
+	HashMap_Slot *slot = HashMap_find_slot(&symbols, &name, hash);
+	if(slot->index) return slot->index - 1;
+	HashMap_insert(&symbols, slot, hash, name, name);
+	return symbols._from.len - 1;
+}
+
+// Names made up while compiling rather than read from a file are copied, as symbols keep pointing
+// to their names. They are freed with the symbols.
+typedef struct Symbol_Name {
+	struct Symbol_Name *next;
+	char data[];
+} Symbol_Name;
+
+_Thread_local Symbol_Name *symbol_names;
+
+// Interns the first `len` bytes of `name`, which the symbols then own
+Symbol Symbol_intern_owned(Symbol_Name *name, size_t len) {
+	StringView sv = { .data = name->data, .size = len };
+	u32 hash = sv_hash(sv);
+	HashMap_Slot *slot = HashMap_find_slot(&symbols, &sv, hash);
+	if(slot->index) {
+		free(name);
+		return slot->index - 1;
+	}
+	name->next = symbol_names;
+	symbol_names = name;
+	HashMap_insert(&symbols, slot, hash, sv, sv);
+	return symbols._from.len - 1;
+}
+
+// Interns a name which may not outlive the call, copying it when it is new
+Symbol Symbol_intern_copy(StringView name) {
+	HashMap_Slot *slot = HashMap_find_slot(&symbols, &name, sv_hash(name));
+	if(slot->index) return slot->index - 1;
+	Symbol_Name *copy = malloc(sizeof(Symbol_Name) + name.size);
+	memcpy(copy->data, name.data, name.size);
+	return Symbol_intern_owned(copy, name.size);
+}
+
+StringView Symbol_sv(Symbol symbol) {
+	return symbols._from.data[symbol];
+}
+
+void Symbols_init(void) {
+	HashMap_init(&symbols);
+	for(size_t i = 0; i < SYMBOL_BUILTIN_COUNT; ++i) {
+		Symbol symbol = Symbol_intern(sv_from_cstr(builtin_symbol_names[i]));
+		assert(symbol == i);
+	}
+}
+
+// Makes the current thread's symbols the ones units start from
+void Symbols_seed(void) {
+	HashMap_copy(&seed_symbols, &symbols);
+}
+
+void Symbols_init_from_seed(void) {
+	HashMap_copy(&symbols, &seed_symbols);
+}
+
+void Symbols_free(void) {
+	HashMap_free(&symbols);
+	while(symbol_names) {
+		Symbol_Name *next = symbol_names->next;
+		free(symbol_names);
+		symbol_names = next;
+	}
+}
+
+// SymbolMap, indexed directly by the key symbol
+
+typedef struct {
+	DARRAY(Symbol) _to;
+} SymbolMap;
+
+void SymbolMap_init(SymbolMap *m) {
+	DARRAY_INIT(Symbol)(&m->_to, SYMBOL_BUILTIN_COUNT);
+}
+
+Symbol SymbolMap_at(SymbolMap *m, Symbol from) {
+	return from < m->_to.len ? m->_to.data[from] : SYMBOL_NULL;
+}
+
+void SymbolMap_put(SymbolMap *m, Symbol from, Symbol to) {
+	while(m->_to.len <= from) DARRAY_PUSH(Symbol)(&m->_to, SYMBOL_NULL);
+	m->_to.data[from] = to;
+}
+
+void SymbolMap_free(SymbolMap *m) {
+	DARRAY_FREE(Symbol)(&m->_to);
+}
+
+// Data types
+
+// A data type is named by a symbol: a built-in type, a type parameter, or `T[]`, a dynamic array
+// of T, or `T[..]`, a slice of one, which are named by the symbols "T[]" and "T[..]" and nest.
+
+typedef enum {
+	DATA_TYPE_NAMED,
+	DATA_TYPE_ARRAY,
+	DATA_TYPE_SLICE,
+} Data_Type_Kind;
+
+const char *data_type_suffixes[] = {
+	[DATA_TYPE_NAMED] = "",
+	[DATA_TYPE_ARRAY] = "[]",
+	[DATA_TYPE_SLICE] = "[..]",
+};
+
+Data_Type_Kind Data_Type_kind(Symbol type) {
+	StringView name = Symbol_sv(type);
+	if(name.size < 3 || name.data[name.size - 1] != ']') return DATA_TYPE_NAMED;
+	return name.data[name.size - 2] == '.' ? DATA_TYPE_SLICE : DATA_TYPE_ARRAY;
+}
+
+// The type of the elements of an array or a slice, whose name is the start of the type's own
+Symbol Data_Type_element(Symbol type) {
+	StringView name = Symbol_sv(type);
+	name.size -= strlen(data_type_suffixes[Data_Type_kind(type)]);
+	return Symbol_intern(name);
+}
+
+Symbol Data_Type_compose(Symbol element, Data_Type_Kind kind) {
+	StringView name = Symbol_sv(element);
+	size_t suffix_len = strlen(data_type_suffixes[kind]);
+	Symbol_Name *composed = malloc(sizeof(Symbol_Name) + name.size + suffix_len);
+	memcpy(composed->data, name.data, name.size);
+	memcpy(composed->data + name.size, data_type_suffixes[kind], suffix_len);
+	return Symbol_intern_owned(composed, name.size + suffix_len);
+}
+
+// The named type the arrays and slices of `type` are made of, i32 for i32[][..]
+Symbol Data_Type_base(Symbol type) {
+	while(Data_Type_kind(type) != DATA_TYPE_NAMED) type = Data_Type_element(type);
+	return type;
+}
+
+// Appends a spelling of `type` which C takes in names, i32_array_slice for i32[][..]
+void Data_Type_mangle(DARRAY(char) *out, Symbol type) {
+	switch(Data_Type_kind(type)) {
+		case DATA_TYPE_NAMED:
+			sb_append_sv(out, Symbol_sv(type));
+			break;
+		case DATA_TYPE_ARRAY:
+			Data_Type_mangle(out, Data_Type_element(type));
+			sb_append_cstr(out, "_array");
+			break;
+		case DATA_TYPE_SLICE:
+			Data_Type_mangle(out, Data_Type_element(type));
+			sb_append_cstr(out, "_slice");
+			break;
+	}
+}
+
+// Character classes
+
+// One statically initialized table drives the lexer's dispatch on the first byte of a token
+// and its scanning loops, independently of the locale. Bytes >= 0x80 have no class.
+
+typedef enum {
+	CHAR_CLASS_SPACE = 1 << 0,
+	CHAR_CLASS_DIGIT = 1 << 1,
+	CHAR_CLASS_NAME_START = 1 << 2,
+	CHAR_CLASS_NAME = 1 << 3,
+} Char_Class;
+
+#define CHAR_CLASS_LETTER (CHAR_CLASS_NAME_START | CHAR_CLASS_NAME)
+#define CHAR_CLASS_NUMERAL (CHAR_CLASS_DIGIT | CHAR_CLASS_NAME)
+
+const u8 char_classes[256] = {
+	[' '] = CHAR_CLASS_SPACE, ['\t'] = CHAR_CLASS_SPACE, ['\n'] = CHAR_CLASS_SPACE,
+	['\v'] = CHAR_CLASS_SPACE, ['\f'] = CHAR_CLASS_SPACE, ['\r'] = CHAR_CLASS_SPACE,
+	['0'] = CHAR_CLASS_NUMERAL, ['1'] = CHAR_CLASS_NUMERAL, ['2'] = CHAR_CLASS_NUMERAL,
+	['3'] = CHAR_CLASS_NUMERAL, ['4'] = CHAR_CLASS_NUMERAL, ['5'] = CHAR_CLASS_NUMERAL,
+	['6'] = CHAR_CLASS_NUMERAL, ['7'] = CHAR_CLASS_NUMERAL, ['8'] = CHAR_CLASS_NUMERAL,
+	['9'] = CHAR_CLASS_NUMERAL,
+	['A'] = CHAR_CLASS_LETTER, ['B'] = CHAR_CLASS_LETTER, ['C'] = CHAR_CLASS_LETTER,
+	['D'] = CHAR_CLASS_LETTER, ['E'] = CHAR_CLASS_LETTER, ['F'] = CHAR_CLASS_LETTER,
+	['G'] = CHAR_CLASS_LETTER, ['H'] = CHAR_CLASS_LETTER, ['I'] = CHAR_CLASS_LETTER,
+	['J'] = CHAR_CLASS_LETTER, ['K'] = CHAR_CLASS_LETTER, ['L'] = CHAR_CLASS_LETTER,
+	['M'] = CHAR_CLASS_LETTER, ['N'] = CHAR_CLASS_LETTER, ['O'] = CHAR_CLASS_LETTER,
+	['P'] = CHAR_CLASS_LETTER, ['Q'] = CHAR_CLASS_LETTER, ['R'] = CHAR_CLASS_LETTER,
+	['S'] = CHAR_CLASS_LETTER, ['T'] = CHAR_CLASS_LETTER, ['U'] = CHAR_CLASS_LETTER,
+	['V'] = CHAR_CLASS_LETTER, ['W'] = CHAR_CLASS_LETTER, ['X'] = CHAR_CLASS_LETTER,
+	['Y'] = CHAR_CLASS_LETTER, ['Z'] = CHAR_CLASS_LETTER,
+	['a'] = CHAR_CLASS_LETTER, ['b'] = CHAR_CLASS_LETTER, ['c'] = CHAR_CLASS_LETTER,
+	['d'] = CHAR_CLASS_LETTER, ['e'] = CHAR_CLASS_LETTER, ['f'] = CHAR_CLASS_LETTER,
+	['g'] = CHAR_CLASS_LETTER, ['h'] = CHAR_CLASS_LETTER, ['i'] = CHAR_CLASS_LETTER,
+	['j'] = CHAR_CLASS_LETTER, ['k'] = CHAR_CLASS_LETTER, ['l'] = CHAR_CLASS_LETTER,
+	['m'] = CHAR_CLASS_LETTER, ['n'] = CHAR_CLASS_LETTER, ['o'] = CHAR_CLASS_LETTER,
+	['p'] = CHAR_CLASS_LETTER, ['q'] = CHAR_CLASS_LETTER, ['r'] = CHAR_CLASS_LETTER,
+	['s'] = CHAR_CLASS_LETTER, ['t'] = CHAR_CLASS_LETTER, ['u'] = CHAR_CLASS_LETTER,
+	['v'] = CHAR_CLASS_LETTER, ['w'] = CHAR_CLASS_LETTER, ['x'] = CHAR_CLASS_LETTER,
+	['y'] = CHAR_CLASS_LETTER, ['z'] = CHAR_CLASS_LETTER, ['_'] = CHAR_CLASS_LETTER,
+};
+
+bool char_is(char c, Char_Class char_class) {
+	return char_classes[(u8) c] & char_class;
+}
+
+// Scanning kernels
+
+// The lexer's inner loops skip over runs of bytes of one kind. These find where a run ends,
+// SCAN_WIDTH bytes at a time with SSE2 or AVX2 when the target has them, and byte by byte
+// over the remainder, so they never read past `len`. Most runs are short, so the first
+// SCAN_PROLOGUE bytes are always looked at one by one before paying for a vector load.
+
+#define SCAN_PROLOGUE 8
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define SCAN_WIDTH 32
+#	define SCAN_FULL_MASK 0xffffffffu
+typedef __m256i Scan_Vector;
+#	define scan_load(p) _mm256_loadu_si256((const __m256i*) (p))
+#	define scan_splat(c) _mm256_set1_epi8(c)
+#	define scan_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#	define scan_or(a, b) _mm256_or_si256(a, b)
+#	define scan_sub(a, b) _mm256_sub_epi8(a, b)
+#	define scan_min(a, b) _mm256_min_epu8(a, b)
+#	define scan_mask(v) ((u32) _mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#	define SCAN_WIDTH 16
+#	define SCAN_FULL_MASK 0xffffu
+typedef __m128i Scan_Vector;
+#	define scan_load(p) _mm_loadu_si128((const __m128i*) (p))
+#	define scan_splat(c) _mm_set1_epi8(c)
+#	define scan_eq(a, b) _mm_cmpeq_epi8(a, b)
+#	define scan_or(a, b) _mm_or_si128(a, b)
+#	define scan_sub(a, b) _mm_sub_epi8(a, b)
+#	define scan_min(a, b) _mm_min_epu8(a, b)
+#	define scan_mask(v) ((u32) _mm_movemask_epi8(v))
+#endif
+
+#ifdef SCAN_WIDTH
+// Marks the bytes in [first, first + count)
+Scan_Vector scan_in_range(Scan_Vector v, char first, char count) {
+	Scan_Vector offset = scan_sub(v, scan_splat(first));
+	return scan_eq(scan_min(offset, scan_splat(count - 1)), offset);
+}
+#endif
+
+// Index of the first non-whitespace byte in [from, len), or len
+size_t scan_spaces(const char *s, size_t from, size_t len) {
+	size_t i = from;
+	size_t prologue_end = from + SCAN_PROLOGUE < len ? from + SCAN_PROLOGUE : len;
+	while(i < prologue_end && char_is(s[i], CHAR_CLASS_SPACE)) ++i;
+	if(i < prologue_end) return i;
+#ifdef SCAN_WIDTH
+	for(; i + SCAN_WIDTH <= len; i += SCAN_WIDTH) {
+		Scan_Vector v = scan_load(s + i);
+		u32 spaces = scan_mask(scan_or(scan_eq(v, scan_splat(' ')), scan_in_range(v, '\t', 5))); // \t \n \v \f \r
+		if(spaces != SCAN_FULL_MASK) return i + __builtin_ctz(~spaces);
+	}
+#endif
+	while(i < len && char_is(s[i], CHAR_CLASS_SPACE)) ++i;
+	return i;
+}
+
+// Index of the first byte in [from, len) which can not continue a name, or len
+size_t scan_name(const char *s, size_t from, size_t len) {
+	size_t i = from;
+	size_t prologue_end = from + SCAN_PROLOGUE < len ? from + SCAN_PROLOGUE : len;
+	while(i < prologue_end && char_is(s[i], CHAR_CLASS_NAME)) ++i;
+	if(i < prologue_end) return i;
+#ifdef SCAN_WIDTH
+	for(; i + SCAN_WIDTH <= len; i += SCAN_WIDTH) {
+		Scan_Vector v = scan_load(s + i);
+		Scan_Vector letters = scan_in_range(scan_or(v, scan_splat(0x20)), 'a', 26);
+		Scan_Vector digits = scan_in_range(v, '0', 10);
+		u32 name = scan_mask(scan_or(scan_or(letters, digits), scan_eq(v, scan_splat('_'))));
+		if(name != SCAN_FULL_MASK) return i + __builtin_ctz(~name);
+	}
+#endif
+	while(i < len && char_is(s[i], CHAR_CLASS_NAME)) ++i;
+	return i;
+}
+
+// Index of the first occurrence of either `a` or `b` in [from, len), or len
+size_t scan_until(const char *s, size_t from, size_t len, char a, char b) {
+	size_t i = from;
+	size_t prologue_end = from + SCAN_PROLOGUE < len ? from + SCAN_PROLOGUE : len;
+	while(i < prologue_end && s[i] != a && s[i] != b) ++i;
+	if(i < prologue_end) return i;
+#ifdef SCAN_WIDTH
+	for(; i + SCAN_WIDTH <= len; i += SCAN_WIDTH) {
+		Scan_Vector v = scan_load(s + i);
+		u32 found = scan_mask(scan_or(scan_eq(v, scan_splat(a)), scan_eq(v, scan_splat(b))));
+		if(found) return i + __builtin_ctz(found);
+	}
+#endif
+	while(i < len && s[i] != a && s[i] != b) ++i;
+	return i;
+}
+
+// Source files
+
+// Regular files are mapped into memory and lexed in place, tokens point straight into the mapping.
+// Anything that can not be mapped (pipes, stdin, empty files) is read into a heap buffer instead.
+// An AST file (see CX_AST_File) is opened like any other, its data is then the source in it.
+
+typedef struct {
+	char *path;
+	char *data;
+	size_t len;
+	char *ast; // the whole file, if it is an AST file
+	size_t ast_len;
+	char *_buffer; // the mapping or heap buffer, data may point into it
+	size_t _mapped; // size of the mapping, 0 if data is a heap buffer
+	DARRAY(u32) _line_starts; // see SourceFile_line_starts
+} SourceFile;
+
+FORWARD_DECLARE_DARRAY(SourceFile)
+DECLARE_DARRAY(SourceFile)
+
+#define SOURCE_READ_CHUNK_SIZE (64 * 1024)
+
+void SourceFile_read(SourceFile *file, FILE *fp, char *filename) {
+	DARRAY(char) buffer;
+	DARRAY_INIT(char)(&buffer, SOURCE_READ_CHUNK_SIZE);
+
+	for(;;) {
+		DARRAY_RESERVE(char)(&buffer, buffer.len + SOURCE_READ_CHUNK_SIZE + 2);
+		size_t n = fread(buffer.data + buffer.len, 1, SOURCE_READ_CHUNK_SIZE, fp);
+		buffer.len += n;
+		if(n < SOURCE_READ_CHUNK_SIZE) break;
+	}
+
+	if(ferror(fp)) {
+		DARRAY_FREE(char)(&buffer);
+		panic("error reading file %s: %s\n", filename, strerror(errno));
+	}
+
+	// padding, so the buffer is also a valid C string ending with a newline
+	buffer.data[buffer.len] = '\n';
+	buffer.data[buffer.len + 1] = 0;
+
+	file->data = file->_buffer = buffer.data;
+	file->len = buffer.len;
+	file->_mapped = 0;
+}
+
+// "-" is the standard input
+void SourceFile_open(SourceFile *file, char *filename) {
+	if(streq(filename, "-")) {
+		SourceFile_read(file, stdin, "<stdin>");
+		return;
+	}
+
+#ifdef _WIN32
+	FILE *fp = fopen(filename, "rb");
+#else
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) panic("could not open file: %s\n", filename);
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mapping != MAP_FAILED) {
+			madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+			close(fd);
+			file->data = file->_buffer = mapping;
+			file->len = file->_mapped = st.st_size;
+			return;
+		}
+	}
+
+	FILE *fp = fdopen(fd, "rb");
+#endif
+
+	if(!fp) panic("could not open file: %s\n", filename);
+	SourceFile_read(file, fp, filename);
+	fclose(fp);
+}
+
+void SourceFile_close(SourceFile *file) {
+#ifndef _WIN32
+	if(file->_mapped) {
+		munmap(file->_buffer, file->_mapped);
+	} else
+#endif
+	{
+		free(file->_buffer);
+	}
+	file->data = file->_buffer = file->ast = NULL;
+	file->len = file->ast_len = file->_mapped = 0;
+	DARRAY_FREE(u32)(&file->_line_starts);
+}
+
+// Byte offsets at which the file's lines start. Only diagnostics need these, so they are
+// computed the first time they are asked for.
+DARRAY(u32) *SourceFile_line_starts(SourceFile *file) {
+	if(!file->_line_starts.data) {
+		DARRAY_INIT(u32)(&file->_line_starts, 64);
+		DARRAY_PUSH(u32)(&file->_line_starts, 0);
+		size_t newline = scan_until(file->data, 0, file->len, '\n', '\n');
+		while(newline < file->len) {
+			DARRAY_PUSH(u32)(&file->_line_starts, newline + 1);
+			newline = scan_until(file->data, newline + 1, file->len, '\n', '\n');
+		}
+	}
+	return &file->_line_starts;
+}
+
+// Every file taking part in a compilation, tokens refer to their file by its index in here
+DARRAY(SourceFile) source_files;
+
+u16 SourceFiles_open(char *filename) {
+	if(!source_files.data) DARRAY_INIT(SourceFile)(&source_files, 4);
+	if(source_files.len > UINT16_MAX) panic("too many source files\n");
+
+	SourceFile file = { 0 };
+	file.path = filename;
+	SourceFile_open(&file, filename);
+	if(file.len > UINT32_MAX) {
+		SourceFile_close(&file);
+		panic("%s: files larger than 4 GiB are not supported\n", filename);
+	}
+
+	DARRAY_PUSH(SourceFile)(&source_files, file);
+	return source_files.len - 1;
+}
+
+void SourceFiles_close(void) {
+	for(size_t i = 0; i < source_files.len; ++i)
+		SourceFile_close(&source_files.data[i]);
+	DARRAY_FREE(SourceFile)(&source_files);
 }
 
 // Location
 
+// A position resolved to a line and column, only ever computed for diagnostics
+
 typedef struct {
+	u16 file;
 	char *file_path;
 	size_t line, row;
 } Location;
@@ -178,37 +992,76 @@ typedef struct {
 #define PRIloc "%s:%lu:%lu"
 #define PRIloc_arg(loc) (loc).file_path, (unsigned long) (loc).line + 1, (unsigned long) (loc).row + 1
 
-extern DARRAY(char) source_code;
+Location location_of(u16 file, u32 offset) {
+	DARRAY(u32) *line_starts = SourceFile_line_starts(&source_files.data[file]);
+
+	size_t low = 0, high = line_starts->len; // the line is the last one starting at or before offset
+	while(high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if(line_starts->data[middle] <= offset) low = middle;
+		else high = middle;
+	}
+
+	return (Location) {
+		.file = file,
+		.file_path = source_files.data[file].path,
+		.line = low,
+		.row = offset - line_starts->data[low]
+	};
+}
 
 void loc_error(Location location, char *format, ...) {
 	va_list val;
 	va_start(val, format);
+	++error_count;
+	lock_stream(stderr);
 	fprintf(stderr, PRIloc ": error: ", PRIloc_arg(location));
 	vfprintf(stderr, format, val);
+	unlock_stream(stderr);
 	va_end(val);
 }
 
-void loc_error_cite(Location location) {
-	// TODO: print file line, starting at location
-	// (void) location;
-	size_t line = 0, cur = 0;
-	while(line < location.line) {
-		if(source_code.data[cur++] == '\n') {
-			++line;
-		}
-	}
-	for(size_t i = 0; i < location.row; ++i) ++cur;
-	fprintf(stderr, PRIloc ": error: `", PRIloc_arg(location));
-	while(source_code.data[cur] != '\n') putc(source_code.data[cur++], stderr);
-	fprintf(stderr, "`\n");
+// Text of a line of the file, without its line break
+StringView SourceFile_line(SourceFile *file, size_t line) {
+	DARRAY(u32) *line_starts = SourceFile_line_starts(file);
+	if(line >= line_starts->len) return (StringView) { 0 };
+
+	size_t start = line_starts->data[line];
+	size_t end = line + 1 < line_starts->len ? line_starts->data[line + 1] - 1 : file->len;
+	if(end > start && file->data[end - 1] == '\r') --end;
+
+	return (StringView) {
+		.data = file->data + start,
+		.size = end - start
+	};
+}
+
+// As loc_error, followed by the rest of the line starting at location. Both are printed under one
+// lock, so other threads' diagnostics can not come between them.
+void loc_error_cited(Location location, char *format, ...) {
+	StringView line = SourceFile_line(&source_files.data[location.file], location.line);
+	size_t row = location.row < line.size ? location.row : line.size;
+
+	va_list val;
+	va_start(val, format);
+	++error_count;
+	lock_stream(stderr);
+	fprintf(stderr, PRIloc ": error: ", PRIloc_arg(location));
+	vfprintf(stderr, format, val);
+	fprintf(stderr, PRIloc ": error: `" PRIsv "`\n", PRIloc_arg(location), (int) (line.size - row), line.data + row);
+	unlock_stream(stderr);
+	va_end(val);
 }
 
 void loc_panic(Location location, char *format, ...) {
 	va_list val;
 	va_start(val, format);
+	lock_stream(stderr);
 	fprintf(stderr, PRIloc ": fatal error: ", PRIloc_arg(location));
 	vfprintf(stderr, format, val);
+	unlock_stream(stderr);
 	va_end(val);
+	if(panic_handler) longjmp(*panic_handler, 1);
 	exit(1);
 }
 
@@ -255,6 +1108,15 @@ typedef enum {
 	TOKEN_MOD,
 	TOKEN_MOD_EQUALS,
 	TOKEN_COLON,
+	TOKEN_TILDE,
+	TOKEN_EQUALS_EQUALS,
+	TOKEN_NOT_EQUALS,
+	TOKEN_LESS_EQUALS,
+	TOKEN_GREATER_EQUALS,
+	TOKEN_SHIFT_LEFT,
+	TOKEN_SHIFT_LEFT_EQUALS,
+	TOKEN_SHIFT_RIGHT,
+	TOKEN_SHIFT_RIGHT_EQUALS,
 	TOKEN_EOF,
 } Token_Type;
 
@@ -340,6 +1202,24 @@ const char* Token_Type_to_string(Token_Type type) {
 			return "MOD_EQUALS";
 		case TOKEN_COLON:
 			return "COLON";
+		case TOKEN_TILDE:
+			return "TILDE";
+		case TOKEN_EQUALS_EQUALS:
+			return "EQUALS_EQUALS";
+		case TOKEN_NOT_EQUALS:
+			return "NOT_EQUALS";
+		case TOKEN_LESS_EQUALS:
+			return "LESS_EQUALS";
+		case TOKEN_GREATER_EQUALS:
+			return "GREATER_EQUALS";
+		case TOKEN_SHIFT_LEFT:
+			return "SHIFT_LEFT";
+		case TOKEN_SHIFT_LEFT_EQUALS:
+			return "SHIFT_LEFT_EQUALS";
+		case TOKEN_SHIFT_RIGHT:
+			return "SHIFT_RIGHT";
+		case TOKEN_SHIFT_RIGHT_EQUALS:
+			return "SHIFT_RIGHT_EQUALS";
 		case TOKEN_EOF:
 			return "EOF";
 	}
@@ -347,36 +1227,98 @@ const char* Token_Type_to_string(Token_Type type) {
 	return NULL;
 }
 
+// Source text of the operator tokens
+const char *operator_spellings[TOKEN_EOF + 1] = {
+	[TOKEN_EQUALS] = "=",
+	[TOKEN_PLUS] = "+",
+	[TOKEN_PLUS_EQUALS] = "+=",
+	[TOKEN_PLUS_PLUS] = "++",
+	[TOKEN_MINUS] = "-",
+	[TOKEN_MINUS_EQUALS] = "-=",
+	[TOKEN_MINUS_MINUS] = "--",
+	[TOKEN_ASTERISK] = "*",
+	[TOKEN_TIMES_EQUALS] = "*=",
+	[TOKEN_SLASH] = "/",
+	[TOKEN_DIVIDE_EQUALS] = "/=",
+	[TOKEN_LESS_THAN] = "<",
+	[TOKEN_GREATER_THAN] = ">",
+	[TOKEN_NOT] = "!",
+	[TOKEN_AMPERSTAND] = "&",
+	[TOKEN_AND_EQUALS] = "&=",
+	[TOKEN_LOGIC_AND] = "&&",
+	[TOKEN_PIPE] = "|",
+	[TOKEN_OR_EQUALS] = "|=",
+	[TOKEN_LOGIC_OR] = "||",
+	[TOKEN_XOR] = "^",
+	[TOKEN_XOR_EQUALS] = "^=",
+	[TOKEN_MOD] = "%",
+	[TOKEN_MOD_EQUALS] = "%=",
+	[TOKEN_TILDE] = "~",
+	[TOKEN_EQUALS_EQUALS] = "==",
+	[TOKEN_NOT_EQUALS] = "!=",
+	[TOKEN_LESS_EQUALS] = "<=",
+	[TOKEN_GREATER_EQUALS] = ">=",
+	[TOKEN_SHIFT_LEFT] = "<<",
+	[TOKEN_SHIFT_LEFT_EQUALS] = "<<=",
+	[TOKEN_SHIFT_RIGHT] = ">>",
+	[TOKEN_SHIFT_RIGHT_EQUALS] = ">>=",
+};
+
 typedef struct {
-	Location location;
 	Token_Type type;
+	u32 offset; // of the token's first byte in its file, see Token_location
+	u16 file;
 	union {
-		StringView value_sv;
+		Symbol value_symbol;
+		u32 value_len; // of a string or char literal's contents, see Token_value_sv, or of a number's spelling
 		char value_char;
-		int value_int;
+		u32 _value; // all of the above, as stored in a TokenStream
 	};
 } Token;
 
-FORWARD_DECLARE_DARRAY(Token)
-DECLARE_DARRAY(Token)
+Location Token_location(Token token) {
+	return location_of(token.file, token.offset);
+}
+
+// Contents of a string or char literal, without the quotes
+StringView Token_value_sv(Token token) {
+	return (StringView) {
+		.data = source_files.data[token.file].data + token.offset + 1,
+		.size = token.value_len
+	};
+}
+
+// Spelling of a number literal, without leading zeros, which C would read as octal and JSON not at all.
+// Its value is worked out by Constant_of_number_lit.
+StringView Token_number_sv(Token token) {
+	StringView spelling = {
+		.data = source_files.data[token.file].data + token.offset,
+		.size = token.value_len
+	};
+	while(spelling.size > 1 && spelling.data[0] == '0' && char_is(spelling.data[1], CHAR_CLASS_DIGIT)) {
+		++spelling.data;
+		--spelling.size;
+	}
+	return spelling;
+}
 
 void Token_print(Token token) {
-	fprintf(stderr, PRIloc ": %s", PRIloc_arg(token.location), Token_Type_to_string(token.type));
+	fprintf(stderr, PRIloc ": %s", PRIloc_arg(Token_location(token)), Token_Type_to_string(token.type));
 	switch(token.type) {
 		case TOKEN_NULL:
 			printf(" \n");
 			break;
 		case TOKEN_NAME:
-			printf(" '" PRIsv "'\n", PRIsv_arg(token.value_sv));
+			printf(" '" PRIsv "'\n", PRIsv_arg(Symbol_sv(token.value_symbol)));
 			break;
 		case TOKEN_NUMBER:
-			printf(" %d\n", token.value_int);
+			printf(" " PRIsv "\n", PRIsv_arg(Token_number_sv(token)));
 			break;
 		case TOKEN_CHAR:
-			printf(" '" PRIsv "'\n", PRIsv_arg(token.value_sv));
+			printf(" '" PRIsv "'\n", PRIsv_arg(Token_value_sv(token)));
 			break;
 		case TOKEN_STRING:
-			printf(" \"" PRIsv "\"\n", PRIsv_arg(token.value_sv));
+			printf(" \"" PRIsv "\"\n", PRIsv_arg(Token_value_sv(token)));
 			break;
 		case TOKEN_OPEN_PARENTHESIS:
 		case TOKEN_OPEN_CURLY:
@@ -413,6 +1355,15 @@ void Token_print(Token token) {
 		case TOKEN_MOD_EQUALS:
 		case TOKEN_LOGIC_AND:
 		case TOKEN_LOGIC_OR:
+		case TOKEN_TILDE:
+		case TOKEN_EQUALS_EQUALS:
+		case TOKEN_NOT_EQUALS:
+		case TOKEN_LESS_EQUALS:
+		case TOKEN_GREATER_EQUALS:
+		case TOKEN_SHIFT_LEFT:
+		case TOKEN_SHIFT_LEFT_EQUALS:
+		case TOKEN_SHIFT_RIGHT:
+		case TOKEN_SHIFT_RIGHT_EQUALS:
 		case TOKEN_EOF:
 			printf("\n");
 			break;
@@ -422,21 +1373,13 @@ void Token_print(Token token) {
 // Lexer
 
 typedef struct {
-	char *file_path;
+	u16 file;
 	char *source;
 	size_t source_len;
-	size_t cur, bol, row;
+	size_t cur;
 	bool eof;
 } Lexer;
 
-Location Lexer_location(Lexer* lexer) {
-	return (Location) {
-		.file_path = lexer->file_path,
-		.line = lexer->row,
-		.row = lexer->cur - lexer->bol
-	};
-}
-
 bool Lexer_is_not_empty(Lexer* lexer) {
 	return lexer->cur < lexer->source_len;
 }
@@ -446,81 +1389,83 @@ bool Lexer_is_empty(Lexer* lexer) {
 }
 
 void Lexer_chop_char(Lexer* lexer) {
-	if(Lexer_is_not_empty(lexer)) {
-		char c = lexer->source[lexer->cur++];
-		if(c == '\n') {
-			lexer->bol = lexer->cur;
-			++lexer->row;
-		}
-	}
+	if(Lexer_is_not_empty(lexer)) ++lexer->cur;
+}
+
+// Chops the next character if it is `c`
+bool Lexer_chop_if(Lexer* lexer, char c) {
+	if(Lexer_is_empty(lexer) || lexer->source[lexer->cur] != c) return false;
+	++lexer->cur;
+	return true;
+}
+
+// Index of the first character at or after `i` which is not a digit
+size_t Lexer_skip_digits(Lexer* lexer, size_t i) {
+	while(i < lexer->source_len && char_is(lexer->source[i], CHAR_CLASS_DIGIT)) ++i;
+	return i;
 }
 
 void Lexer_trim(Lexer* lexer) {
-	while(Lexer_is_not_empty(lexer) && isspace(lexer->source[lexer->cur])) {
-		Lexer_chop_char(lexer);
-	}
+	lexer->cur = scan_spaces(lexer->source, lexer->cur, lexer->source_len);
 }
 
 void Lexer_drop(Lexer* lexer) {
-	while(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] != '\n') {
-		Lexer_chop_char(lexer);
-	}
+	lexer->cur = scan_until(lexer->source, lexer->cur, lexer->source_len, '\n', '\n');
 	if(Lexer_is_not_empty(lexer)) {
 		Lexer_chop_char(lexer);
 	}
 }
 
+// Tokens consisting of a single character, no other token starts with one of these
+const Token_Type literal_tokens[256] = {
+	['('] = TOKEN_OPEN_PARENTHESIS,
+	[')'] = TOKEN_CLOSE_PARENTHESIS,
+	['{'] = TOKEN_OPEN_CURLY,
+	['}'] = TOKEN_CLOSE_CURLY,
+	['['] = TOKEN_OPEN_SQUARE,
+	[']'] = TOKEN_CLOSE_SQUARE,
+	['.'] = TOKEN_DOT,
+	[','] = TOKEN_COMMA,
+	[';'] = TOKEN_SEMICOLON,
+	[':'] = TOKEN_COLON,
+	['~'] = TOKEN_TILDE,
+};
+
 Token Lexer_next_token(Lexer* lexer) {
 	Lexer_trim(lexer);
 	while(Lexer_is_not_empty(lexer)) {
 		char *s = lexer->source + lexer->cur;
-		if(!(s[0] == '/' && s[1] == '/')) break;
+		if(!(lexer->cur + 1 < lexer->source_len && s[0] == '/' && s[1] == '/')) break;
 		Lexer_drop(lexer);
 		Lexer_trim(lexer);
 	}
 
 	if(Lexer_is_empty(lexer)) return (Token) { 0 };
 
-	Location location = Lexer_location(lexer);
+	u32 offset = lexer->cur;
 	char first = lexer->source[lexer->cur];
 
-	if(isalpha(first) || first == '_') {
+	if(char_is(first, CHAR_CLASS_NAME_START)) {
 		size_t index = lexer->cur;
-		while(Lexer_is_not_empty(lexer) && (isalnum(lexer->source[lexer->cur]) || lexer->source[lexer->cur] == '_')) {
-			Lexer_chop_char(lexer);
-		}
+		lexer->cur = scan_name(lexer->source, lexer->cur, lexer->source_len); // names never contain newlines
 
 		return (Token) {
-			.location = location,
+			.offset = offset,
+			.file = lexer->file,
 			.type = TOKEN_NAME,
-			.value_sv = (StringView) {
+			.value_symbol = Symbol_intern((StringView) {
 				.data = lexer->source + index,
 				.size = lexer->cur - index
-			}
+			})
 		};
 	}
 
-	Token_Type literal_tokens[256] = { 0 };
-	literal_tokens['('] = TOKEN_OPEN_PARENTHESIS;
-	literal_tokens[')'] = TOKEN_CLOSE_PARENTHESIS;
-	literal_tokens['{'] = TOKEN_OPEN_CURLY;
-	literal_tokens['}'] = TOKEN_CLOSE_CURLY;
-	literal_tokens['['] = TOKEN_OPEN_SQUARE;
-	literal_tokens[']'] = TOKEN_CLOSE_SQUARE;
-	literal_tokens['.'] = TOKEN_DOT;
-	literal_tokens[','] = TOKEN_COMMA;
-	literal_tokens[';'] = TOKEN_SEMICOLON;
-	literal_tokens[':'] = TOKEN_COLON;
-	literal_tokens['='] = TOKEN_EQUALS;
-	literal_tokens['<'] = TOKEN_LESS_THAN;
-	literal_tokens['>'] = TOKEN_GREATER_THAN;
-	literal_tokens['!'] = TOKEN_NOT;
-
-	if(literal_tokens[(int) first]) {
+	if(literal_tokens[(u8) first]) {
 		Lexer_chop_char(lexer);
 		return (Token) {
-			.location = location,
-			.type = literal_tokens[(int) first],
+			.offset = offset,
+			.file = lexer->file,
+			.type = literal_tokens[(u8) first],
 			.value_char = lexer->source[lexer->cur - 1]
 		};
 	}
@@ -529,6 +1474,8 @@ Token Lexer_next_token(Lexer* lexer) {
 		Lexer_chop_char(lexer);
 		size_t start = lexer->cur;
 		while(Lexer_is_not_empty(lexer)) {
+			lexer->cur = scan_until(lexer->source, lexer->cur, lexer->source_len, '"', '\\');
+			if(Lexer_is_empty(lexer)) break;
 			char c = lexer->source[lexer->cur];
 			switch(c) {
 				case '"': goto finished_lexing_string;
@@ -547,12 +1494,10 @@ Token Lexer_next_token(Lexer* lexer) {
 		if(Lexer_is_not_empty(lexer)) {
 			Lexer_chop_char(lexer);
 			return (Token) {
-				.location = location,
+				.offset = offset,
+				.file = lexer->file,
 				.type = TOKEN_STRING,
-				.value_sv = (StringView) {
-					.data = lexer->source + start,
-					.size = lexer->cur - start - 1
-				}
+				.value_len = lexer->cur - start - 1
 			};
 		}
 	}
@@ -561,6 +1506,8 @@ Token Lexer_next_token(Lexer* lexer) {
 		Lexer_chop_char(lexer);
 		size_t start = lexer->cur;
 		while(Lexer_is_not_empty(lexer)) {
+			lexer->cur = scan_until(lexer->source, lexer->cur, lexer->source_len, '\'', '\\');
+			if(Lexer_is_empty(lexer)) break;
 			char c = lexer->source[lexer->cur];
 			switch(c) {
 				case '\'': goto finished_lexing_char;
@@ -579,112 +1526,261 @@ Token Lexer_next_token(Lexer* lexer) {
 		if(Lexer_is_not_empty(lexer)) {
 			Lexer_chop_char(lexer);
 			return (Token) {
-				.location = location,
+				.offset = offset,
+				.file = lexer->file,
 				.type = TOKEN_CHAR,
-				.value_sv = (StringView) {
-					.data = lexer->source + start,
-					.size = lexer->cur - start - 1
-				}
+				.value_len = lexer->cur - start - 1
 			};
 		}
 	}
 
-	if(isdigit(first)) {
-		size_t start = lexer->cur;
-		while(Lexer_is_not_empty(lexer) && isdigit(lexer->source[lexer->cur])) {
-			Lexer_chop_char(lexer);
+	if(char_is(first, CHAR_CLASS_DIGIT)) {
+		char *source = lexer->source;
+		size_t len = lexer->source_len;
+		lexer->cur = Lexer_skip_digits(lexer, lexer->cur);
+
+		// a fraction or an exponent makes it floating point, either needs digits of its own
+		if(lexer->cur + 1 < len && source[lexer->cur] == '.' && char_is(source[lexer->cur + 1], CHAR_CLASS_DIGIT)) {
+			lexer->cur = Lexer_skip_digits(lexer, lexer->cur + 1);
+		}
+		if(lexer->cur < len && (source[lexer->cur] == 'e' || source[lexer->cur] == 'E')) {
+			size_t digits = lexer->cur + 1;
+			if(digits < len && (source[digits] == '+' || source[digits] == '-')) ++digits;
+			if(digits < len && char_is(source[digits], CHAR_CLASS_DIGIT)) lexer->cur = Lexer_skip_digits(lexer, digits);
 		}
 
 		return (Token) {
-			.location = location,
+			.offset = offset,
+			.file = lexer->file,
 			.type = TOKEN_NUMBER,
-			.value_int = atoi(lexer->source + start)
+			.value_len = lexer->cur - offset
 		};
 	}
 
 	{
 
 		Token_Type type;
-		size_t start = lexer->cur;
 
 		switch(first) {
 			case '+': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_PLUS;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_PLUS_EQUALS;
-				else if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '+')
+				else if(Lexer_chop_if(lexer, '+'))
 					type = TOKEN_PLUS_PLUS;
 			} break;
 			case '-': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_MINUS;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_MINUS_EQUALS;
-				else if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '+')
+				else if(Lexer_chop_if(lexer, '-'))
 					type = TOKEN_MINUS_MINUS;
-				else if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '>')
+				else if(Lexer_chop_if(lexer, '>'))
 					type = TOKEN_ARROW;
 			} break;
 			case '*': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_ASTERISK;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_TIMES_EQUALS;
 			} break;
 			case '/': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_SLASH;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_DIVIDE_EQUALS;
 			} break;
 			case '&': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_AMPERSTAND;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_AND_EQUALS;
-				else if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '&')
+				else if(Lexer_chop_if(lexer, '&'))
 					type = TOKEN_LOGIC_AND;
 			} break;
 			case '|': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_PIPE;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_OR_EQUALS;
-				else if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '|')
+				else if(Lexer_chop_if(lexer, '|'))
 					type = TOKEN_LOGIC_OR;
 			} break;
 			case '^': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_XOR;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_XOR_EQUALS;
 			} break;
 			case '%': {
 				Lexer_chop_char(lexer);
 				type = TOKEN_MOD;
-				if(Lexer_is_not_empty(lexer) && lexer->source[lexer->cur] == '=')
+				if(Lexer_chop_if(lexer, '='))
 					type = TOKEN_MOD_EQUALS;
 			} break;
+			case '=': {
+				Lexer_chop_char(lexer);
+				type = TOKEN_EQUALS;
+				if(Lexer_chop_if(lexer, '='))
+					type = TOKEN_EQUALS_EQUALS;
+			} break;
+			case '!': {
+				Lexer_chop_char(lexer);
+				type = TOKEN_NOT;
+				if(Lexer_chop_if(lexer, '='))
+					type = TOKEN_NOT_EQUALS;
+			} break;
+			case '<': {
+				Lexer_chop_char(lexer);
+				type = TOKEN_LESS_THAN;
+				if(Lexer_chop_if(lexer, '='))
+					type = TOKEN_LESS_EQUALS;
+				else if(Lexer_chop_if(lexer, '<'))
+					type = Lexer_chop_if(lexer, '=') ? TOKEN_SHIFT_LEFT_EQUALS : TOKEN_SHIFT_LEFT;
+			} break;
+			case '>': {
+				Lexer_chop_char(lexer);
+				type = TOKEN_GREATER_THAN;
+				if(Lexer_chop_if(lexer, '='))
+					type = TOKEN_GREATER_EQUALS;
+				else if(Lexer_chop_if(lexer, '>'))
+					type = Lexer_chop_if(lexer, '=') ? TOKEN_SHIFT_RIGHT_EQUALS : TOKEN_SHIFT_RIGHT;
+			} break;
 			default: goto not_operand;
 		}
 
 		return (Token) {
-			.location = location,
-			.type = type,
-			.value_sv = (StringView) {
-				.data = lexer->source + start
-			}
+			.offset = offset,
+			.file = lexer->file,
+			.type = type
 		};
 
 	}
 
 	not_operand:
 
-	loc_panic(location, "unknown token starts with '%c' = 0x%x = %d\n", first, first, first);
+	loc_panic(location_of(lexer->file, offset), "unknown token starts with '%c' = 0x%x = %d\n", first, first, first);
 	return (Token) { 0 };
 }
 
+// TokenStream
+
+// Tokens are lexed on demand, as the parser asks for them, into a ring buffer of parallel arrays.
+// Most of the parser only looks at token types, which are a byte each and dense in memory.
+// Tokens are addressed by their absolute index in the file. The ring holds those from the oldest
+// one the parser may still come back to (see TokenStream_release) up to the furthest one it
+// has looked at, and only grows when that window does not fit.
+
+_Static_assert(TOKEN_EOF <= UINT8_MAX, "Token_Type must fit in a byte");
+
+#define TOKEN_STREAM_INITIAL_CAPACITY 256
+
+typedef struct {
+	Lexer lexer;
+	size_t capacity; // of the ring, always a power of two
+	u8 *types;       // Token_Type
+	u32 *offsets;
+	u32 *values;     // Token::_value
+	size_t begin, end; // absolute indices of the tokens in the ring
+	size_t released;   // tokens before this one will not be asked for again
+	size_t peak;       // most tokens ever held at once
+} TokenStream;
+
+void TokenStream_init(TokenStream *tokens, Lexer lexer) {
+	tokens->lexer = lexer;
+	tokens->capacity = TOKEN_STREAM_INITIAL_CAPACITY;
+	tokens->types = malloc(tokens->capacity * sizeof(u8));
+	tokens->offsets = malloc(tokens->capacity * sizeof(u32));
+	tokens->values = malloc(tokens->capacity * sizeof(u32));
+	tokens->begin = tokens->end = tokens->released = tokens->peak = 0;
+}
+
+void TokenStream_grow(TokenStream *tokens) {
+	size_t capacity = tokens->capacity * 2;
+	u8 *types = malloc(capacity * sizeof(u8));
+	u32 *offsets = malloc(capacity * sizeof(u32));
+	u32 *values = malloc(capacity * sizeof(u32));
+
+	for(size_t i = tokens->begin; i < tokens->end; ++i) {
+		types[i & (capacity - 1)] = tokens->types[i & (tokens->capacity - 1)];
+		offsets[i & (capacity - 1)] = tokens->offsets[i & (tokens->capacity - 1)];
+		values[i & (capacity - 1)] = tokens->values[i & (tokens->capacity - 1)];
+	}
+
+	free(tokens->types);
+	free(tokens->offsets);
+	free(tokens->values);
+	tokens->types = types;
+	tokens->offsets = offsets;
+	tokens->values = values;
+	tokens->capacity = capacity;
+}
+
+void TokenStream_push(TokenStream *tokens, Token token) {
+	tokens->begin = tokens->released > tokens->begin ? tokens->released : tokens->begin;
+	if(tokens->end - tokens->begin == tokens->capacity) TokenStream_grow(tokens);
+
+	size_t i = tokens->end++ & (tokens->capacity - 1);
+	tokens->types[i] = token.type;
+	tokens->offsets[i] = token.offset;
+	tokens->values[i] = token._value;
+
+	if(tokens->end - tokens->begin > tokens->peak) tokens->peak = tokens->end - tokens->begin;
+}
+
+// Lexes up to and including the token at `index`, the last token of a file is TOKEN_EOF.
+// Returns whether there is such a token.
+bool TokenStream_fill(TokenStream *tokens, size_t index) {
+	while(tokens->end <= index) {
+		if(tokens->lexer.eof) return false;
+
+		if(Lexer_is_not_empty(&tokens->lexer)) {
+			Token token = Lexer_next_token(&tokens->lexer);
+			if(token.type) TokenStream_push(tokens, token); // trailing whitespace yields a null token
+		} else {
+			Token eof = (Token) { 0 };
+			eof.type = TOKEN_EOF;
+			eof.offset = tokens->lexer.cur;
+			TokenStream_push(tokens, eof);
+			tokens->lexer.eof = true;
+		}
+	}
+	return true;
+}
+
+Token_Type TokenStream_type(TokenStream *tokens, size_t index) {
+	if(!TokenStream_fill(tokens, index)) return TOKEN_NULL;
+	assert(index >= tokens->begin && "token was released");
+	return tokens->types[index & (tokens->capacity - 1)];
+}
+
+Token TokenStream_at(TokenStream *tokens, size_t index) {
+	if(!TokenStream_fill(tokens, index)) return (Token) { 0 };
+	assert(index >= tokens->begin && "token was released");
+	size_t i = index & (tokens->capacity - 1);
+	return (Token) {
+		.type = tokens->types[i],
+		.offset = tokens->offsets[i],
+		.file = tokens->lexer.file,
+		._value = tokens->values[i]
+	};
+}
+
+// Allows the tokens before `index` to be overwritten
+void TokenStream_release(TokenStream *tokens, size_t index) {
+	if(index > tokens->released) tokens->released = index;
+}
+
+void TokenStream_free(TokenStream *tokens) {
+	free(tokens->types);
+	free(tokens->offsets);
+	free(tokens->values);
+	tokens->types = NULL;
+	tokens->offsets = tokens->values = NULL;
+}
+
 // AST
 
 typedef enum {
@@ -697,245 +1793,565 @@ typedef enum {
 	CX_AST_NODE_TYPE_NUMBER_LIT,
 	CX_AST_NODE_TYPE_STRING_LIT,
 
+	CX_AST_NODE_TYPE_UNARY_EXPR,
+	CX_AST_NODE_TYPE_BINARY_EXPR,
+	CX_AST_NODE_TYPE_INDEX_EXPR,
+	CX_AST_NODE_TYPE_CALL_EXPR,
+	CX_AST_NODE_TYPE_MEMBER_EXPR,
+
 	CX_AST_NODE_TYPE_RETURN_STMT,
 	CX_AST_NODE_TYPE_COMPOUND_STMT,
+	CX_AST_NODE_TYPE_EXPR_STMT,
+	CX_AST_NODE_TYPE_IF_STMT,
+	CX_AST_NODE_TYPE_WHILE_STMT,
 
 	CX_AST_NODE_TYPE_FUNCTION_DECL,
+	CX_AST_NODE_TYPE_PARAMETER_DECL,
+	CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL,
+	CX_AST_NODE_TYPE_VARIABLE_DECL,
+	CX_AST_NODE_TYPE_CONST_DECL,
+	CX_AST_NODE_TYPE_CONST_ARRAY_DECL,
 	// CX_AST_NODE_TYPE_VARIABLE, // name:NAME
-	// CX_AST_NODE_TYPE_FUNCALL, // func:AST, args:[AST]
 } CX_AST_Node_Type;
 
-typedef struct CX_AST_Node CX_AST_Node;
+// The tree is stored flat, as parallel arrays indexed by a node's CX_AST_Index.
+// Index 0 is the null node. A node's children are a contiguous range of the `children` array,
+// nodes are appended in post-order, so every child has a lower index than its parent. A generic
+// function's data_type is appended after its type parameters, which come before any of its types.
+// A data type's NAME token is the first of its spelling, its symbol the whole type's, as in `i32[]`.
+//
+//   node                 token        children
+//   ROOT                 -            declarations...
+//   TYPE_ID              NAME         -
+//   NAME_ID              NAME         -
+//   NUMBER_LIT           NUMBER       -
+//   STRING_LIT           STRING       -
+//   UNARY_EXPR           operator     operand
+//   BINARY_EXPR          operator     lhs, rhs
+//   INDEX_EXPR           `[`          array, index
+//   CALL_EXPR            `(`          function, type arguments..., arguments...
+//   MEMBER_EXPR          NAME         object
+//   RETURN_STMT          `return`     expr
+//   COMPOUND_STMT        `{`          statements...
+//   EXPR_STMT            `;`          expr
+//   IF_STMT              `if`         condition, then, else (optional)
+//   WHILE_STMT           `while`      condition, body
+//   FUNCTION_DECL        `(`          data_type, name, type parameters..., parameters..., body
+//   PARAMETER_DECL       NAME         data_type, name
+//   TYPE_PARAMETER_DECL  NAME         -
+//   VARIABLE_DECL        `=` or NAME  data_type, name, value (optional for arrays and slices)
+//   CONST_DECL           `const`      data_type, name, value
+//   CONST_ARRAY_DECL     `const`      data_type, name, length, function
+
+typedef u32 CX_AST_Index;
 
-FORWARD_DECLARE_DARRAY(CX_AST_Node)
+typedef struct {
+	DARRAY(u8) kinds;            // CX_AST_Node_Type
+	DARRAY(u8) token_types;      // the node's token, copied out of the TokenStream
+	DARRAY(u32) token_offsets;
+	DARRAY(u32) token_values;
+	DARRAY(u32) children_first;  // index into children
+	DARRAY(u32) children_count;
+	DARRAY(u32) children;        // CX_AST_Index of every node's children
+	u16 file;
+	CX_AST_Index root;
+	bool _mapped; // the arrays point into an AST file, see CX_AST_map
+} CX_AST;
+
+// `initial_capacity` is a guess of the node count, most nodes stand for a token of their own
+void CX_AST_init(CX_AST *ast, u16 file, size_t initial_capacity) {
+	DARRAY_INIT(u8)(&ast->kinds, initial_capacity);
+	DARRAY_INIT(u8)(&ast->token_types, initial_capacity);
+	DARRAY_INIT(u32)(&ast->token_offsets, initial_capacity);
+	DARRAY_INIT(u32)(&ast->token_values, initial_capacity);
+	DARRAY_INIT(u32)(&ast->children_first, initial_capacity);
+	DARRAY_INIT(u32)(&ast->children_count, initial_capacity);
+	DARRAY_INIT(u32)(&ast->children, initial_capacity);
+	ast->file = file;
+	ast->root = 0;
+	ast->_mapped = false;
+
+	// the null node
+	DARRAY_PUSH(u8)(&ast->kinds, CX_AST_NODE_TYPE_NULL);
+	DARRAY_PUSH(u8)(&ast->token_types, TOKEN_NULL);
+	DARRAY_PUSH(u32)(&ast->token_offsets, 0);
+	DARRAY_PUSH(u32)(&ast->token_values, 0);
+	DARRAY_PUSH(u32)(&ast->children_first, 0);
+	DARRAY_PUSH(u32)(&ast->children_count, 0);
+}
 
-struct CX_AST_Node {
-	CX_AST_Node_Type type;
-	CX_AST_Node *parent;
-	union {
-		struct {
-			CX_AST_Node *data;
-			size_t len;
-			size_t _allocated;
-		} u_root;
+void CX_AST_free(CX_AST *ast) {
+	if(ast->_mapped) {
+		memset(ast, 0, sizeof(*ast)); // the AST file's SourceFile owns the arrays
+		return;
+	}
+	DARRAY_FREE(u8)(&ast->kinds);
+	DARRAY_FREE(u8)(&ast->token_types);
+	DARRAY_FREE(u32)(&ast->token_offsets);
+	DARRAY_FREE(u32)(&ast->token_values);
+	DARRAY_FREE(u32)(&ast->children_first);
+	DARRAY_FREE(u32)(&ast->children_count);
+	DARRAY_FREE(u32)(&ast->children);
+}
 
-		// Identifiers
+CX_AST_Index CX_AST_push_node(CX_AST *ast, CX_AST_Node_Type kind, Token token, CX_AST_Index *children, size_t children_count) {
+	CX_AST_Index node = ast->kinds.len;
+	DARRAY_PUSH(u8)(&ast->kinds, kind);
+	DARRAY_PUSH(u8)(&ast->token_types, token.type);
+	DARRAY_PUSH(u32)(&ast->token_offsets, token.offset);
+	DARRAY_PUSH(u32)(&ast->token_values, token._value);
+	DARRAY_PUSH(u32)(&ast->children_first, ast->children.len);
+	DARRAY_PUSH(u32)(&ast->children_count, children_count);
+	for(size_t i = 0; i < children_count; ++i)
+		DARRAY_PUSH(u32)(&ast->children, children[i]);
+	return node;
+}
+
+CX_AST_Node_Type CX_AST_kind(CX_AST *ast, CX_AST_Index node) {
+	return ast->kinds.data[node];
+}
+
+Token CX_AST_token(CX_AST *ast, CX_AST_Index node) {
+	return (Token) {
+		.type = ast->token_types.data[node],
+		.offset = ast->token_offsets.data[node],
+		.file = ast->file,
+		._value = ast->token_values.data[node]
+	};
+}
 
-		struct {
-			Token value; // TODO: change type to AST when introducing macros
-		} u_type_id;
+size_t CX_AST_children_count(CX_AST *ast, CX_AST_Index node) {
+	return ast->children_count.data[node];
+}
 
-		struct {
-			Token value; // TODO: change type to AST when introducing macros
-		} u_name_id;
+CX_AST_Index CX_AST_child(CX_AST *ast, CX_AST_Index node, size_t i) {
+	assert(i < ast->children_count.data[node]);
+	return ast->children.data[ast->children_first.data[node] + i];
+}
 
-		// Literals
+// Type arguments are the TYPE_IDs after a call's function, type parameters the TYPE_PARAMETER_DECLs
+// after a function's name
+size_t CX_AST_type_arguments_count(CX_AST *ast, CX_AST_Index call) {
+	size_t count = 0, children_count = CX_AST_children_count(ast, call);
+	while(1 + count < children_count && CX_AST_kind(ast, CX_AST_child(ast, call, 1 + count)) == CX_AST_NODE_TYPE_TYPE_ID) ++count;
+	return count;
+}
 
-		struct {
-			Token value;
-		} u_number_lit;
+size_t CX_AST_type_parameters_count(CX_AST *ast, CX_AST_Index function) {
+	size_t count = 0;
+	while(CX_AST_kind(ast, CX_AST_child(ast, function, 2 + count)) == CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL) ++count;
+	return count;
+}
 
-		struct {
-			Token value;
-		} u_string_lit;
+// The value arguments and parameters, after the type ones
+size_t CX_AST_arguments_count(CX_AST *ast, CX_AST_Index call) {
+	return CX_AST_children_count(ast, call) - 1 - CX_AST_type_arguments_count(ast, call);
+}
 
-		// Statements
+size_t CX_AST_parameters_count(CX_AST *ast, CX_AST_Index function) {
+	return CX_AST_children_count(ast, function) - 3 - CX_AST_type_parameters_count(ast, function);
+}
 
-		struct {
-			CX_AST_Node *expr;
-		} u_return_stmt;
+size_t CX_AST_size_in_bytes(CX_AST *ast) {
+	return ast->kinds.len * (2 * sizeof(u8) + 4 * sizeof(u32)) + ast->children.len * sizeof(u32);
+}
 
-		struct {
-			CX_AST_Node *data;
-			size_t len;
-			size_t _allocated;
-		} u_compound_stmt;
+// CX_AST walks
 
-		// Declarations
+// Passes which need the tree's shape, rather than just its nodes, walk it depth first with an
+// explicit stack on the heap, so nesting is bounded by memory and not by the C stack.
+// A visitor is called when a node is entered, between two of its children and when it is left.
+// Visitors embed a CX_AST_Visitor as their first member, any of its hooks may be NULL.
+// `enter` may set `skip` to leave the node right away, without walking its children.
 
-		struct {
-			CX_AST_Node *data_type;
-			CX_AST_Node *name;
-			// TODO: types
-			// TODO: names
-			CX_AST_Node *body;
-		} u_function_decl;
+typedef struct CX_AST_Visitor CX_AST_Visitor;
 
-	}; // end union
+struct CX_AST_Visitor {
+	void (*enter)(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent);
+	void (*between)(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, size_t next_child);
+	void (*leave)(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent);
+	bool skip;
 };
 
-DECLARE_DARRAY(CX_AST_Node)
-
-void CX_AST_Node_root(CX_AST_Node *root) {
-	root->type = CX_AST_NODE_TYPE_ROOT;
-	root->parent = NULL;
-	DARRAY_INIT(CX_AST_Node)((DARRAY(CX_AST_Node)*) &root->u_root, 1);
+// Enters `node`, returns whether its children are to be walked
+bool CX_AST_Visitor_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	if(visitor->enter) visitor->enter(visitor, ast, node, parent);
+	if(!visitor->skip) return true;
+	visitor->skip = false;
+	if(visitor->leave) visitor->leave(visitor, ast, node, parent);
+	return false;
 }
 
-// Identifier constructors
+typedef struct {
+	CX_AST_Index node;
+	u32 next_child;
+} CX_AST_Walk_Frame;
 
-void CX_AST_Node_type_id(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_TYPE_ID;
-	new->parent = parent;
-	new->u_type_id.value = (Token) { 0 };
-}
+FORWARD_DECLARE_DARRAY(CX_AST_Walk_Frame)
+DECLARE_DARRAY(CX_AST_Walk_Frame)
 
-void CX_AST_Node_name_id(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_NAME_ID;
-	new->parent = parent;
-	new->u_name_id.value = (Token) { 0 };
-}
+_Thread_local size_t CX_AST_walk_peak_depth = 0; // reported by --stats
 
-// Literal constructors
+// Walks with a `stack` the caller keeps, for passes which walk many small trees
+void CX_AST_walk_with(CX_AST *ast, CX_AST_Index root, CX_AST_Visitor *visitor, DARRAY(CX_AST_Walk_Frame) *stack) {
+	if(CX_AST_Visitor_enter(visitor, ast, root, 0))
+		DARRAY_PUSH(CX_AST_Walk_Frame)(stack, (CX_AST_Walk_Frame) { .node = root, .next_child = 0 });
 
-void CX_AST_Node_number_lit(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_NUMBER_LIT;
-	new->parent = parent;
-	new->u_number_lit.value = (Token) { 0 };
-}
+	while(stack->len) {
+		if(stack->len > CX_AST_walk_peak_depth) CX_AST_walk_peak_depth = stack->len;
 
-void CX_AST_Node_string_lit(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_STRING_LIT;
-	new->parent = parent;
-	new->u_number_lit.value = (Token) { 0 };
-}
+		CX_AST_Walk_Frame *top = &stack->data[stack->len - 1];
+		CX_AST_Index node = top->node;
 
-// Statement constructors
+		if(top->next_child < CX_AST_children_count(ast, node)) {
+			size_t i = top->next_child++;
+			if(i && visitor->between) visitor->between(visitor, ast, node, i);
 
-void CX_AST_Node_return_stmt(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_RETURN_STMT;
-	new->parent = parent;
-	new->u_return_stmt.expr = (CX_AST_Node*) malloc(sizeof(CX_AST_Node));
+			CX_AST_Index child = CX_AST_child(ast, node, i);
+			if(CX_AST_Visitor_enter(visitor, ast, child, node))
+				DARRAY_PUSH(CX_AST_Walk_Frame)(stack, (CX_AST_Walk_Frame) { .node = child, .next_child = 0 });
+		} else {
+			--stack->len;
+			CX_AST_Index parent = stack->len ? stack->data[stack->len - 1].node : 0;
+			if(visitor->leave) visitor->leave(visitor, ast, node, parent);
+		}
+	}
 }
 
-void CX_AST_Node_compound_stmt(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_COMPOUND_STMT;
-	new->parent = parent;
-	DARRAY_INIT(CX_AST_Node)((DARRAY(CX_AST_Node)*) &new->u_compound_stmt, 1);
+void CX_AST_walk(CX_AST *ast, CX_AST_Index root, CX_AST_Visitor *visitor) {
+	DARRAY(CX_AST_Walk_Frame) stack;
+	DARRAY_INIT(CX_AST_Walk_Frame)(&stack, 64);
+	CX_AST_walk_with(ast, root, visitor, &stack);
+	DARRAY_FREE(CX_AST_Walk_Frame)(&stack);
 }
 
-// Declaration constructors
+// JSON dump
 
-void CX_AST_Node_function_decl(CX_AST_Node *parent, CX_AST_Node *new) {
-	new->type = CX_AST_NODE_TYPE_FUNCTION_DECL;
-	new->parent = parent;
-	new->u_function_decl.data_type = (CX_AST_Node*) malloc(sizeof(CX_AST_Node));
-	new->u_function_decl.name = (CX_AST_Node*) malloc(sizeof(CX_AST_Node));
-	new->u_function_decl.body = (CX_AST_Node*) malloc(sizeof(CX_AST_Node));
-}
+typedef struct {
+	CX_AST_Visitor visitor;
+	FILE *sink;
+} CX_AST_JSON_Printer;
 
-// end CX_AST_Node constructors
+void CX_AST_JSON_Printer_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	(void) parent;
+	FILE *sink = ((CX_AST_JSON_Printer*) visitor)->sink;
 
-void CX_AST_Node_free(CX_AST_Node node) {
-	switch(node.type) {
+	fprintf(sink, "{");
+	switch(CX_AST_kind(ast, node)) {
 		case CX_AST_NODE_TYPE_NULL:
-			assert(false && "unreachable");
+			fprintf(sink, "null");
 			break;
 		case CX_AST_NODE_TYPE_ROOT:
-			for(size_t i = 0; i < node.u_root.len; ++i)
-				CX_AST_Node_free(node.u_root.data[i]);
-			DARRAY_FREE(CX_AST_Node)((DARRAY(CX_AST_Node)*) &node.u_root);
+			fprintf(sink, "\"u_root\":{\"children\":[");
 			break;
 		case CX_AST_NODE_TYPE_TYPE_ID:
-			// no need to free
-			break;
 		case CX_AST_NODE_TYPE_NAME_ID:
-			// no need to free
+		case CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL:
+			fprintf(sink, "\"" PRIsv "\"", PRIsv_arg(Symbol_sv(CX_AST_token(ast, node).value_symbol)));
 			break;
 		case CX_AST_NODE_TYPE_NUMBER_LIT:
-			// no need to free
+			fprintf(sink, "\"u_number_lit\":" PRIsv, PRIsv_arg(Token_number_sv(CX_AST_token(ast, node))));
 			break;
 		case CX_AST_NODE_TYPE_STRING_LIT:
-			// no need to free
+			fprintf(sink, "\"u_string_lit\":\"" PRIsv "\"", PRIsv_arg(Token_value_sv(CX_AST_token(ast, node))));
+			break;
+		case CX_AST_NODE_TYPE_UNARY_EXPR:
+			fprintf(sink, "\"u_unary_expr\":{\"operator\":\"%s\",\"operand\":", operator_spellings[CX_AST_token(ast, node).type]);
+			break;
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			fprintf(sink, "\"u_binary_expr\":{\"operator\":\"%s\",\"lhs\":", operator_spellings[CX_AST_token(ast, node).type]);
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			fprintf(sink, "\"u_index_expr\":{\"array\":");
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			fprintf(sink, "\"u_call_expr\":{\"function\":");
+			break;
+		case CX_AST_NODE_TYPE_MEMBER_EXPR:
+			fprintf(sink, "\"u_member_expr\":{\"member\":\"" PRIsv "\",\"object\":", PRIsv_arg(Symbol_sv(CX_AST_token(ast, node).value_symbol)));
 			break;
 		case CX_AST_NODE_TYPE_RETURN_STMT:
-			CX_AST_Node_free(*node.u_return_stmt.expr);
+			fprintf(sink, "\"u_return_stmt\":");
 			break;
 		case CX_AST_NODE_TYPE_COMPOUND_STMT:
-			for(size_t i = 0; i < node.u_compound_stmt.len; ++i)
-				CX_AST_Node_free(node.u_compound_stmt.data[i]);
-			DARRAY_FREE(CX_AST_Node)((DARRAY(CX_AST_Node)*) &node.u_compound_stmt);
+			fprintf(sink, "\"u_compound_stmt\":{\"children\":[");
+			break;
+		case CX_AST_NODE_TYPE_EXPR_STMT:
+			fprintf(sink, "\"u_expr_stmt\":");
+			break;
+		case CX_AST_NODE_TYPE_IF_STMT:
+			fprintf(sink, "\"u_if_stmt\":{\"condition\":");
+			break;
+		case CX_AST_NODE_TYPE_WHILE_STMT:
+			fprintf(sink, "\"u_while_stmt\":{\"condition\":");
 			break;
 		case CX_AST_NODE_TYPE_FUNCTION_DECL:
-			CX_AST_Node_free(*node.u_function_decl.data_type);
-			CX_AST_Node_free(*node.u_function_decl.name);
-			CX_AST_Node_free(*node.u_function_decl.body);
+			fprintf(sink, "\"u_function_decl\":{\"data_type\":");
+			break;
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			fprintf(sink, "\"u_parameter_decl\":{\"data_type\":");
+			break;
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			fprintf(sink, "\"u_variable_decl\":{\"data_type\":");
+			break;
+		case CX_AST_NODE_TYPE_CONST_DECL:
+			fprintf(sink, "\"u_const_decl\":{\"data_type\":");
+			break;
+		case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+			fprintf(sink, "\"u_const_array_decl\":{\"data_type\":");
 			break;
 	}
 }
 
-void CX_AST_Node_print_json(CX_AST_Node *node, FILE *sink) {
-	fprintf(sink, "{");
-	if(node) switch(node->type) {
-		case CX_AST_NODE_TYPE_NULL:
-			fprintf(sink, "null");
+void CX_AST_JSON_Printer_between(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, size_t next_child) {
+	FILE *sink = ((CX_AST_JSON_Printer*) visitor)->sink;
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			fprintf(sink, ",\"rhs\":");
 			break;
-		case CX_AST_NODE_TYPE_ROOT:
-			fprintf(sink, "\"u_root\":{\"children\":[");
-			if(node->u_root.len > 0)
-				CX_AST_Node_print_json(&node->u_root.data[0], sink);
-			for(size_t i = 1; i < node->u_root.len; ++i) {
-				fprintf(sink, ",");
-				CX_AST_Node_print_json(&node->u_root.data[i], sink);
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			fprintf(sink, ",\"index\":");
+			break;
+		case CX_AST_NODE_TYPE_IF_STMT:
+			fprintf(sink, next_child == 1 ? ",\"then\":" : ",\"else\":");
+			break;
+		case CX_AST_NODE_TYPE_WHILE_STMT:
+			fprintf(sink, ",\"body\":");
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				size_t first_argument = 1 + CX_AST_type_arguments_count(ast, node);
+				if(next_child == 1 && first_argument > 1) fprintf(sink, ",\"type_arguments\":[");
+				else if(next_child == first_argument) fprintf(sink, first_argument > 1 ? "],\"arguments\":[" : ",\"arguments\":[");
+				else fprintf(sink, ",");
 			}
-			fprintf(sink, "]}");
 			break;
-		case CX_AST_NODE_TYPE_TYPE_ID:
-			fprintf(sink, "\"" PRIsv "\"", PRIsv_arg(node->u_type_id.value.value_sv));
+		case CX_AST_NODE_TYPE_FUNCTION_DECL:
+			{
+				// the type parameters and then the parameters are between the name and the body
+				size_t children_count = CX_AST_children_count(ast, node);
+				size_t first_parameter = 2 + CX_AST_type_parameters_count(ast, node);
+				if(next_child == 1) {
+					fprintf(sink, ",\"name\":");
+				} else if(next_child == 2 && first_parameter > 2) {
+					fprintf(sink, ",\"type_parameters\":[");
+				} else if(next_child == first_parameter && next_child < children_count - 1) {
+					fprintf(sink, first_parameter > 2 ? "],\"parameters\":[" : ",\"parameters\":[");
+				} else if(next_child == children_count - 1) {
+					fprintf(sink, next_child > 2 ? "],\"body\":" : ",\"body\":");
+				} else {
+					fprintf(sink, ",");
+				}
+			}
 			break;
-		case CX_AST_NODE_TYPE_NAME_ID:
-			fprintf(sink, "\"" PRIsv "\"", PRIsv_arg(node->u_name_id.value.value_sv));
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			fprintf(sink, ",\"name\":");
 			break;
-		case CX_AST_NODE_TYPE_NUMBER_LIT:
-			fprintf(sink, "\"u_number_lit\":%d", node->u_number_lit.value.value_int);
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+		case CX_AST_NODE_TYPE_CONST_DECL:
+			fprintf(sink, next_child == 1 ? ",\"name\":" : ",\"value\":");
 			break;
-		case CX_AST_NODE_TYPE_STRING_LIT:
-			fprintf(sink, "\"u_string_lit\":\"" PRIsv "\"", PRIsv_arg(node->u_number_lit.value.value_sv));
+		case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+			fprintf(sink, next_child == 1 ? ",\"name\":" : next_child == 2 ? ",\"length\":" : ",\"function\":");
 			break;
-		case CX_AST_NODE_TYPE_RETURN_STMT:
-			fprintf(sink, "\"u_return_stmt\":");
-			CX_AST_Node_print_json(node->u_return_stmt.expr, sink);
+		default:
+			fprintf(sink, ",");
 			break;
+	}
+}
+
+void CX_AST_JSON_Printer_leave(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	(void) parent;
+	FILE *sink = ((CX_AST_JSON_Printer*) visitor)->sink;
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_ROOT:
 		case CX_AST_NODE_TYPE_COMPOUND_STMT:
-			fprintf(sink, "\"u_compound_stmt\":{\"children\":[");
-			if(node->u_compound_stmt.len > 0)
-				CX_AST_Node_print_json(&node->u_compound_stmt.data[0], sink);
-			for(size_t i = 1; i < node->u_compound_stmt.len; ++i) {
-				fprintf(sink, ",");
-				CX_AST_Node_print_json(&node->u_compound_stmt.data[i], sink);
-			}
 			fprintf(sink, "]}");
 			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			fprintf(sink, CX_AST_children_count(ast, node) > 1 ? "]}" : "}");
+			break;
+		case CX_AST_NODE_TYPE_UNARY_EXPR:
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+		case CX_AST_NODE_TYPE_MEMBER_EXPR:
+		case CX_AST_NODE_TYPE_IF_STMT:
+		case CX_AST_NODE_TYPE_WHILE_STMT:
 		case CX_AST_NODE_TYPE_FUNCTION_DECL:
-			fprintf(sink, "\"u_function_decl\":{\"data_type\":");
-			CX_AST_Node_print_json(node->u_function_decl.data_type, sink);
-			fprintf(sink, ",\"name\":");
-			CX_AST_Node_print_json(node->u_function_decl.name, sink);
-			fprintf(sink, ",\"body\":");
-			CX_AST_Node_print_json(node->u_function_decl.body, sink);
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+		case CX_AST_NODE_TYPE_CONST_DECL:
+		case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
 			fprintf(sink, "}");
 			break;
+		default:
+			break;
 	}
 	fprintf(sink, "}");
 }
 
+void CX_AST_print_json(CX_AST *ast, CX_AST_Index node, FILE *sink) {
+	CX_AST_JSON_Printer printer = {
+		.visitor = {
+			.enter = CX_AST_JSON_Printer_enter,
+			.between = CX_AST_JSON_Printer_between,
+			.leave = CX_AST_JSON_Printer_leave
+		},
+		.sink = sink
+	};
+	CX_AST_walk(ast, node, &printer.visitor);
+}
+
+// Operators
+
+typedef enum {
+	PRECEDENCE_NONE,
+	PRECEDENCE_ASSIGNMENT, // right associative
+	PRECEDENCE_LOGIC_OR,
+	PRECEDENCE_LOGIC_AND,
+	PRECEDENCE_BIT_OR,
+	PRECEDENCE_BIT_XOR,
+	PRECEDENCE_BIT_AND,
+	PRECEDENCE_EQUALITY,
+	PRECEDENCE_RELATIONAL,
+	PRECEDENCE_SHIFT,
+	PRECEDENCE_ADDITIVE,
+	PRECEDENCE_MULTIPLICATIVE,
+	PRECEDENCE_PREFIX,
+} Precedence;
+
+// Binding power of the binary operators, PRECEDENCE_NONE for tokens which are not one
+const u8 binary_precedences[TOKEN_EOF + 1] = {
+	[TOKEN_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_PLUS_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_MINUS_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_TIMES_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_DIVIDE_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_MOD_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_AND_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_OR_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_XOR_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_SHIFT_LEFT_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_SHIFT_RIGHT_EQUALS] = PRECEDENCE_ASSIGNMENT,
+	[TOKEN_LOGIC_OR] = PRECEDENCE_LOGIC_OR,
+	[TOKEN_LOGIC_AND] = PRECEDENCE_LOGIC_AND,
+	[TOKEN_PIPE] = PRECEDENCE_BIT_OR,
+	[TOKEN_XOR] = PRECEDENCE_BIT_XOR,
+	[TOKEN_AMPERSTAND] = PRECEDENCE_BIT_AND,
+	[TOKEN_EQUALS_EQUALS] = PRECEDENCE_EQUALITY,
+	[TOKEN_NOT_EQUALS] = PRECEDENCE_EQUALITY,
+	[TOKEN_LESS_THAN] = PRECEDENCE_RELATIONAL,
+	[TOKEN_GREATER_THAN] = PRECEDENCE_RELATIONAL,
+	[TOKEN_LESS_EQUALS] = PRECEDENCE_RELATIONAL,
+	[TOKEN_GREATER_EQUALS] = PRECEDENCE_RELATIONAL,
+	[TOKEN_SHIFT_LEFT] = PRECEDENCE_SHIFT,
+	[TOKEN_SHIFT_RIGHT] = PRECEDENCE_SHIFT,
+	[TOKEN_PLUS] = PRECEDENCE_ADDITIVE,
+	[TOKEN_MINUS] = PRECEDENCE_ADDITIVE,
+	[TOKEN_ASTERISK] = PRECEDENCE_MULTIPLICATIVE,
+	[TOKEN_SLASH] = PRECEDENCE_MULTIPLICATIVE,
+	[TOKEN_MOD] = PRECEDENCE_MULTIPLICATIVE,
+};
+
+// The operator a compound assignment applies, TOKEN_NULL for the other tokens
+const u8 compound_assignment_operators[TOKEN_EOF + 1] = {
+	[TOKEN_PLUS_EQUALS] = TOKEN_PLUS,
+	[TOKEN_MINUS_EQUALS] = TOKEN_MINUS,
+	[TOKEN_TIMES_EQUALS] = TOKEN_ASTERISK,
+	[TOKEN_DIVIDE_EQUALS] = TOKEN_SLASH,
+	[TOKEN_MOD_EQUALS] = TOKEN_MOD,
+	[TOKEN_AND_EQUALS] = TOKEN_AMPERSTAND,
+	[TOKEN_OR_EQUALS] = TOKEN_PIPE,
+	[TOKEN_XOR_EQUALS] = TOKEN_XOR,
+	[TOKEN_SHIFT_LEFT_EQUALS] = TOKEN_SHIFT_LEFT,
+	[TOKEN_SHIFT_RIGHT_EQUALS] = TOKEN_SHIFT_RIGHT,
+};
+
+const bool prefix_operators[TOKEN_EOF + 1] = {
+	[TOKEN_PLUS] = true,
+	[TOKEN_MINUS] = true,
+	[TOKEN_NOT] = true,
+	[TOKEN_TILDE] = true,
+	[TOKEN_PLUS_PLUS] = true,
+	[TOKEN_MINUS_MINUS] = true,
+};
+
+// An operator waiting for its right operand, or an open parenthesis or `[` when `arity` is 0.
+// The parenthesis of a call keeps where the call's function waits on pending_children.
+typedef struct {
+	Token token;
+	u8 precedence;
+	u8 arity;
+	bool is_call;
+	u32 callee;
+} Parser_Operator;
+
+FORWARD_DECLARE_DARRAY(Parser_Operator)
+DECLARE_DARRAY(Parser_Operator)
+
+// A compound statement whose closing `}` has not been reached yet. The body of a `while` or of an
+// `if` has the statement's keyword, the condition is the pending child before the block's. An `if`
+// whose `else` branch is being parsed waits as a block without a `{`, over its condition and body.
+typedef struct {
+	Token open_curly;
+	Token keyword; // TOKEN_NULL for a block of its own
+	u32 children_start; // in pending_children
+} Parser_Block;
+
+FORWARD_DECLARE_DARRAY(Parser_Block)
+DECLARE_DARRAY(Parser_Block)
+
 typedef struct {
-	DARRAY(Token) *tokens;
+	TokenStream *tokens;
 	size_t cur;
 	bool eof, ok_so_far;
+	CX_AST *ast;
+	DARRAY(u32) pending_children; // children of the lists being parsed, the innermost one on top
+	DARRAY(Parser_Operator) operators; // of the expression being parsed
+	DARRAY(Parser_Block) blocks; // open compound statements, the innermost one on top
+	CX_AST_Index type_parameters; // the first of the function being parsed, they follow each other
+	u32 type_parameters_count;
 } Parser;
 
+void Parser_init(Parser *parser, TokenStream *tokens, CX_AST *ast) {
+	parser->tokens = tokens;
+	parser->cur = 0;
+	parser->eof = false;
+	parser->ok_so_far = true;
+	parser->ast = ast;
+	parser->type_parameters = parser->type_parameters_count = 0;
+	DARRAY_INIT(u32)(&parser->pending_children, 64);
+	DARRAY_INIT(Parser_Operator)(&parser->operators, 16);
+	DARRAY_INIT(Parser_Block)(&parser->blocks, 16);
+}
+
+void Parser_free(Parser *parser) {
+	DARRAY_FREE(u32)(&parser->pending_children);
+	DARRAY_FREE(Parser_Operator)(&parser->operators);
+	DARRAY_FREE(Parser_Block)(&parser->blocks);
+}
+
+Token_Type Parser_peek_type(Parser *parser) {
+	return TokenStream_type(parser->tokens, parser->cur);
+}
+
+Token_Type Parser_next_type(Parser *parser) {
+	Token_Type type = Parser_peek_type(parser);
+	if(type != TOKEN_NULL) ++parser->cur; // TOKEN_NULL past the end of the stream
+	TokenStream_release(parser->tokens, parser->cur); // the parser never backtracks
+	if(type == TOKEN_EOF) parser->eof = true;
+	return type;
+}
+
 Token Parser_peek_token(Parser *parser) {
-	if(parser->cur < parser->tokens->len) {
-		return parser->tokens->data[parser->cur];
-	} else {
-		return (Token) { 0 };
-	}
+	return TokenStream_at(parser->tokens, parser->cur);
 }
 
 Token Parser_next_token(Parser *parser) {
-	Token t = (parser->cur < parser->tokens->len) ? parser->tokens->data[parser->cur++] : (Token) { 0 };
-	if(t.type == TOKEN_EOF) parser->eof = true;
+	Token t = Parser_peek_token(parser);
+	Parser_next_type(parser);
 	return t;
 }
 
@@ -944,7 +2360,7 @@ Token __IMPL__Parser_expect_token(bool necessary, Parser *parser, ...) {
 	if(!token.type) {
 		va_list val;
 		va_start(val, parser);
-		if(necessary) loc_error(token.location, "expected '%s", Token_Type_to_string(va_arg(val, Token_Type)));
+		if(necessary) loc_error(Token_location(token), "expected '%s", Token_Type_to_string(va_arg(val, Token_Type)));
 		Token_Type t = va_arg(val, Token_Type);
 		while(t) {
 			if(necessary) fprintf(stderr, " or %s", Token_Type_to_string(t));
@@ -968,7 +2384,7 @@ Token __IMPL__Parser_expect_token(bool necessary, Parser *parser, ...) {
 	{
 		va_list val;
 		va_start(val, parser);
-		if(necessary) loc_error(token.location, "expected '%s", Token_Type_to_string(va_arg(val, Token_Type)));
+		if(necessary) loc_error(Token_location(token), "expected '%s", Token_Type_to_string(va_arg(val, Token_Type)));
 		Token_Type t = va_arg(val, Token_Type);
 		while(t) {
 			if(necessary) fprintf(stderr, " or %s", Token_Type_to_string(t));
@@ -983,506 +2399,4745 @@ Token __IMPL__Parser_expect_token(bool necessary, Parser *parser, ...) {
 
 #define Parser_expect_token(n, p, ...) __IMPL__Parser_expect_token(n, p, __VA_ARGS__, 0)
 
-// Parser_next literals
-
-bool Parser_next_number_lit(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
-
-	CX_AST_Node_number_lit(parent, out);
+// Parser_next
 
-	Token number = Parser_next_token(parser);
-	if(number.type != TOKEN_NUMBER) goto Parser_next_number_lit_cleanup;
-	out->u_number_lit.value = number;	
-
-	out->type = CX_AST_NODE_TYPE_NUMBER_LIT;
-	return true;
+// Every construct is recognized by its first token, or by its first two for a variable declaration
+// and an expression statement, which both start with a name, so a Parser_next_* function either returns 0
+// without consuming anything, when the next token can not start it, or commits to it. Once committed,
+// a mismatch is reported where it happens and parsing stops, nothing is ever parsed twice.
+// Consumed tokens are released from the TokenStream right away.
 
-Parser_next_number_lit_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
+// Reports that the next token does not continue the construct being parsed
+void Parser_error_expected(Parser *parser, char *what) {
+	parser->ok_so_far = false;
+	Location location = Token_location(Parser_peek_token(parser));
+	loc_error_cited(location, "expected %s\n", what);
 }
 
-bool Parser_next_string_lit(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
+// Parser_next literals
 
-	CX_AST_Node_string_lit(parent, out);
+CX_AST_Index Parser_next_number_lit(Parser *parser) {
+	if(Parser_peek_type(parser) != TOKEN_NUMBER) return 0;
 
-	Token string = Parser_next_token(parser);
-	if(string.type != TOKEN_STRING) goto Parser_next_string_lit_cleanup;
-	out->u_string_lit.value = string;
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_NUMBER_LIT, Parser_next_token(parser), NULL, 0);
+}
 
-	out->type = CX_AST_NODE_TYPE_STRING_LIT;
-	return true;
+CX_AST_Index Parser_next_string_lit(Parser *parser) {
+	if(Parser_peek_type(parser) != TOKEN_STRING) return 0;
 
-Parser_next_string_lit_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_STRING_LIT, Parser_next_token(parser), NULL, 0);
 }
 
 // Parser_next identifiers
 
-bool Parser_next_type_id(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
-
-	CX_AST_Node_type_id(parent, out);
+// The number of tokens of the `[]` or `[..]` at `index`, 0 when there is neither
+size_t Parser_type_suffix_at(Parser *parser, size_t index) {
+	TokenStream *tokens = parser->tokens;
+	if(TokenStream_type(tokens, index) != TOKEN_OPEN_SQUARE) return 0;
+	if(TokenStream_type(tokens, index + 1) == TOKEN_CLOSE_SQUARE) return 2;
+	bool dots = TokenStream_type(tokens, index + 1) == TOKEN_DOT && TokenStream_type(tokens, index + 2) == TOKEN_DOT;
+	return dots && TokenStream_type(tokens, index + 3) == TOKEN_CLOSE_SQUARE ? 4 : 0;
+}
 
-	Token data_type = Parser_next_token(parser);
-	if(data_type.type != TOKEN_NAME) goto Parser_next_type_id_cleanup;
-	out->u_type_id.value = data_type;	
+// A name and the `[]` and `[..]` after it, as a token with the symbol of the data type they spell
+bool Parser_next_data_type(Parser *parser, Token *data_type) {
+	if(Parser_peek_type(parser) != TOKEN_NAME) return false;
+	*data_type = Parser_next_token(parser);
 
-	out->type = CX_AST_NODE_TYPE_TYPE_ID;
+	for(size_t suffix; (suffix = Parser_type_suffix_at(parser, parser->cur)); ) {
+		data_type->value_symbol = Data_Type_compose(data_type->value_symbol, suffix == 2 ? DATA_TYPE_ARRAY : DATA_TYPE_SLICE);
+		while(suffix--) Parser_next_type(parser);
+	}
 	return true;
-
-Parser_next_type_id_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
 }
 
-bool Parser_next_name_id(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
+CX_AST_Index Parser_next_type_id(Parser *parser) {
+	Token data_type;
+	if(!Parser_next_data_type(parser, &data_type)) return 0;
 
-	CX_AST_Node_name_id(parent, out);
-
-	Token name = Parser_next_token(parser);
-	if(name.type != TOKEN_NAME) goto Parser_next_name_id_cleanup;
-	out->u_name_id.value = name;	
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_TYPE_ID, data_type, NULL, 0);
+}
 
-	out->type = CX_AST_NODE_TYPE_NAME_ID;
-	return true;
+CX_AST_Index Parser_next_name_id(Parser *parser) {
+	if(Parser_peek_type(parser) != TOKEN_NAME) return 0;
 
-Parser_next_name_id_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_NAME_ID, Parser_next_token(parser), NULL, 0);
 }
 
-// Parser_next statements
+// The name a declaration declares, which may not be a keyword
+CX_AST_Index Parser_next_declared_name_id(Parser *parser) {
+	if(Symbol_is_keyword(Parser_peek_token(parser).value_symbol)) return 0;
 
-bool Parser_next_return_stmt(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
+	return Parser_next_name_id(parser);
+}
 
-	CX_AST_Node_return_stmt(parent, out);
+// Parser_next expressions
+
+// Expressions are parsed by precedence climbing over an explicit operator stack, operands wait
+// on pending_children. Neither long operator chains nor deep parentheses recurse, and the only
+// allocations are the AST's own arrays and the two stacks, which are reused between expressions.
+// An index is parsed like a parenthesized expression, its `]` then applies it to the operand before
+// the `[`, which binds tighter than any operator. So are the arguments of a call, separated by
+// commas, which follow the name of a function and its type arguments. As in C#, `f<T>(` is a call
+// with type arguments rather than two comparisons. A variable's `.member` is part of its operand,
+// and so is the call of a `.method(...)`.
+
+// Replaces the operator on top of the stack and its operands with a node
+void Parser_reduce(Parser *parser) {
+	Parser_Operator op = parser->operators.data[--parser->operators.len];
+	parser->pending_children.len -= op.arity;
+	CX_AST_Node_Type kind = op.arity == 1 ? CX_AST_NODE_TYPE_UNARY_EXPR : CX_AST_NODE_TYPE_BINARY_EXPR;
+	CX_AST_Index node = CX_AST_push_node(parser->ast, kind, op.token, parser->pending_children.data + parser->pending_children.len, op.arity);
+	DARRAY_PUSH(u32)(&parser->pending_children, node);
+}
 
-	Token return_keyword = Parser_next_token(parser);
-	if(return_keyword.type != TOKEN_NAME) goto Parser_next_return_stmt_cleanup;
-	if(!sveq(return_keyword.value_sv, sv_from_cstr("return"))) goto Parser_next_return_stmt_cleanup;
+// A built-in data type or a type parameter of the function being parsed. Type arguments are told
+// apart from comparisons by naming one, as `a < b > (c)` compares.
+bool Parser_is_data_type(Parser *parser, Symbol name) {
+	if(name >= SYMBOL_B8 && name <= SYMBOL_F64) return true;
+	for(u32 i = 0; i < parser->type_parameters_count; ++i)
+		if(CX_AST_token(parser->ast, parser->type_parameters + i).value_symbol == name) return true;
+	return false;
+}
 
-	if(!Parser_next_number_lit(parser, out, out->u_return_stmt.expr))  {
-		parser->ok_so_far = false;
-		loc_error(parser->tokens->data[parser->cur].location, "invalid expression\n");
-		loc_error_cite(parser->tokens->data[parser->cur].location);
-		goto Parser_next_return_stmt_cleanup;
-	}
+// Whether `<` types `>` `(` follows
+bool Parser_at_type_arguments(Parser *parser) {
+	size_t i = parser->cur;
+	if(TokenStream_type(parser->tokens, i) != TOKEN_LESS_THAN) return false;
+	do {
+		if(TokenStream_type(parser->tokens, ++i) != TOKEN_NAME || !Parser_is_data_type(parser, TokenStream_at(parser->tokens, i).value_symbol)) return false;
+		for(size_t suffix; (suffix = Parser_type_suffix_at(parser, i + 1)); ) i += suffix;
+	} while(TokenStream_type(parser->tokens, ++i) == TOKEN_COMMA);
+	return TokenStream_type(parser->tokens, i) == TOKEN_GREATER_THAN && TokenStream_type(parser->tokens, i + 1) == TOKEN_OPEN_PARENTHESIS;
+}
 
-	Token semicolon = Parser_next_token(parser);
-	if(semicolon.type != TOKEN_SEMICOLON) goto Parser_next_return_stmt_cleanup;
+// Replaces a call's function, type arguments and arguments on pending_children with its node
+void Parser_reduce_call(Parser *parser, Parser_Operator call) {
+	size_t children_count = parser->pending_children.len - call.callee;
+	parser->pending_children.len = call.callee;
+	CX_AST_Index node = CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_CALL_EXPR, call.token, parser->pending_children.data + call.callee, children_count);
+	DARRAY_PUSH(u32)(&parser->pending_children, node);
+}
 
-	out->type = CX_AST_NODE_TYPE_RETURN_STMT;
-	return true;
+CX_AST_Index Parser_next_expr(Parser *parser) {
+	size_t operators_start = parser->operators.len;
+	size_t operands_start = parser->pending_children.len;
+	size_t open_groups = 0; // parentheses, indices and calls
 
-Parser_next_return_stmt_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
-}
+	for(;;) {
+		Token token = Parser_peek_token(parser);
 
-bool Parser_next_compound_stmt(Parser*, CX_AST_Node*, CX_AST_Node*); // Forward declaration
+		if(token.type == TOKEN_OPEN_PARENTHESIS || prefix_operators[token.type]) {
+			Parser_Operator op = { .token = token, .precedence = PRECEDENCE_PREFIX, .arity = 1 };
+			if(token.type == TOKEN_OPEN_PARENTHESIS) {
+				op.precedence = PRECEDENCE_NONE;
+				op.arity = 0;
+				++open_groups;
+			}
+			DARRAY_PUSH(Parser_Operator)(&parser->operators, op);
+			Parser_next_type(parser);
+			continue;
+		}
 
-bool Parser_next_stmt(Parser *parser, CX_AST_Node *parent, CX_AST_Node *stmt) {
-	if(Parser_next_return_stmt(parser, parent, stmt)) return true;
-	if(Parser_next_compound_stmt(parser, parent, stmt)) return true;
+		CX_AST_Index operand = 0;
+		switch(token.type) {
+			case TOKEN_NUMBER:
+				operand = Parser_next_number_lit(parser);
+				break;
+			case TOKEN_STRING:
+				operand = Parser_next_string_lit(parser);
+				break;
+			case TOKEN_NAME:
+				if(!Symbol_is_keyword(token.value_symbol)) operand = Parser_next_name_id(parser);
+				break;
+			default:
+				break;
+		}
+		if(!operand) {
+			// nothing is consumed when the first token can not start an expression
+			if(parser->operators.len != operators_start) Parser_error_expected(parser, "an expression");
+			goto Parser_next_expr_cleanup;
+		}
+		DARRAY_PUSH(u32)(&parser->pending_children, operand);
+
+		token = Parser_peek_token(parser);
+		bool is_name = CX_AST_kind(parser->ast, operand) == CX_AST_NODE_TYPE_NAME_ID;
+		if(is_name && token.type == TOKEN_DOT && TokenStream_type(parser->tokens, parser->cur + 1) == TOKEN_NAME) {
+			Parser_next_type(parser);
+			operand = CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_MEMBER_EXPR, Parser_next_token(parser), &operand, 1);
+			parser->pending_children.data[parser->pending_children.len - 1] = operand;
+			token = Parser_peek_token(parser);
+			is_name = false;
+		}
 
-	return false;
-}
+		bool is_function = is_name || CX_AST_kind(parser->ast, operand) == CX_AST_NODE_TYPE_MEMBER_EXPR;
+		if(is_function && (token.type == TOKEN_OPEN_PARENTHESIS || (is_name && Parser_at_type_arguments(parser)))) {
+			Parser_Operator call = { .precedence = PRECEDENCE_NONE, .arity = 0, .is_call = true, .callee = parser->pending_children.len - 1 };
+			if(token.type == TOKEN_LESS_THAN) {
+				Parser_next_type(parser);
+				do {
+					DARRAY_PUSH(u32)(&parser->pending_children, Parser_next_type_id(parser));
+				} while(Parser_next_type(parser) == TOKEN_COMMA); // up to the `>`
+			}
+			call.token = Parser_next_token(parser);
 
-bool Parser_next_compound_stmt(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
+			if(Parser_peek_type(parser) != TOKEN_CLOSE_PARENTHESIS) {
+				DARRAY_PUSH(Parser_Operator)(&parser->operators, call);
+				++open_groups;
+				continue;
+			}
+			Parser_next_type(parser);
+			Parser_reduce_call(parser, call);
+			token = Parser_peek_token(parser);
+		}
 
-	CX_AST_Node_compound_stmt(parent, out);
+		bool next_argument = false;
+		while(open_groups) {
+			if(token.type == TOKEN_COMMA) {
+				while(parser->operators.data[parser->operators.len - 1].arity) Parser_reduce(parser);
+				next_argument = parser->operators.data[parser->operators.len - 1].is_call;
+				if(next_argument) Parser_next_type(parser);
+				break;
+			}
+			if(token.type != TOKEN_CLOSE_PARENTHESIS && token.type != TOKEN_CLOSE_SQUARE) break;
 
-	Token oc = Parser_next_token(parser);
-	if(oc.type != TOKEN_OPEN_CURLY) goto Parser_next_compound_stmt_cleanup;
+			while(parser->operators.data[parser->operators.len - 1].arity) Parser_reduce(parser);
+			Parser_Operator group = parser->operators.data[--parser->operators.len];
+			if((group.token.type == TOKEN_OPEN_SQUARE) != (token.type == TOKEN_CLOSE_SQUARE)) {
+				Parser_error_expected(parser, group.token.type == TOKEN_OPEN_SQUARE ? "']'" : "')'");
+				goto Parser_next_expr_cleanup;
+			}
+			--open_groups;
+			Parser_next_type(parser);
+
+			if(group.token.type == TOKEN_OPEN_SQUARE) {
+				parser->pending_children.len -= 2;
+				CX_AST_Index node = CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_INDEX_EXPR, group.token, parser->pending_children.data + parser->pending_children.len, 2);
+				DARRAY_PUSH(u32)(&parser->pending_children, node);
+			} else if(group.is_call) {
+				Parser_reduce_call(parser, group);
+			}
+			token = Parser_peek_token(parser);
+		}
+		if(next_argument) continue;
+
+		if(token.type == TOKEN_OPEN_SQUARE) {
+			Parser_Operator op = { .token = token, .precedence = PRECEDENCE_NONE, .arity = 0 };
+			DARRAY_PUSH(Parser_Operator)(&parser->operators, op);
+			++open_groups;
+			Parser_next_type(parser);
+			continue;
+		}
 
-	CX_AST_Node stmt;
+		Precedence precedence = binary_precedences[token.type];
+		if(!precedence) break;
 
-Parser_next_compound_stmt_more:
+		while(parser->operators.len > operators_start) {
+			Parser_Operator top = parser->operators.data[parser->operators.len - 1];
+			if(!top.arity) break;
+			if(top.precedence < precedence) break;
+			if(top.precedence == precedence && precedence == PRECEDENCE_ASSIGNMENT) break;
+			Parser_reduce(parser);
+		}
 
-	if(Parser_next_stmt(parser, out, &stmt)) {
-		DARRAY_PUSH(CX_AST_Node)((DARRAY(CX_AST_Node)*) &out->u_compound_stmt, stmt);
-	} else {
-		goto Parser_next_compound_stmt_cleanup;
+		Parser_Operator op = { .token = token, .precedence = precedence, .arity = 2 };
+		DARRAY_PUSH(Parser_Operator)(&parser->operators, op);
+		Parser_next_type(parser);
 	}
 
-	Token peeked_token = Parser_peek_token(parser);
-	if(peeked_token.type != TOKEN_CLOSE_CURLY) goto Parser_next_compound_stmt_more;
+	if(open_groups) {
+		size_t innermost = parser->operators.len;
+		while(parser->operators.data[--innermost].arity);
+		Parser_error_expected(parser, parser->operators.data[innermost].token.type == TOKEN_OPEN_SQUARE ? "']'" : "')'");
+		goto Parser_next_expr_cleanup;
+	}
 
-	Token cc = Parser_next_token(parser);
-	if(cc.type != TOKEN_CLOSE_CURLY) goto Parser_next_compound_stmt_cleanup;
+	while(parser->operators.len > operators_start) Parser_reduce(parser);
 
-	out->type = CX_AST_NODE_TYPE_COMPOUND_STMT;
-	return true;
+	assert(parser->pending_children.len == operands_start + 1);
+	return parser->pending_children.data[--parser->pending_children.len];
 
-Parser_next_compound_stmt_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
+Parser_next_expr_cleanup:
+	parser->operators.len = operators_start;
+	parser->pending_children.len = operands_start;
+	return 0;
 }
 
-// Parser_next declarations
+// Parser_next statements
 
-bool Parser_next_function_decl(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	size_t saved_cur = parser->cur;
+bool Parser_peek_keyword(Parser *parser, Symbol keyword) {
+	Token token = Parser_peek_token(parser);
+	return token.type == TOKEN_NAME && token.value_symbol == keyword;
+}
 
-	CX_AST_Node_function_decl(parent, out);
+CX_AST_Index Parser_next_return_stmt(Parser *parser) {
+	if(!Parser_peek_keyword(parser, SYMBOL_RETURN)) return 0;
+	Token return_keyword = Parser_next_token(parser);
 
-	if(!Parser_next_type_id(parser, out, out->u_function_decl.data_type)) goto Parser_next_function_decl_cleanup;
+	CX_AST_Index expr = Parser_next_expr(parser);
+	if(!expr) {
+		if(!parser->ok_so_far) return 0;
+		parser->ok_so_far = false;
+		Location location = Token_location(Parser_peek_token(parser));
+		loc_error_cited(location, "invalid expression\n");
+		return 0;
+	}
 
-	if(!Parser_next_name_id(parser, out, out->u_function_decl.name)) goto Parser_next_function_decl_cleanup;
+	if(Parser_peek_type(parser) != TOKEN_SEMICOLON) {
+		Parser_error_expected(parser, "';'");
+		return 0;
+	}
+	Parser_next_type(parser);
 
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_RETURN_STMT, return_keyword, &expr, 1);
+}
+
+// expr;
+CX_AST_Index Parser_next_expr_stmt(Parser *parser) {
+	CX_AST_Index expr = Parser_next_expr(parser);
+	if(!expr) return 0;
+
+	if(Parser_peek_type(parser) != TOKEN_SEMICOLON) {
+		Parser_error_expected(parser, "';'");
+		return 0;
+	}
+
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_EXPR_STMT, Parser_next_token(parser), &expr, 1);
+}
+
+CX_AST_Index Parser_next_compound_stmt(Parser*); // Forward declaration
+CX_AST_Index Parser_next_const_decl(Parser*); // Forward declaration
+CX_AST_Index Parser_next_variable_decl(Parser*); // Forward declaration
+
+// Any statement but a compound one, an `if` or a `while`, which Parser_next_compound_stmt parses
+CX_AST_Index Parser_next_stmt(Parser *parser) {
+	switch(Parser_peek_type(parser)) {
+		case TOKEN_NAME:
+			if(Parser_peek_keyword(parser, SYMBOL_CONST)) return Parser_next_const_decl(parser);
+			if(Parser_peek_keyword(parser, SYMBOL_RETURN)) return Parser_next_return_stmt(parser);
+			if(TokenStream_type(parser->tokens, parser->cur + 1) == TOKEN_NAME || Parser_type_suffix_at(parser, parser->cur + 1))
+				return Parser_next_variable_decl(parser);
+			return Parser_next_expr_stmt(parser);
+		case TOKEN_OPEN_CURLY:
+			return Parser_next_compound_stmt(parser);
+		default:
+			return Parser_next_expr_stmt(parser);
+	}
+}
+
+// `while (condition) {` or `if (condition) {`, leaves the condition on pending_children under the
+// block it opens. Returns false after reporting an error.
+bool Parser_open_conditional_block(Parser *parser) {
+	Token keyword = Parser_next_token(parser);
+
+	if(Parser_peek_type(parser) != TOKEN_OPEN_PARENTHESIS) {
+		Parser_error_expected(parser, "'('");
+		return false;
+	}
+	Parser_next_type(parser);
+
+	CX_AST_Index condition = Parser_next_expr(parser);
+	if(!condition) {
+		if(parser->ok_so_far) Parser_error_expected(parser, "a condition");
+		return false;
+	}
+
+	if(Parser_peek_type(parser) != TOKEN_CLOSE_PARENTHESIS) {
+		Parser_error_expected(parser, "')'");
+		return false;
+	}
+	Parser_next_type(parser);
+
+	if(Parser_peek_type(parser) != TOKEN_OPEN_CURLY) {
+		Parser_error_expected(parser, "'{'");
+		return false;
+	}
+	DARRAY_PUSH(u32)(&parser->pending_children, condition);
+	Parser_Block block = {
+		.open_curly = Parser_next_token(parser),
+		.keyword = keyword,
+		.children_start = parser->pending_children.len
+	};
+	DARRAY_PUSH(Parser_Block)(&parser->blocks, block);
+	return true;
+}
+
+// Makes the statement whose body `block` was into `*stmt`, and the `if`s waiting for it as their
+// `else` branch. Leaves `*stmt` 0 when an `else` branch follows. Returns false after reporting an error.
+bool Parser_close_block(Parser *parser, Parser_Block block, CX_AST_Index *stmt) {
+	CX_AST *ast = parser->ast;
+	DARRAY(u32) *pending = &parser->pending_children;
+	CX_AST_Index children[3];
+
+	if(block.keyword.type && block.keyword.value_symbol == SYMBOL_WHILE) {
+		children[0] = pending->data[--pending->len];
+		children[1] = *stmt;
+		*stmt = CX_AST_push_node(ast, CX_AST_NODE_TYPE_WHILE_STMT, block.keyword, children, 2);
+	} else if(block.keyword.type) {
+		if(Parser_peek_keyword(parser, SYMBOL_ELSE)) {
+			Parser_next_type(parser);
+			DARRAY_PUSH(u32)(pending, *stmt);
+			Parser_Block waiting = { .keyword = block.keyword, .children_start = pending->len };
+			DARRAY_PUSH(Parser_Block)(&parser->blocks, waiting);
+			*stmt = 0;
+
+			if(Parser_peek_keyword(parser, SYMBOL_IF)) return Parser_open_conditional_block(parser);
+			if(Parser_peek_type(parser) != TOKEN_OPEN_CURLY) {
+				Parser_error_expected(parser, "'{' or 'if'");
+				return false;
+			}
+			Parser_Block else_block = { .open_curly = Parser_next_token(parser), .children_start = pending->len };
+			DARRAY_PUSH(Parser_Block)(&parser->blocks, else_block);
+			return true;
+		}
+		children[0] = pending->data[--pending->len];
+		children[1] = *stmt;
+		*stmt = CX_AST_push_node(ast, CX_AST_NODE_TYPE_IF_STMT, block.keyword, children, 2);
+	}
+
+	while(parser->blocks.len && !parser->blocks.data[parser->blocks.len - 1].open_curly.type) {
+		Parser_Block waiting = parser->blocks.data[--parser->blocks.len];
+		pending->len -= 2;
+		children[0] = pending->data[pending->len];
+		children[1] = pending->data[pending->len + 1];
+		children[2] = *stmt;
+		*stmt = CX_AST_push_node(ast, CX_AST_NODE_TYPE_IF_STMT, waiting.keyword, children, 3);
+	}
+	return true;
+}
+
+// Nested blocks, and the bodies of `if`s and `while`s, are kept on parser->blocks rather than the
+// C stack, any other statement is parsed by Parser_next_stmt
+CX_AST_Index Parser_next_compound_stmt(Parser *parser) {
+	if(Parser_peek_type(parser) != TOKEN_OPEN_CURLY) return 0;
+
+	size_t blocks_start = parser->blocks.len;
+
+	for(;;) {
+		switch(Parser_peek_type(parser)) {
+			case TOKEN_OPEN_CURLY: {
+				Parser_Block block = {
+					.open_curly = Parser_next_token(parser),
+					.children_start = parser->pending_children.len
+				};
+				DARRAY_PUSH(Parser_Block)(&parser->blocks, block);
+			} break;
+			case TOKEN_CLOSE_CURLY: {
+				Parser_next_type(parser);
+				Parser_Block block = parser->blocks.data[--parser->blocks.len];
+				size_t children_count = parser->pending_children.len - block.children_start;
+				parser->pending_children.len = block.children_start;
+				CX_AST_Index node = CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_COMPOUND_STMT, block.open_curly, parser->pending_children.data + block.children_start, children_count);
+				if(!Parser_close_block(parser, block, &node)) goto Parser_next_compound_stmt_cleanup;
+				if(!node) break;
+				if(parser->blocks.len == blocks_start) return node;
+				DARRAY_PUSH(u32)(&parser->pending_children, node);
+			} break;
+			default: {
+				if(Parser_peek_keyword(parser, SYMBOL_IF) || Parser_peek_keyword(parser, SYMBOL_WHILE)) {
+					if(!Parser_open_conditional_block(parser)) goto Parser_next_compound_stmt_cleanup;
+					break;
+				}
+				CX_AST_Index stmt = Parser_next_stmt(parser);
+				if(!stmt) {
+					if(parser->ok_so_far) Parser_error_expected(parser, "a statement or '}'");
+					goto Parser_next_compound_stmt_cleanup;
+				}
+				DARRAY_PUSH(u32)(&parser->pending_children, stmt);
+			} break;
+		}
+	}
+
+Parser_next_compound_stmt_cleanup:
+	parser->pending_children.len = parser->blocks.data[blocks_start].children_start;
+	parser->blocks.len = blocks_start;
+	return 0;
+}
+
+// Parser_next declarations
+
+// data_type name
+CX_AST_Index Parser_next_parameter_decl(Parser *parser) {
+	CX_AST_Index children[2]; // data_type, name
+
+	if(!(children[0] = Parser_next_type_id(parser))) return 0;
+
+	Token name = Parser_peek_token(parser);
+	if(!(children[1] = Parser_next_declared_name_id(parser))) {
+		Parser_error_expected(parser, "a parameter name");
+		return 0;
+	}
+
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_PARAMETER_DECL, name, children, 2);
+}
+
+// The children wait on pending_children, as there may be any number of parameters.
+// data_type name<T, ...>(parameters...) body
+CX_AST_Index Parser_next_function_decl(Parser *parser) {
+	DARRAY(u32) *pending = &parser->pending_children;
+	size_t children_start = pending->len; // data_type, name, type parameters..., parameters..., body
+	CX_AST_Index child;
+
+	Token data_type; // its node follows the type parameters it may name
+	if(!Parser_next_data_type(parser, &data_type)) return 0;
+	DARRAY_PUSH(u32)(pending, 0);
+
+	if(!(child = Parser_next_declared_name_id(parser))) {
+		Parser_error_expected(parser, "a function name");
+		goto Parser_next_function_decl_cleanup;
+	}
+	DARRAY_PUSH(u32)(pending, child);
+
+	if(Parser_peek_type(parser) == TOKEN_LESS_THAN) {
+		do {
+			Parser_next_type(parser);
+			if(Parser_peek_type(parser) != TOKEN_NAME || Symbol_is_keyword(Parser_peek_token(parser).value_symbol)) {
+				Parser_error_expected(parser, "a type parameter");
+				goto Parser_next_function_decl_cleanup;
+			}
+			DARRAY_PUSH(u32)(pending, CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL, Parser_next_token(parser), NULL, 0));
+			if(!parser->type_parameters_count++) parser->type_parameters = pending->data[pending->len - 1];
+		} while(Parser_peek_type(parser) == TOKEN_COMMA);
+
+		if(Parser_peek_type(parser) != TOKEN_GREATER_THAN) {
+			Parser_error_expected(parser, "',' or '>'");
+			goto Parser_next_function_decl_cleanup;
+		}
+		Parser_next_type(parser);
+	}
+	size_t parameters_start = pending->len;
+	pending->data[children_start] = CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_TYPE_ID, data_type, NULL, 0);
+
+	if(Parser_peek_type(parser) != TOKEN_OPEN_PARENTHESIS) {
+		Parser_error_expected(parser, "'('");
+		goto Parser_next_function_decl_cleanup;
+	}
 	Token op = Parser_next_token(parser);
-	if(op.type != TOKEN_OPEN_PARENTHESIS) goto Parser_next_function_decl_cleanup;
 
-	// TODO: parse parameters
+	while(Parser_peek_type(parser) != TOKEN_CLOSE_PARENTHESIS) {
+		if(pending->len > parameters_start) {
+			if(Parser_peek_type(parser) != TOKEN_COMMA) {
+				Parser_error_expected(parser, "',' or ')'");
+				goto Parser_next_function_decl_cleanup;
+			}
+			Parser_next_type(parser);
+		}
+		if(!(child = Parser_next_parameter_decl(parser))) {
+			if(parser->ok_so_far) Parser_error_expected(parser, "a parameter");
+			goto Parser_next_function_decl_cleanup;
+		}
+		DARRAY_PUSH(u32)(pending, child);
+	}
+	Parser_next_type(parser);
+
+	if(!(child = Parser_next_compound_stmt(parser))) {
+		if(parser->ok_so_far) Parser_error_expected(parser, "'{'");
+		goto Parser_next_function_decl_cleanup;
+	}
+	DARRAY_PUSH(u32)(pending, child);
+
+	size_t children_count = pending->len - children_start;
+	pending->len = children_start;
+	parser->type_parameters_count = 0;
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_FUNCTION_DECL, op, pending->data + children_start, children_count);
+
+Parser_next_function_decl_cleanup:
+	pending->len = children_start;
+	parser->type_parameters_count = 0;
+	return 0;
+}
+
+// data_type name = value;
+// data_type name; for arrays and slices, which start out empty
+CX_AST_Index Parser_next_variable_decl(Parser *parser) {
+	CX_AST_Index children[3]; // data_type, name, value
+
+	if(!(children[0] = Parser_next_type_id(parser))) return 0;
+
+	Token name = Parser_peek_token(parser);
+	if(!(children[1] = Parser_next_declared_name_id(parser))) {
+		Parser_error_expected(parser, "a variable name");
+		return 0;
+	}
+
+	bool composite = Data_Type_kind(CX_AST_token(parser->ast, children[0]).value_symbol) != DATA_TYPE_NAMED;
+	if(composite && Parser_peek_type(parser) == TOKEN_SEMICOLON) {
+		Parser_next_type(parser);
+		return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_VARIABLE_DECL, name, children, 2);
+	}
+
+	if(Parser_peek_type(parser) != TOKEN_EQUALS) {
+		Parser_error_expected(parser, "'='");
+		return 0;
+	}
+	Token equals = Parser_next_token(parser);
+
+	if(!(children[2] = Parser_next_expr(parser))) {
+		if(parser->ok_so_far) Parser_error_expected(parser, "an expression");
+		return 0;
+	}
+
+	if(Parser_peek_type(parser) != TOKEN_SEMICOLON) {
+		Parser_error_expected(parser, "';'");
+		return 0;
+	}
+	Parser_next_type(parser);
+
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_VARIABLE_DECL, equals, children, 3);
+}
+
+// const data_type name = value;
+// const data_type name[length] = comptime function;
+CX_AST_Index Parser_next_const_decl(Parser *parser) {
+	if(!Parser_peek_keyword(parser, SYMBOL_CONST)) return 0;
+	Token const_keyword = Parser_next_token(parser);
+
+	CX_AST_Index children[4]; // data_type, name, value or length, function
+	bool array = false;
+
+	if(!(children[0] = Parser_next_type_id(parser))) {
+		Parser_error_expected(parser, "a data type");
+		return 0;
+	}
+
+	if(!(children[1] = Parser_next_declared_name_id(parser))) {
+		Parser_error_expected(parser, "a constant name");
+		return 0;
+	}
+
+	if(Parser_peek_type(parser) == TOKEN_OPEN_SQUARE) {
+		array = true;
+		Parser_next_type(parser);
+
+		if(!(children[2] = Parser_next_expr(parser))) {
+			if(parser->ok_so_far) Parser_error_expected(parser, "an array length");
+			return 0;
+		}
+
+		if(Parser_peek_type(parser) != TOKEN_CLOSE_SQUARE) {
+			Parser_error_expected(parser, "']'");
+			return 0;
+		}
+		Parser_next_type(parser);
+	}
+
+	if(Parser_peek_type(parser) != TOKEN_EQUALS) {
+		Parser_error_expected(parser, "'='");
+		return 0;
+	}
+	Parser_next_type(parser);
+
+	if(array) {
+		if(!Parser_peek_keyword(parser, SYMBOL_COMPTIME)) {
+			Parser_error_expected(parser, "'comptime'");
+			return 0;
+		}
+		Parser_next_type(parser);
+
+		if(!(children[3] = Parser_next_name_id(parser))) {
+			Parser_error_expected(parser, "a function name");
+			return 0;
+		}
+	} else if(!(children[2] = Parser_next_expr(parser))) {
+		if(parser->ok_so_far) Parser_error_expected(parser, "an expression");
+		return 0;
+	}
+
+	if(Parser_peek_type(parser) != TOKEN_SEMICOLON) {
+		Parser_error_expected(parser, "';'");
+		return 0;
+	}
+	Parser_next_type(parser);
+
+	if(array) return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_CONST_ARRAY_DECL, const_keyword, children, 4);
+	return CX_AST_push_node(parser->ast, CX_AST_NODE_TYPE_CONST_DECL, const_keyword, children, 3);
+}
+
+// end Parser_next declarations
+
+CX_AST_Index Parser_next_root_child(Parser *parser) {
+	switch(Parser_peek_type(parser)) {
+		case TOKEN_NAME:
+			if(Parser_peek_keyword(parser, SYMBOL_CONST)) return Parser_next_const_decl(parser);
+			return Parser_next_function_decl(parser);
+		default:
+			return 0;
+	}
+}
+
+// end Parser_nexts
+
+// Semantic analysis
+
+typedef struct {
+	SymbolMap *data_type_translations;
+} SemanticStructure;
+
+// A single scan over the nodes. The only context checks depend on are the type parameters of the
+// generic function being scanned, which come before its other nodes, see CX_AST. Returns false
+// when it reports an error.
+bool analyse_semantics(CX_AST *ast, SemanticStructure *semantic_structure) {
+	DARRAY(u8) type_parameters = { 0 }; // by symbol, set up for the first generic function
+	bool ok = true;
+
+	for(CX_AST_Index node = 1; node < ast->kinds.len; ++node) {
+		switch(CX_AST_kind(ast, node)) {
+			case CX_AST_NODE_TYPE_NULL:
+				assert(false && "unreachable");
+				break;
+			case CX_AST_NODE_TYPE_ROOT:
+				break;
+			case CX_AST_NODE_TYPE_TYPE_ID:
+				{
+					Token data_type = CX_AST_token(ast, node);
+					Symbol base = Data_Type_base(data_type.value_symbol);
+					bool is_type_parameter = base < type_parameters.len && type_parameters.data[base];
+					if(!SymbolMap_at(semantic_structure->data_type_translations, base) && !is_type_parameter) {
+						loc_error(Token_location(data_type), " unknown data type: " PRIsv "\n", PRIsv_arg(Symbol_sv(base)));
+						ok = false;
+					}
+				}
+				break;
+			case CX_AST_NODE_TYPE_NAME_ID: // keywords are not parsed as names, see Parser_next_expr
+				break;
+			case CX_AST_NODE_TYPE_NUMBER_LIT: // see evaluate_constants
+				break;
+			case CX_AST_NODE_TYPE_STRING_LIT:
+				// TODO
+				break;
+			case CX_AST_NODE_TYPE_UNARY_EXPR:
+			case CX_AST_NODE_TYPE_BINARY_EXPR:
+				{
+					Token op = CX_AST_token(ast, node);
+					bool assigns = op.type == TOKEN_PLUS_PLUS || op.type == TOKEN_MINUS_MINUS || binary_precedences[op.type] == PRECEDENCE_ASSIGNMENT;
+					CX_AST_Node_Type target = CX_AST_kind(ast, CX_AST_child(ast, node, 0));
+					if(assigns && target != CX_AST_NODE_TYPE_NAME_ID && target != CX_AST_NODE_TYPE_INDEX_EXPR) {
+						loc_error(Token_location(op), " can not assign to the operand of '%s'\n", operator_spellings[op.type]);
+						ok = false;
+					}
+				}
+				break;
+			case CX_AST_NODE_TYPE_INDEX_EXPR:
+			case CX_AST_NODE_TYPE_CALL_EXPR: // see instantiate_generics
+			case CX_AST_NODE_TYPE_MEMBER_EXPR: // see resolve_arrays
+				break;
+			case CX_AST_NODE_TYPE_RETURN_STMT:
+				// TODO
+				break;
+			case CX_AST_NODE_TYPE_COMPOUND_STMT:
+			case CX_AST_NODE_TYPE_EXPR_STMT:
+			case CX_AST_NODE_TYPE_IF_STMT:
+			case CX_AST_NODE_TYPE_WHILE_STMT:
+				break;
+			case CX_AST_NODE_TYPE_FUNCTION_DECL:
+				// its type parameters go out of scope
+				for(size_t i = 0; type_parameters.len && i < CX_AST_type_parameters_count(ast, node); ++i)
+					type_parameters.data[CX_AST_token(ast, CX_AST_child(ast, node, 2 + i)).value_symbol] = false;
+				break;
+			case CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL:
+				{
+					Token name = CX_AST_token(ast, node);
+					if(!type_parameters.len) {
+						DARRAY_INIT(u8)(&type_parameters, symbols._from.len);
+						memset(type_parameters.data, 0, symbols._from.len);
+						type_parameters.len = symbols._from.len;
+					}
+					if(SymbolMap_at(semantic_structure->data_type_translations, name.value_symbol) || type_parameters.data[name.value_symbol]) {
+						loc_error(Token_location(name), " '" PRIsv "' is already a data type\n", PRIsv_arg(Symbol_sv(name.value_symbol)));
+						ok = false;
+					}
+					type_parameters.data[name.value_symbol] = true;
+				}
+				break;
+			case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			case CX_AST_NODE_TYPE_CONST_DECL:
+			case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+				break;
+		}
+	}
+
+	if(type_parameters.len) DARRAY_FREE(u8)(&type_parameters);
+	return ok;
+}
+
+// Constant evaluation
+
+// Works out the value of every expression whose operands are all known while compiling: number
+// literals, `const` declarations and the operators over them, so the generated C carries the
+// results as literals. Values are computed in the types C's promotions and usual arithmetic
+// conversions give, wrapping around in unsigned types and rounding to f32 and f64, so they are
+// what the C would have computed. What C leaves undefined or up to the implementation, like signed
+// overflow, division by zero, shifts by the width or more and conversions to a type which can not
+// hold the value, is an error instead. Right shifts of negative values are arithmetic, as in gcc.
+// Integer literals are the first of i32, i64 and u64 which holds them, literals with a fraction
+// or an exponent are f64. Values are kept beside the AST, which may be mapped read-only.
+// The elements of a constant array are the values a function returns for each index, see
+// Comptime_Interpreter.
+
+typedef struct {
+	u8 bits;
+	bool is_signed, is_float;
+} Constant_Type;
+
+// Indexed by Builtin_Symbol, the types that are not constants' have 0 bits
+const Constant_Type constant_types[SYMBOL_BUILTIN_COUNT] = {
+	[SYMBOL_B8] = { 1, false, false },
+	[SYMBOL_I8] = { 8, true, false },
+	[SYMBOL_I16] = { 16, true, false },
+	[SYMBOL_I32] = { 32, true, false },
+	[SYMBOL_I64] = { 64, true, false },
+	[SYMBOL_U8] = { 8, false, false },
+	[SYMBOL_U16] = { 16, false, false },
+	[SYMBOL_U32] = { 32, false, false },
+	[SYMBOL_U64] = { 64, false, false },
+	[SYMBOL_F32] = { 32, true, true },
+	[SYMBOL_F64] = { 64, true, true },
+};
+
+_Static_assert(SYMBOL_BUILTIN_COUNT <= 256, "Constants::types holds a Builtin_Symbol in a byte");
+
+typedef struct {
+	Symbol type; // SYMBOL_NULL when the value is not known
+	union {
+		i64 i; // signed integers
+		u64 u; // unsigned integers and b8
+		double f; // an f32 holds a float's value
+	};
+} Constant;
+
+FORWARD_DECLARE_DARRAY(Constant)
+DECLARE_DARRAY(Constant)
+
+typedef struct {
+	DARRAY(u8) types;   // Constant::type of every node, SYMBOL_NULL for the nodes without a value
+	DARRAY(u64) values; // Constant::u
+	// A CONST_ARRAY_DECL has the type of its elements, its value is the index of its length in
+	// here, which the elements follow. An INDEX_EXPR without a value has the CONST_ARRAY_DECL it
+	// indexes as its value, or 0.
+	DARRAY(u64) elements;
+	size_t folded;   // operators replaced by their value, for --stats
+	size_t computed; // array elements, for --stats
+} Constants;
+
+void Constants_init(Constants *constants, size_t node_count) {
+	DARRAY_INIT(u8)(&constants->types, node_count);
+	DARRAY_INIT(u64)(&constants->values, node_count);
+	DARRAY_INIT(u64)(&constants->elements, 0);
+	memset(constants->types.data, 0, node_count);
+	constants->types.len = constants->values.len = node_count;
+	constants->folded = constants->computed = 0;
+}
+
+void Constants_free(Constants *constants) {
+	DARRAY_FREE(u8)(&constants->types);
+	DARRAY_FREE(u64)(&constants->values);
+	DARRAY_FREE(u64)(&constants->elements);
+}
+
+Constant Constants_at(Constants *constants, CX_AST_Index node) {
+	Constant value = { .type = constants->types.data[node] };
+	if(value.type) value.u = constants->values.data[node];
+	return value;
+}
+
+void Constants_set(Constants *constants, CX_AST_Index node, Constant value) {
+	constants->types.data[node] = value.type;
+	constants->values.data[node] = value.u;
+}
+
+// Largest value of a signed integer type
+i64 Constant_Type_max(Constant_Type type) {
+	return (i64) ((1ull << (type.bits - 1)) - 1);
+}
+
+// All the bits of an unsigned integer type
+u64 Constant_Type_mask(Constant_Type type) {
+	return type.bits == 64 ? UINT64_MAX : (1ull << type.bits) - 1;
+}
+
+bool Constant_is_true(Constant value) {
+	return constant_types[value.type].is_float ? value.f != 0 : value.u != 0;
+}
+
+Constant Constant_truth(bool truth) {
+	return (Constant) { .type = SYMBOL_I32, .i = truth };
+}
+
+// The type C's integer promotions turn `type` into
+Symbol Constant_promoted(Symbol type) {
+	return !constant_types[type].is_float && constant_types[type].bits < 32 ? SYMBOL_I32 : type;
+}
+
+// The type C's usual arithmetic conversions bring the operands of a binary operator to
+Symbol Constant_common_type(Symbol a, Symbol b) {
+	if(a == SYMBOL_F64 || b == SYMBOL_F64) return SYMBOL_F64;
+	if(a == SYMBOL_F32 || b == SYMBOL_F32) return SYMBOL_F32;
+
+	a = Constant_promoted(a);
+	b = Constant_promoted(b);
+	Constant_Type x = constant_types[a], y = constant_types[b];
+	if(x.is_signed == y.is_signed) return x.bits >= y.bits ? a : b;
+
+	Symbol signed_type = x.is_signed ? a : b, unsigned_type = x.is_signed ? b : a;
+	if(constant_types[unsigned_type].bits >= constant_types[signed_type].bits) return unsigned_type;
+	return signed_type; // which holds every value of the narrower unsigned type
+}
+
+// Converts `value` to `type` as C does, returns false where C leaves the result undefined or up
+// to the implementation
+bool Constant_convert(Constant value, Symbol type, Constant *result) {
+	Constant_Type from = constant_types[value.type], to = constant_types[type];
+	result->type = type;
+
+	if(to.is_float) {
+		bool f32 = type == SYMBOL_F32;
+		if(from.is_float) result->f = f32 ? (float) value.f : value.f;
+		else if(from.is_signed) result->f = f32 ? (float) value.i : (double) value.i;
+		else result->f = f32 ? (float) value.u : (double) value.u;
+		return true;
+	}
+
+	if(type == SYMBOL_B8) {
+		result->u = Constant_is_true(value);
+		return true;
+	}
+
+	if(from.is_float) {
+		// the value is truncated, what is left must fit, NaN fails both comparisons
+		double limit = 2.0 * (double) (1ull << (to.bits - 1 - to.is_signed)); // one past the largest value
+		bool fits = to.is_signed ? value.f + limit > -1 && value.f < limit : value.f > -1 && value.f < limit;
+		if(!fits) return false;
+		if(to.is_signed) result->i = (i64) value.f;
+		else result->u = (u64) value.f;
+		return true;
+	}
+
+	if(!to.is_signed) {
+		result->u = value.u & Constant_Type_mask(to); // modulo 2^bits, also for negative values
+		return true;
+	}
+
+	i64 max = Constant_Type_max(to);
+	if(from.is_signed ? value.i < -max - 1 || value.i > max : value.u > (u64) max) return false;
+	result->i = from.is_signed ? value.i : (i64) value.u;
+	return true;
+}
+
+typedef enum {
+	CONSTANT_OK,
+	CONSTANT_NOT_INTEGER,
+	CONSTANT_OVERFLOW,
+	CONSTANT_DIVISION_BY_ZERO,
+	CONSTANT_SHIFT_OUT_OF_RANGE,
+	CONSTANT_SHIFT_OF_NEGATIVE,
+} Constant_Problem;
+
+// Formatted with the operator's spelling and the name of the type it is computed in
+const char *constant_problem_formats[] = {
+	[CONSTANT_NOT_INTEGER] = "the operands of '%s' must be integers",
+	[CONSTANT_OVERFLOW] = "the result of '%s' does not fit in %s",
+	[CONSTANT_DIVISION_BY_ZERO] = "'%s' by zero",
+	[CONSTANT_SHIFT_OUT_OF_RANGE] = "'%s' by a negative count or by the width of %s or more",
+	[CONSTANT_SHIFT_OF_NEGATIVE] = "'%s' of a negative value",
+};
+
+// These return false when the result overflows
+bool i64_add(i64 a, i64 b, i64 *result) {
+	if(b > 0 ? a > INT64_MAX - b : a < INT64_MIN - b) return false;
+	*result = a + b;
+	return true;
+}
+
+bool i64_subtract(i64 a, i64 b, i64 *result) {
+	if(b < 0 ? a > INT64_MAX + b : a < INT64_MIN + b) return false;
+	*result = a - b;
+	return true;
+}
+
+bool i64_multiply(i64 a, i64 b, i64 *result) {
+	if(a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a) : (b > 0 ? a < INT64_MIN / b : a && b < INT64_MAX / a))
+		return false;
+	*result = a * b;
+	return true;
+}
+
+Constant_Problem Constant_unary(Token_Type op, Constant operand, Constant *result) {
+	if(op == TOKEN_NOT) {
+		*result = Constant_truth(!Constant_is_true(operand));
+		return CONSTANT_OK;
+	}
+
+	Constant_Type type = constant_types[Constant_promoted(operand.type)];
+	if(op == TOKEN_TILDE && type.is_float) return CONSTANT_NOT_INTEGER;
+	Constant_convert(operand, Constant_promoted(operand.type), result);
+
+	if(op == TOKEN_MINUS) {
+		if(type.is_float) result->f = -result->f;
+		else if(!type.is_signed) result->u = -result->u & Constant_Type_mask(type);
+		else if(result->i == -Constant_Type_max(type) - 1) return CONSTANT_OVERFLOW;
+		else result->i = -result->i;
+	} else if(op == TOKEN_TILDE) {
+		if(type.is_signed) result->i = ~result->i;
+		else result->u = ~result->u & Constant_Type_mask(type);
+	}
+	return CONSTANT_OK;
+}
+
+Constant_Problem Constant_shift(Token_Type op, Constant a, Constant b, Constant *result) {
+	if(constant_types[a.type].is_float || constant_types[b.type].is_float) return CONSTANT_NOT_INTEGER;
+
+	Constant count;
+	Constant_convert(a, Constant_promoted(a.type), result);
+	Constant_convert(b, Constant_promoted(b.type), &count);
+	Constant_Type type = constant_types[result->type];
+	if((constant_types[count.type].is_signed && count.i < 0) || count.u >= type.bits) return CONSTANT_SHIFT_OUT_OF_RANGE;
+
+	if(op == TOKEN_SHIFT_RIGHT) {
+		if(type.is_signed) result->i >>= count.u;
+		else result->u >>= count.u;
+	} else if(type.is_signed) {
+		if(result->i < 0) return CONSTANT_SHIFT_OF_NEGATIVE;
+		if(result->i > Constant_Type_max(type) >> count.u) return CONSTANT_OVERFLOW;
+		result->i = (i64) ((u64) result->i << count.u);
+	} else {
+		result->u = (result->u << count.u) & Constant_Type_mask(type);
+	}
+	return CONSTANT_OK;
+}
+
+Constant_Problem Constant_binary(Token_Type op, Constant a, Constant b, Constant *result) {
+	switch(op) {
+		case TOKEN_LOGIC_AND:
+			*result = Constant_truth(Constant_is_true(a) && Constant_is_true(b));
+			return CONSTANT_OK;
+		case TOKEN_LOGIC_OR:
+			*result = Constant_truth(Constant_is_true(a) || Constant_is_true(b));
+			return CONSTANT_OK;
+		case TOKEN_SHIFT_LEFT:
+		case TOKEN_SHIFT_RIGHT:
+			return Constant_shift(op, a, b, result);
+		default:
+			break;
+	}
+
+	Symbol common_type = Constant_common_type(a.type, b.type);
+	Constant_Type type = constant_types[common_type];
+	Constant x, y;
+	Constant_convert(a, common_type, &x); // the usual arithmetic conversions always succeed
+	Constant_convert(b, common_type, &y);
+
+	int order = type.is_float ? (x.f > y.f) - (x.f < y.f) : type.is_signed ? (x.i > y.i) - (x.i < y.i) : (x.u > y.u) - (x.u < y.u);
+	bool unordered = type.is_float && (x.f != x.f || y.f != y.f); // a NaN, equal to nothing
+	switch(op) {
+		case TOKEN_EQUALS_EQUALS:
+			*result = Constant_truth(!unordered && order == 0);
+			return CONSTANT_OK;
+		case TOKEN_NOT_EQUALS:
+			*result = Constant_truth(unordered || order != 0);
+			return CONSTANT_OK;
+		case TOKEN_LESS_THAN:
+			*result = Constant_truth(!unordered && order < 0);
+			return CONSTANT_OK;
+		case TOKEN_LESS_EQUALS:
+			*result = Constant_truth(!unordered && order <= 0);
+			return CONSTANT_OK;
+		case TOKEN_GREATER_THAN:
+			*result = Constant_truth(!unordered && order > 0);
+			return CONSTANT_OK;
+		case TOKEN_GREATER_EQUALS:
+			*result = Constant_truth(!unordered && order >= 0);
+			return CONSTANT_OK;
+		default:
+			break;
+	}
+
+	result->type = common_type;
+
+	if(type.is_float) {
+		switch(op) {
+			case TOKEN_PLUS:
+				result->f = x.f + y.f;
+				break;
+			case TOKEN_MINUS:
+				result->f = x.f - y.f;
+				break;
+			case TOKEN_ASTERISK:
+				result->f = x.f * y.f;
+				break;
+			case TOKEN_SLASH:
+				result->f = x.f / y.f; // IEEE 754, by zero is an infinity or NaN
+				break;
+			default:
+				return CONSTANT_NOT_INTEGER;
+		}
+		// rounding the exact double result again gives the float one for all four operators
+		if(common_type == SYMBOL_F32) result->f = (float) result->f;
+		return CONSTANT_OK;
+	}
+
+	if((op == TOKEN_SLASH || op == TOKEN_MOD) && !y.u) return CONSTANT_DIVISION_BY_ZERO;
+
+	if(!type.is_signed) {
+		switch(op) {
+			case TOKEN_PLUS:
+				result->u = x.u + y.u;
+				break;
+			case TOKEN_MINUS:
+				result->u = x.u - y.u;
+				break;
+			case TOKEN_ASTERISK:
+				result->u = x.u * y.u;
+				break;
+			case TOKEN_SLASH:
+				result->u = x.u / y.u;
+				break;
+			case TOKEN_MOD:
+				result->u = x.u % y.u;
+				break;
+			case TOKEN_AMPERSTAND:
+				result->u = x.u & y.u;
+				break;
+			case TOKEN_PIPE:
+				result->u = x.u | y.u;
+				break;
+			case TOKEN_XOR:
+				result->u = x.u ^ y.u;
+				break;
+			default:
+				assert(false && "unreachable");
+		}
+		result->u &= Constant_Type_mask(type);
+		return CONSTANT_OK;
+	}
+
+	i64 max = Constant_Type_max(type);
+	bool fits = true;
+	switch(op) {
+		case TOKEN_PLUS:
+			fits = i64_add(x.i, y.i, &result->i);
+			break;
+		case TOKEN_MINUS:
+			fits = i64_subtract(x.i, y.i, &result->i);
+			break;
+		case TOKEN_ASTERISK:
+			fits = i64_multiply(x.i, y.i, &result->i);
+			break;
+		case TOKEN_SLASH:
+		case TOKEN_MOD:
+			if(x.i == -max - 1 && y.i == -1) return CONSTANT_OVERFLOW; // for % too, as C11 says
+			result->i = op == TOKEN_SLASH ? x.i / y.i : x.i % y.i;
+			break;
+		case TOKEN_AMPERSTAND:
+			result->i = x.i & y.i;
+			break;
+		case TOKEN_PIPE:
+			result->i = x.i | y.i;
+			break;
+		case TOKEN_XOR:
+			result->i = x.i ^ y.i;
+			break;
+		default:
+			assert(false && "unreachable");
+	}
+	if(!fits || result->i < -max - 1 || result->i > max) return CONSTANT_OVERFLOW;
+	return CONSTANT_OK;
+}
+
+// Works out the value of a number literal, returns what is wrong with it or NULL
+const char *Constant_of_number_lit(Token token, Constant *result) {
+	StringView spelling = Token_number_sv(token);
+	char text[128];
+	if(spelling.size >= sizeof(text)) return "number literal too long";
+	memcpy(text, spelling.data, spelling.size);
+	text[spelling.size] = '\0';
+	if(!spelling.size || !char_is(text[0], CHAR_CLASS_DIGIT)) return "invalid number literal";
+
+	char *end;
+	errno = 0;
+	if(strpbrk(text, ".eE")) {
+		result->type = SYMBOL_F64;
+		result->f = strtod(text, &end);
+		if(errno == ERANGE && result->f > 1) return "number literal too large for f64";
+	} else {
+		u64 value = strtoull(text, &end, 10);
+		if(errno == ERANGE) return "number literal too large for u64";
+		result->type = value <= INT32_MAX ? SYMBOL_I32 : value <= INT64_MAX ? SYMBOL_I64 : SYMBOL_U64;
+		result->u = value;
+	}
+	if(*end) return "invalid number literal";
+	return NULL;
+}
+
+// Prints an error about the value of `node`
+void Constant_error(CX_AST *ast, CX_AST_Index node, const char *message) {
+	Location location = Token_location(CX_AST_token(ast, node));
+	loc_error_cited(location, "%s\n", message);
+}
+
+void Constant_problem(CX_AST *ast, CX_AST_Index node, Constant_Problem problem, Symbol type) {
+	char message[256];
+	Token_Type op = CX_AST_token(ast, node).type;
+	snprintf(message, sizeof(message), constant_problem_formats[problem], operator_spellings[op], builtin_symbol_names[type]);
+	Constant_error(ast, node, message);
+}
+
+// The type the problem with a binary operator's result is in
+Symbol Constant_problem_type(Token_Type op, Constant lhs, Constant rhs) {
+	return op == TOKEN_SHIFT_LEFT || op == TOKEN_SHIFT_RIGHT ? Constant_promoted(lhs.type) : Constant_common_type(lhs.type, rhs.type);
+}
+
+// Element `index` of the constant array `array`, indexed by `node`. Reports an error and returns
+// false when there is no such element.
+bool Constant_element(CX_AST *ast, Constants *constants, CX_AST_Index node, CX_AST_Index array, Constant index, Constant *result) {
+	char message[256];
+	Symbol name = CX_AST_token(ast, CX_AST_child(ast, array, 1)).value_symbol;
+	if(constant_types[index.type].is_float) {
+		snprintf(message, sizeof(message), "the index into '" PRIsv "' must be an integer", PRIsv_arg(Symbol_sv(name)));
+		Constant_error(ast, node, message);
+		return false;
+	}
+
+	u64 first = constants->values.data[array], length = constants->elements.data[first];
+	bool is_signed = constant_types[index.type].is_signed;
+	if(is_signed ? index.i < 0 || (u64) index.i >= length : index.u >= length) {
+		if(is_signed) snprintf(message, sizeof(message), "index %lld is out of the bounds of '" PRIsv "', which has %llu elements", (long long) index.i, PRIsv_arg(Symbol_sv(name)), (unsigned long long) length);
+		else snprintf(message, sizeof(message), "index %llu is out of the bounds of '" PRIsv "', which has %llu elements", (unsigned long long) index.u, PRIsv_arg(Symbol_sv(name)), (unsigned long long) length);
+		Constant_error(ast, node, message);
+		return false;
+	}
+
+	result->type = constants->types.data[array];
+	result->u = constants->elements.data[first + 1 + index.u];
+	return true;
+}
+
+// Comptime interpreter
+
+// Runs a function while compiling, once for each element of a constant array. Statements are run
+// from an explicit stack, as CX_AST_walk does, and expressions are evaluated by walking them, so
+// how deeply the function nests is not bounded by the C stack. Values follow the rules of constant
+// expressions and variables hold values of their declared type. Expressions with a constant value
+// are taken as they are, the others are evaluated every time. A bound on the statements run for
+// an array stops endless loops.
+
+#define COMPTIME_MAX_STEPS (1 << 24) // for all of an array's elements
+#define COMPTIME_MAX_LENGTH (1 << 20)
+
+typedef struct {
+	CX_AST_Index node;
+	u32 next_child; // of a compound statement, 1 once an `if` has taken its branch
+	u32 bindings;   // made before a compound statement
+} Comptime_Frame;
+
+FORWARD_DECLARE_DARRAY(Comptime_Frame)
+DECLARE_DARRAY(Comptime_Frame)
+
+// What a variable held before it was declared, its declaration is undone at the end of its block
+typedef struct {
+	Symbol symbol;
+	Constant previous;
+} Comptime_Binding;
+
+FORWARD_DECLARE_DARRAY(Comptime_Binding)
+DECLARE_DARRAY(Comptime_Binding)
+
+typedef struct {
+	CX_AST_Visitor visitor; // evaluates an expression
+	CX_AST *ast;
+	Constants *constants;
+	Constants values; // of the expressions evaluated, by node
+	DARRAY(Constant) variables; // by symbol, of SYMBOL_NULL type for the names which are not variables
+	DARRAY(Comptime_Binding) bindings;
+	DARRAY(Comptime_Frame) frames;
+	DARRAY(CX_AST_Walk_Frame) walk; // of the expressions
+	size_t steps;
+	bool failed;
+	bool skipped; // the node being left was skipped
+} Comptime_Interpreter;
+
+void Comptime_Interpreter_error(Comptime_Interpreter *interpreter, CX_AST_Index node, const char *message) {
+	Constant_error(interpreter->ast, node, message);
+	interpreter->failed = true;
+}
+
+void Comptime_Interpreter_problem(Comptime_Interpreter *interpreter, CX_AST_Index node, Constant_Problem problem, Symbol type) {
+	Constant_problem(interpreter->ast, node, problem, type);
+	interpreter->failed = true;
+}
+
+// Declares the variable or parameter `declaration` with `value`
+void Comptime_Interpreter_declare(Comptime_Interpreter *interpreter, CX_AST_Index declaration, Constant value) {
+	CX_AST *ast = interpreter->ast;
+	CX_AST_Index data_type = CX_AST_child(ast, declaration, 0);
+	Symbol type = CX_AST_token(ast, data_type).value_symbol;
+	Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, declaration, 1)).value_symbol;
+
+	char message[256];
+	if(type >= SYMBOL_BUILTIN_COUNT || !constant_types[type].bits) {
+		snprintf(message, sizeof(message), "'" PRIsv "' values can not be computed at compile time", PRIsv_arg(Symbol_sv(type)));
+		Comptime_Interpreter_error(interpreter, data_type, message);
+		return;
+	}
+
+	Constant converted;
+	if(!Constant_convert(value, type, &converted)) {
+		snprintf(message, sizeof(message), "the value of '" PRIsv "' does not fit in %s", PRIsv_arg(Symbol_sv(symbol)), builtin_symbol_names[type]);
+		Comptime_Interpreter_error(interpreter, declaration, message);
+		return;
+	}
+
+	Comptime_Binding binding = { .symbol = symbol, .previous = interpreter->variables.data[symbol] };
+	DARRAY_PUSH(Comptime_Binding)(&interpreter->bindings, binding);
+	interpreter->variables.data[symbol] = converted;
+}
+
+// Undoes the declarations made since there were `bindings_len`
+void Comptime_Interpreter_unbind(Comptime_Interpreter *interpreter, size_t bindings_len) {
+	while(interpreter->bindings.len > bindings_len) {
+		Comptime_Binding binding = interpreter->bindings.data[--interpreter->bindings.len];
+		interpreter->variables.data[binding.symbol] = binding.previous;
+	}
+}
+
+// Converts `value` to the type of the variable `target` and stores it there and in `*result`
+bool Comptime_Interpreter_assign(Comptime_Interpreter *interpreter, CX_AST_Index target, Constant value, Constant *result) {
+	CX_AST *ast = interpreter->ast;
+	if(CX_AST_kind(ast, target) == CX_AST_NODE_TYPE_INDEX_EXPR) {
+		Comptime_Interpreter_error(interpreter, target, "only variables can be assigned to at compile time");
+		return false;
+	}
+	if(CX_AST_kind(ast, target) != CX_AST_NODE_TYPE_NAME_ID) { // reported by analyse_semantics
+		interpreter->failed = true;
+		return false;
+	}
+
+	Symbol symbol = CX_AST_token(ast, target).value_symbol;
+	Constant *variable = &interpreter->variables.data[symbol];
+	if(!Constant_convert(value, variable->type, result)) {
+		char message[256];
+		snprintf(message, sizeof(message), "the value assigned to '" PRIsv "' does not fit in %s", PRIsv_arg(Symbol_sv(symbol)), builtin_symbol_names[variable->type]);
+		Comptime_Interpreter_error(interpreter, target, message);
+		return false;
+	}
+	*variable = *result;
+	return true;
+}
+
+// Skips the nodes with a constant value, the right operand of && and || when the left one decides
+// the result, and everything after an error
+void Comptime_Interpreter_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	Comptime_Interpreter *interpreter = (Comptime_Interpreter*) visitor;
+	Constant value = Constants_at(interpreter->constants, node);
+
+	bool decided = false;
+	if(CX_AST_kind(ast, parent) == CX_AST_NODE_TYPE_BINARY_EXPR && CX_AST_child(ast, parent, 1) == node) {
+		Token_Type op = CX_AST_token(ast, parent).type;
+		Constant lhs = Constants_at(&interpreter->values, CX_AST_child(ast, parent, 0));
+		decided = (op == TOKEN_LOGIC_AND || op == TOKEN_LOGIC_OR) && Constant_is_true(lhs) == (op == TOKEN_LOGIC_OR);
+	}
+
+	if(interpreter->failed || value.type || decided) {
+		Constants_set(&interpreter->values, node, value);
+		visitor->skip = interpreter->skipped = true;
+	}
+}
+
+void Comptime_Interpreter_leave(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	(void) parent;
+	Comptime_Interpreter *interpreter = (Comptime_Interpreter*) visitor;
+	if(interpreter->skipped) {
+		interpreter->skipped = false;
+		return;
+	}
+	if(interpreter->failed) return;
+
+	Constants *values = &interpreter->values;
+	Token token = CX_AST_token(ast, node);
+	Constant value = { 0 };
+	char message[256];
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_NAME_ID:
+			value = interpreter->variables.data[token.value_symbol];
+			if(!value.type) {
+				snprintf(message, sizeof(message), "the value of '" PRIsv "' is not known at compile time", PRIsv_arg(Symbol_sv(token.value_symbol)));
+				Comptime_Interpreter_error(interpreter, node, message);
+				return;
+			}
+			break;
+		case CX_AST_NODE_TYPE_UNARY_EXPR:
+			{
+				CX_AST_Index operand_node = CX_AST_child(ast, node, 0);
+				Constant operand = Constants_at(values, operand_node);
+				if(token.type == TOKEN_PLUS_PLUS || token.type == TOKEN_MINUS_MINUS) {
+					Constant one = { .type = SYMBOL_I32, .i = 1 };
+					Constant_Problem problem = Constant_binary(token.type == TOKEN_PLUS_PLUS ? TOKEN_PLUS : TOKEN_MINUS, operand, one, &value);
+					if(problem) {
+						Comptime_Interpreter_problem(interpreter, node, problem, Constant_common_type(operand.type, one.type));
+						return;
+					}
+					if(!Comptime_Interpreter_assign(interpreter, operand_node, value, &value)) return;
+				} else {
+					Constant_Problem problem = Constant_unary(token.type, operand, &value);
+					if(problem) {
+						Comptime_Interpreter_problem(interpreter, node, problem, Constant_promoted(operand.type));
+						return;
+					}
+				}
+			}
+			break;
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			{
+				CX_AST_Index lhs_node = CX_AST_child(ast, node, 0);
+				Constant lhs = Constants_at(values, lhs_node), rhs = Constants_at(values, CX_AST_child(ast, node, 1));
+				Token_Type op = compound_assignment_operators[token.type] ? compound_assignment_operators[token.type] : token.type;
+
+				if(token.type == TOKEN_EQUALS) {
+					if(!Comptime_Interpreter_assign(interpreter, lhs_node, rhs, &value)) return;
+					break;
+				}
+				if(op == TOKEN_LOGIC_AND || op == TOKEN_LOGIC_OR) {
+					bool decided = Constant_is_true(lhs) == (op == TOKEN_LOGIC_OR); // the right operand was skipped
+					value = Constant_truth(decided ? op == TOKEN_LOGIC_OR : Constant_is_true(rhs));
+					break;
+				}
+
+				Constant_Problem problem = Constant_binary(op, lhs, rhs, &value);
+				if(problem) {
+					Comptime_Interpreter_problem(interpreter, node, problem, Constant_problem_type(op, lhs, rhs));
+					return;
+				}
+				if(op != token.type && !Comptime_Interpreter_assign(interpreter, lhs_node, value, &value)) return;
+			}
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			{
+				CX_AST_Index array = interpreter->constants->values.data[node];
+				if(!array) {
+					Comptime_Interpreter_error(interpreter, node, "only constant arrays can be indexed at compile time");
+					return;
+				}
+				if(!Constant_element(ast, interpreter->constants, node, array, Constants_at(values, CX_AST_child(ast, node, 1)), &value)) {
+					interpreter->failed = true;
+					return;
+				}
+			}
+			break;
+		default:
+			Comptime_Interpreter_error(interpreter, node, "this can not be evaluated at compile time");
+			return;
+	}
+
+	Constants_set(values, node, value);
+}
+
+void Comptime_Interpreter_init(Comptime_Interpreter *interpreter, CX_AST *ast, Constants *constants) {
+	interpreter->visitor = (CX_AST_Visitor) {
+		.enter = Comptime_Interpreter_enter,
+		.leave = Comptime_Interpreter_leave
+	};
+	interpreter->ast = ast;
+	interpreter->constants = constants;
+	Constants_init(&interpreter->values, ast->kinds.len);
+
+	size_t symbol_count = symbols._from.len;
+	DARRAY_INIT(Constant)(&interpreter->variables, symbol_count);
+	memset(interpreter->variables.data, 0, symbol_count * sizeof(Constant));
+	interpreter->variables.len = symbol_count;
+
+	DARRAY_INIT(Comptime_Binding)(&interpreter->bindings, 16);
+	DARRAY_INIT(Comptime_Frame)(&interpreter->frames, 16);
+	DARRAY_INIT(CX_AST_Walk_Frame)(&interpreter->walk, 64);
+	interpreter->steps = 0;
+	interpreter->failed = interpreter->skipped = false;
+}
+
+void Comptime_Interpreter_free(Comptime_Interpreter *interpreter) {
+	Constants_free(&interpreter->values);
+	DARRAY_FREE(Constant)(&interpreter->variables);
+	DARRAY_FREE(Comptime_Binding)(&interpreter->bindings);
+	DARRAY_FREE(Comptime_Frame)(&interpreter->frames);
+	DARRAY_FREE(CX_AST_Walk_Frame)(&interpreter->walk);
+}
+
+// Returns false after reporting an error
+bool Comptime_Interpreter_evaluate(Comptime_Interpreter *interpreter, CX_AST_Index expr, Constant *value) {
+	CX_AST_walk_with(interpreter->ast, expr, &interpreter->visitor, &interpreter->walk);
+	*value = Constants_at(&interpreter->values, expr);
+	return !interpreter->failed;
+}
+
+void Comptime_Interpreter_push(Comptime_Interpreter *interpreter, CX_AST_Index stmt) {
+	Comptime_Frame frame = { .node = stmt, .next_child = 0, .bindings = interpreter->bindings.len };
+	DARRAY_PUSH(Comptime_Frame)(&interpreter->frames, frame);
+}
+
+// Calls `function`, which has a single parameter, with `argument`. Returns false after reporting
+// an error.
+bool Comptime_Interpreter_call(Comptime_Interpreter *interpreter, CX_AST_Index function, Constant argument, Constant *result) {
+	CX_AST *ast = interpreter->ast;
+	CX_AST_Index name = CX_AST_child(ast, function, 1);
+	Symbol return_type = CX_AST_token(ast, CX_AST_child(ast, function, 0)).value_symbol;
+	bool returned = false;
+	char message[256];
+
+	interpreter->failed = false;
+	Comptime_Interpreter_declare(interpreter, CX_AST_child(ast, function, 2), argument);
+	Comptime_Interpreter_push(interpreter, CX_AST_child(ast, function, 3));
+
+	while(interpreter->frames.len && !interpreter->failed && !returned) {
+		if(++interpreter->steps > COMPTIME_MAX_STEPS) {
+			snprintf(message, sizeof(message), "'" PRIsv "' ran for more than %d statements, it may never return", PRIsv_arg(Symbol_sv(CX_AST_token(ast, name).value_symbol)), COMPTIME_MAX_STEPS);
+			Comptime_Interpreter_error(interpreter, name, message);
+			break;
+		}
+
+		Comptime_Frame *frame = &interpreter->frames.data[interpreter->frames.len - 1];
+		CX_AST_Index node = frame->node;
+		Constant value;
+
+		switch(CX_AST_kind(ast, node)) {
+			case CX_AST_NODE_TYPE_COMPOUND_STMT:
+				if(frame->next_child < CX_AST_children_count(ast, node)) {
+					Comptime_Interpreter_push(interpreter, CX_AST_child(ast, node, frame->next_child++));
+				} else {
+					Comptime_Interpreter_unbind(interpreter, frame->bindings);
+					--interpreter->frames.len;
+				}
+				break;
+			case CX_AST_NODE_TYPE_IF_STMT:
+				if(frame->next_child) {
+					--interpreter->frames.len;
+					break;
+				}
+				frame->next_child = 1;
+				if(!Comptime_Interpreter_evaluate(interpreter, CX_AST_child(ast, node, 0), &value)) break;
+				if(Constant_is_true(value)) Comptime_Interpreter_push(interpreter, CX_AST_child(ast, node, 1));
+				else if(CX_AST_children_count(ast, node) == 3) Comptime_Interpreter_push(interpreter, CX_AST_child(ast, node, 2));
+				break;
+			case CX_AST_NODE_TYPE_WHILE_STMT:
+				if(!Comptime_Interpreter_evaluate(interpreter, CX_AST_child(ast, node, 0), &value)) break;
+				if(Constant_is_true(value)) Comptime_Interpreter_push(interpreter, CX_AST_child(ast, node, 1));
+				else --interpreter->frames.len;
+				break;
+			case CX_AST_NODE_TYPE_RETURN_STMT:
+				if(!Comptime_Interpreter_evaluate(interpreter, CX_AST_child(ast, node, 0), &value)) break;
+				if(!Constant_convert(value, return_type, result)) {
+					snprintf(message, sizeof(message), "the value returned does not fit in %s", builtin_symbol_names[return_type]);
+					Comptime_Interpreter_error(interpreter, node, message);
+					break;
+				}
+				returned = true;
+				break;
+			case CX_AST_NODE_TYPE_EXPR_STMT:
+				Comptime_Interpreter_evaluate(interpreter, CX_AST_child(ast, node, 0), &value);
+				--interpreter->frames.len;
+				break;
+			case CX_AST_NODE_TYPE_VARIABLE_DECL:
+				if(CX_AST_children_count(ast, node) < 3) // an array or a slice, which Comptime_Interpreter_declare rejects
+					Comptime_Interpreter_declare(interpreter, node, (Constant) { 0 });
+				else if(Comptime_Interpreter_evaluate(interpreter, CX_AST_child(ast, node, 2), &value))
+					Comptime_Interpreter_declare(interpreter, node, value);
+				--interpreter->frames.len;
+				break;
+			default: // constants, whose uses have their value already
+				--interpreter->frames.len;
+				break;
+		}
+	}
+
+	if(!returned && !interpreter->failed) {
+		snprintf(message, sizeof(message), "'" PRIsv "' ended without returning a value", PRIsv_arg(Symbol_sv(CX_AST_token(ast, name).value_symbol)));
+		Comptime_Interpreter_error(interpreter, name, message);
+	}
+	Comptime_Interpreter_unbind(interpreter, 0);
+	interpreter->frames.len = 0;
+	return returned;
+}
+
+// Constant evaluation pass
+
+typedef struct {
+	CX_AST *ast;
+	Constants *constants;
+	DARRAY(u32) declarations; // the CONST_DECL or CONST_ARRAY_DECL in scope for each symbol, 0 for none
+	DARRAY(u32) functions;    // the FUNCTION_DECL of each symbol declared so far, 0 for none
+	DARRAY(u32) type_parameters; // symbols, of the generic function being scanned
+	Comptime_Interpreter interpreter; // set up for the first constant array
+	bool interpreter_ready;
+	bool ok;
+} Constant_Evaluator;
+
+void Constant_Evaluator_error(Constant_Evaluator *evaluator, CX_AST_Index node, const char *message) {
+	Constant_error(evaluator->ast, node, message);
+	evaluator->ok = false;
+}
+
+void Constant_Evaluator_problem(Constant_Evaluator *evaluator, CX_AST_Index node, Constant_Problem problem, Symbol type) {
+	Constant_problem(evaluator->ast, node, problem, type);
+	evaluator->ok = false;
+}
+
+// The value of an operand, names are looked up among the constants in scope and take their value
+Constant Constant_Evaluator_operand(Constant_Evaluator *evaluator, CX_AST_Index node) {
+	CX_AST *ast = evaluator->ast;
+	if(CX_AST_kind(ast, node) == CX_AST_NODE_TYPE_NAME_ID) {
+		CX_AST_Index declaration = evaluator->declarations.data[CX_AST_token(ast, node).value_symbol];
+		if(declaration && CX_AST_kind(ast, declaration) == CX_AST_NODE_TYPE_CONST_DECL)
+			Constants_set(evaluator->constants, node, Constants_at(evaluator->constants, declaration));
+	}
+	return Constants_at(evaluator->constants, node);
+}
+
+void Constant_Evaluator_check_assignment(Constant_Evaluator *evaluator, CX_AST_Index target) {
+	CX_AST *ast = evaluator->ast;
+	if(CX_AST_kind(ast, target) == CX_AST_NODE_TYPE_INDEX_EXPR) target = CX_AST_child(ast, target, 0); // an element of it
+	if(CX_AST_kind(ast, target) != CX_AST_NODE_TYPE_NAME_ID) return; // reported by analyse_semantics
+
+	Symbol name = CX_AST_token(ast, target).value_symbol;
+	if(!evaluator->declarations.data[name]) return;
+
+	char message[256];
+	snprintf(message, sizeof(message), "can not assign to the constant '" PRIsv "'", PRIsv_arg(Symbol_sv(name)));
+	Constant_Evaluator_error(evaluator, target, message);
+}
+
+// Variables and parameters can not take the name of a constant in scope, which every use of the
+// name would stand for
+void Constant_Evaluator_check_name(Constant_Evaluator *evaluator, CX_AST_Index declaration) {
+	CX_AST *ast = evaluator->ast;
+	CX_AST_Index name = CX_AST_child(ast, declaration, 1);
+	Symbol symbol = CX_AST_token(ast, name).value_symbol;
+	if(!evaluator->declarations.data[symbol]) return;
+
+	char message[256];
+	snprintf(message, sizeof(message), "'" PRIsv "' is already declared as a constant", PRIsv_arg(Symbol_sv(symbol)));
+	Constant_Evaluator_error(evaluator, name, message);
+}
+
+// Brings the constant or constant array `declaration` in scope, returns false if its name is taken
+bool Constant_Evaluator_bind(Constant_Evaluator *evaluator, CX_AST_Index declaration) {
+	CX_AST *ast = evaluator->ast;
+	CX_AST_Index name = CX_AST_child(ast, declaration, 1);
+	Symbol symbol = CX_AST_token(ast, name).value_symbol;
+
+	if(evaluator->declarations.data[symbol]) {
+		char message[256];
+		snprintf(message, sizeof(message), "the constant '" PRIsv "' is already declared", PRIsv_arg(Symbol_sv(symbol)));
+		Constant_Evaluator_error(evaluator, name, message);
+		return false;
+	}
+	evaluator->declarations.data[symbol] = declaration;
+	return true;
+}
+
+// Constants have a built-in type, returns false after reporting a type parameter, an array or a slice
+bool Constant_Evaluator_check_type(Constant_Evaluator *evaluator, CX_AST_Index node) {
+	CX_AST *ast = evaluator->ast;
+	CX_AST_Index data_type = CX_AST_child(ast, node, 0);
+	Symbol type = CX_AST_token(ast, data_type).value_symbol;
+	Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol;
+
+	char message[256];
+	if(Data_Type_kind(type) != DATA_TYPE_NAMED) {
+		snprintf(message, sizeof(message), "the constant '" PRIsv "' can not be an array or a slice", PRIsv_arg(Symbol_sv(symbol)));
+		Constant_Evaluator_error(evaluator, data_type, message);
+		return false;
+	}
+	for(size_t i = 0; i < evaluator->type_parameters.len; ++i) {
+		if(evaluator->type_parameters.data[i] != type) continue;
+		snprintf(message, sizeof(message), "the constant '" PRIsv "' can not have the type parameter '" PRIsv "' as its type", PRIsv_arg(Symbol_sv(symbol)), PRIsv_arg(Symbol_sv(type)));
+		Constant_Evaluator_error(evaluator, data_type, message);
+		return false;
+	}
+	return true;
+}
+
+void Constant_Evaluator_declare(Constant_Evaluator *evaluator, CX_AST_Index node) {
+	CX_AST *ast = evaluator->ast;
+	Symbol type = CX_AST_token(ast, CX_AST_child(ast, node, 0)).value_symbol;
+	Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol;
+	CX_AST_Index value_node = CX_AST_child(ast, node, 2);
+	Constant value = Constant_Evaluator_operand(evaluator, value_node);
+
+	if(!Constant_Evaluator_bind(evaluator, node) || !Constant_Evaluator_check_type(evaluator, node)) return;
+	if(type >= SYMBOL_BUILTIN_COUNT || !constant_types[type].bits) return; // reported by analyse_semantics
+
+	char message[256];
+	if(!value.type) {
+		snprintf(message, sizeof(message), "the value of '" PRIsv "' is not known at compile time", PRIsv_arg(Symbol_sv(symbol)));
+		Constant_Evaluator_error(evaluator, value_node, message);
+		return;
+	}
+
+	Constant converted;
+	if(!Constant_convert(value, type, &converted)) {
+		snprintf(message, sizeof(message), "the value of '" PRIsv "' does not fit in %s", PRIsv_arg(Symbol_sv(symbol)), builtin_symbol_names[type]);
+		Constant_Evaluator_error(evaluator, value_node, message);
+		return;
+	}
+	Constants_set(evaluator->constants, node, converted);
+}
+
+// Fills a constant array in with the values its function returns for each index
+void Constant_Evaluator_declare_array(Constant_Evaluator *evaluator, CX_AST_Index node) {
+	CX_AST *ast = evaluator->ast;
+	Constants *constants = evaluator->constants;
+	Symbol type = CX_AST_token(ast, CX_AST_child(ast, node, 0)).value_symbol;
+	Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol;
+	CX_AST_Index length_node = CX_AST_child(ast, node, 2), function_name = CX_AST_child(ast, node, 3);
+	Symbol function_symbol = CX_AST_token(ast, function_name).value_symbol;
+	Constant length = Constant_Evaluator_operand(evaluator, length_node);
+
+	if(!Constant_Evaluator_bind(evaluator, node) || !Constant_Evaluator_check_type(evaluator, node)) return;
+	if(type >= SYMBOL_BUILTIN_COUNT || !constant_types[type].bits) return; // reported by analyse_semantics
+
+	char message[256];
+	Constant count;
+	if(!length.type || constant_types[length.type].is_float || !Constant_convert(length, SYMBOL_I64, &count) || count.i < 1 || count.i > COMPTIME_MAX_LENGTH) {
+		snprintf(message, sizeof(message), "the length of '" PRIsv "' must be a constant integer from 1 to %d", PRIsv_arg(Symbol_sv(symbol)), COMPTIME_MAX_LENGTH);
+		Constant_Evaluator_error(evaluator, length_node, message);
+		return;
+	}
+
+	CX_AST_Index function = evaluator->functions.data[function_symbol];
+	if(!function) {
+		snprintf(message, sizeof(message), "'" PRIsv "' is not a function declared before '" PRIsv "'", PRIsv_arg(Symbol_sv(function_symbol)), PRIsv_arg(Symbol_sv(symbol)));
+		Constant_Evaluator_error(evaluator, function_name, message);
+		return;
+	}
+
+	Symbol return_type = CX_AST_token(ast, CX_AST_child(ast, function, 0)).value_symbol;
+	bool one_parameter = CX_AST_children_count(ast, function) == 4 && CX_AST_kind(ast, CX_AST_child(ast, function, 2)) == CX_AST_NODE_TYPE_PARAMETER_DECL;
+	Symbol parameter_type = one_parameter ? CX_AST_token(ast, CX_AST_child(ast, CX_AST_child(ast, function, 2), 0)).value_symbol : SYMBOL_NULL;
+	bool computable = return_type < SYMBOL_BUILTIN_COUNT && constant_types[return_type].bits && parameter_type < SYMBOL_BUILTIN_COUNT && constant_types[parameter_type].bits;
+	if(!computable) {
+		snprintf(message, sizeof(message), "'" PRIsv "' must take a single number, the index, and return a number", PRIsv_arg(Symbol_sv(function_symbol)));
+		Constant_Evaluator_error(evaluator, function_name, message);
+		return;
+	}
+
+	if(!evaluator->ok) return; // the function may use values in error
+
+	Comptime_Interpreter *interpreter = &evaluator->interpreter;
+	if(!evaluator->interpreter_ready) {
+		Comptime_Interpreter_init(interpreter, ast, constants);
+		evaluator->interpreter_ready = true;
+	}
+	interpreter->steps = 0;
+
+	size_t first = constants->elements.len;
+	DARRAY_RESERVE(u64)(&constants->elements, first + 1 + count.i);
+	DARRAY_PUSH(u64)(&constants->elements, count.i);
+
+	for(i64 i = 0; i < count.i; ++i) {
+		Constant index = { .type = SYMBOL_I64, .i = i }, argument, back, value, element;
+		if(!Constant_convert(index, parameter_type, &argument) || !Constant_convert(argument, SYMBOL_I64, &back) || back.i != i) {
+			snprintf(message, sizeof(message), "the index %lld does not fit in the parameter of '" PRIsv "', a %s", (long long) i, PRIsv_arg(Symbol_sv(function_symbol)), builtin_symbol_names[parameter_type]);
+			Constant_Evaluator_error(evaluator, function_name, message);
+			break;
+		}
+
+		if(!Comptime_Interpreter_call(interpreter, function, argument, &value)) {
+			Location location = Token_location(CX_AST_token(ast, function_name));
+			loc_error_cited(location, "while computing element %lld of '" PRIsv "'\n", (long long) i, PRIsv_arg(Symbol_sv(symbol)));
+			evaluator->ok = false;
+			break;
+		}
+
+		if(!Constant_convert(value, type, &element)) {
+			snprintf(message, sizeof(message), "the value '" PRIsv "' returns for index %lld does not fit in %s", PRIsv_arg(Symbol_sv(function_symbol)), (long long) i, builtin_symbol_names[type]);
+			Constant_Evaluator_error(evaluator, function_name, message);
+			break;
+		}
+		DARRAY_PUSH(u64)(&constants->elements, element.u);
+	}
+
+	if(constants->elements.len != first + 1 + count.u) {
+		constants->elements.len = first;
+		return;
+	}
+	constants->computed += count.u;
+	Constants_set(constants, node, (Constant) { .type = type, .u = first });
+}
+
+// Folds `array[index]` when the index is known, and keeps which constant array is indexed
+void Constant_Evaluator_index(Constant_Evaluator *evaluator, CX_AST_Index node) {
+	CX_AST *ast = evaluator->ast;
+	Constants *constants = evaluator->constants;
+	CX_AST_Index array_node = CX_AST_child(ast, node, 0);
+	Constant index = Constant_Evaluator_operand(evaluator, CX_AST_child(ast, node, 1));
+	constants->values.data[node] = 0;
+
+	if(CX_AST_kind(ast, array_node) != CX_AST_NODE_TYPE_NAME_ID) return;
+	Symbol symbol = CX_AST_token(ast, array_node).value_symbol;
+	CX_AST_Index array = evaluator->declarations.data[symbol];
+	if(!array) return;
+
+	if(CX_AST_kind(ast, array) != CX_AST_NODE_TYPE_CONST_ARRAY_DECL) {
+		char message[256];
+		snprintf(message, sizeof(message), "the constant '" PRIsv "' is not an array", PRIsv_arg(Symbol_sv(symbol)));
+		Constant_Evaluator_error(evaluator, array_node, message);
+		return;
+	}
+	if(!constants->types.data[array]) return; // in error
+	constants->values.data[node] = array;
+
+	Constant value;
+	if(!index.type) return;
+	if(!Constant_element(ast, constants, node, array, index, &value)) {
+		evaluator->ok = false;
+		return;
+	}
+	Constants_set(constants, node, value);
+	++constants->folded;
+}
+
+// Constants declared in a block go out of scope at its end
+void Constant_Evaluator_leave_block(Constant_Evaluator *evaluator, CX_AST_Index block) {
+	CX_AST *ast = evaluator->ast;
+	for(size_t i = 0; i < CX_AST_children_count(ast, block); ++i) {
+		CX_AST_Index stmt = CX_AST_child(ast, block, i);
+		CX_AST_Node_Type kind = CX_AST_kind(ast, stmt);
+		if(kind != CX_AST_NODE_TYPE_CONST_DECL && kind != CX_AST_NODE_TYPE_CONST_ARRAY_DECL) continue;
+		Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, stmt, 1)).value_symbol;
+		if(evaluator->declarations.data[symbol] == stmt) evaluator->declarations.data[symbol] = 0;
+	}
+}
+
+// A single scan over the nodes: operands come before their operators, and a name before its
+// expression is never separated from it by the end of a block or another declaration.
+// Returns false when a constant expression is in error.
+bool evaluate_constants(CX_AST *ast, Constants *constants) {
+	Constants_init(constants, ast->kinds.len);
+
+	Constant_Evaluator evaluator = {
+		.ast = ast,
+		.constants = constants,
+		.ok = true
+	};
+	DARRAY_INIT(u32)(&evaluator.declarations, symbols._from.len);
+	memset(evaluator.declarations.data, 0, symbols._from.len * sizeof(u32));
+	evaluator.declarations.len = symbols._from.len;
+	DARRAY_INIT(u32)(&evaluator.functions, symbols._from.len);
+	memset(evaluator.functions.data, 0, symbols._from.len * sizeof(u32));
+	evaluator.functions.len = symbols._from.len;
+	DARRAY_INIT(u32)(&evaluator.type_parameters, 0);
+
+	for(CX_AST_Index node = 1; node < ast->kinds.len; ++node) {
+		switch(CX_AST_kind(ast, node)) {
+			case CX_AST_NODE_TYPE_NUMBER_LIT:
+				{
+					Constant value;
+					const char *problem = Constant_of_number_lit(CX_AST_token(ast, node), &value);
+					if(problem) Constant_Evaluator_error(&evaluator, node, problem);
+					else Constants_set(constants, node, value);
+				}
+				break;
+			case CX_AST_NODE_TYPE_UNARY_EXPR:
+				{
+					Token_Type op = CX_AST_token(ast, node).type;
+					CX_AST_Index operand_node = CX_AST_child(ast, node, 0);
+					if(op == TOKEN_PLUS_PLUS || op == TOKEN_MINUS_MINUS) {
+						Constant_Evaluator_check_assignment(&evaluator, operand_node);
+						break;
+					}
+
+					Constant operand = Constant_Evaluator_operand(&evaluator, operand_node), value;
+					if(!operand.type) break;
+					Constant_Problem problem = Constant_unary(op, operand, &value);
+					if(problem) {
+						Constant_Evaluator_problem(&evaluator, node, problem, Constant_promoted(operand.type));
+					} else {
+						Constants_set(constants, node, value);
+						++constants->folded;
+					}
+				}
+				break;
+			case CX_AST_NODE_TYPE_BINARY_EXPR:
+				{
+					Token_Type op = CX_AST_token(ast, node).type;
+					CX_AST_Index lhs_node = CX_AST_child(ast, node, 0), rhs_node = CX_AST_child(ast, node, 1);
+					if(binary_precedences[op] == PRECEDENCE_ASSIGNMENT) {
+						Constant_Evaluator_check_assignment(&evaluator, lhs_node);
+						Constant_Evaluator_operand(&evaluator, rhs_node);
+						break;
+					}
+
+					Constant lhs = Constant_Evaluator_operand(&evaluator, lhs_node);
+					Constant rhs = Constant_Evaluator_operand(&evaluator, rhs_node);
+					Constant value;
+
+					// as in C, the left operand of && and || may decide the result without the right one
+					bool decided = lhs.type && (op == TOKEN_LOGIC_AND || op == TOKEN_LOGIC_OR) && Constant_is_true(lhs) == (op == TOKEN_LOGIC_OR);
+					if(decided) {
+						value = Constant_truth(op == TOKEN_LOGIC_OR);
+					} else {
+						if(!lhs.type || !rhs.type) break;
+						Constant_Problem problem = Constant_binary(op, lhs, rhs, &value);
+						if(problem) {
+							Constant_Evaluator_problem(&evaluator, node, problem, Constant_problem_type(op, lhs, rhs));
+							break;
+						}
+					}
+					Constants_set(constants, node, value);
+					++constants->folded;
+				}
+				break;
+			case CX_AST_NODE_TYPE_INDEX_EXPR:
+				Constant_Evaluator_index(&evaluator, node);
+				break;
+			case CX_AST_NODE_TYPE_CALL_EXPR:
+				for(size_t i = 1 + CX_AST_type_arguments_count(ast, node); i < CX_AST_children_count(ast, node); ++i)
+					Constant_Evaluator_operand(&evaluator, CX_AST_child(ast, node, i));
+				break;
+			case CX_AST_NODE_TYPE_RETURN_STMT:
+			case CX_AST_NODE_TYPE_EXPR_STMT:
+			case CX_AST_NODE_TYPE_IF_STMT:
+			case CX_AST_NODE_TYPE_WHILE_STMT:
+				Constant_Evaluator_operand(&evaluator, CX_AST_child(ast, node, 0));
+				break;
+			case CX_AST_NODE_TYPE_COMPOUND_STMT:
+				Constant_Evaluator_leave_block(&evaluator, node);
+				break;
+			case CX_AST_NODE_TYPE_FUNCTION_DECL:
+				evaluator.functions.data[CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol] = node;
+				evaluator.type_parameters.len = 0;
+				break;
+			case CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL:
+				DARRAY_PUSH(u32)(&evaluator.type_parameters, CX_AST_token(ast, node).value_symbol);
+				break;
+			case CX_AST_NODE_TYPE_PARAMETER_DECL:
+				Constant_Evaluator_check_name(&evaluator, node);
+				break;
+			case CX_AST_NODE_TYPE_VARIABLE_DECL:
+				Constant_Evaluator_check_name(&evaluator, node);
+				if(CX_AST_children_count(ast, node) == 3) Constant_Evaluator_operand(&evaluator, CX_AST_child(ast, node, 2));
+				break;
+			case CX_AST_NODE_TYPE_CONST_DECL:
+				Constant_Evaluator_declare(&evaluator, node);
+				break;
+			case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+				Constant_Evaluator_declare_array(&evaluator, node);
+				break;
+			default:
+				break;
+		}
+	}
+
+	DARRAY_FREE(u32)(&evaluator.declarations);
+	DARRAY_FREE(u32)(&evaluator.functions);
+	DARRAY_FREE(u32)(&evaluator.type_parameters);
+	if(evaluator.interpreter_ready) Comptime_Interpreter_free(&evaluator.interpreter);
+	return evaluator.ok;
+}
+
+// Generics
+
+// A generic function, `T name<T, ...>(parameters...) body`, is not emitted as it is. Each distinct
+// list of type arguments it is called with, as in `name<i32>(...)`, makes an instantiation: a C
+// function of its own, `name__i32`, in which the type parameters stand for the arguments. They are
+// found from the declarations which are not generic, in order, and from the instantiations these
+// make in turn, which may have type parameters as arguments. Every instantiation is emitted once,
+// before the first declaration which needs it and after the instantiations it needs, so C sees
+// them in dependency order. Those which end up calling themselves are declared ahead.
+// A generic function must be declared before the declarations which instantiate it.
+// Instantiations can make ever larger type arguments, as in `T f<T>(T x) { return f<T[]>(x); }`,
+// so there are only so many, and only so deeply nested.
+
+#define GENERICS_MAX_DEPTH 64
+#define GENERICS_MAX_INSTANTIATIONS (64 * 1024)
+
+typedef struct {
+	CX_AST_Index function; // the generic FUNCTION_DECL
+	u32 arguments;         // of the first of its type arguments, in Generics::arguments
+	Symbol name;           // of the C function
+	CX_AST_Index before;   // the declaration it is emitted before
+	bool declared_ahead;   // called before its definition
+	bool done;             // the instantiations it makes are all found
+} Instantiation;
+
+FORWARD_DECLARE_DARRAY(Instantiation)
+DECLARE_DARRAY(Instantiation)
+
+typedef struct {
+	u32 instantiation;
+	u32 next_call;
+} Generics_Frame;
+
+FORWARD_DECLARE_DARRAY(Generics_Frame)
+DECLARE_DARRAY(Generics_Frame)
+
+typedef struct {
+	DARRAY(Instantiation) instantiations; // in the order they are found
+	DARRAY(u32) order;     // the instantiations in the order they are emitted
+	DARRAY(u32) arguments; // Symbols
+	SymbolMap instances;   // 1 + the instantiation named by a symbol
+	DARRAY(u32) functions; // 1 + the ROOT child a symbol names, when it is a function
+	DARRAY(u32) calls;     // with type arguments, grouped by the ROOT child they are in
+	DARRAY(u32) calls_first; // of each ROOT child's calls, and the end of the last one's
+	DARRAY(Generics_Frame) frames;
+	DARRAY(char) name;
+	bool ok;
+} Generics;
+
+void Generics_error(Generics *generics, CX_AST *ast, CX_AST_Index node, const char *message) {
+	Location location = Token_location(CX_AST_token(ast, node));
+	loc_error_cited(location, "%s\n", message);
+	generics->ok = false;
+}
+
+// The symbol `function__argument__...`, which the C function of an instantiation is named
+Symbol Generics_name(Generics *generics, Symbol function, const u32 *arguments, size_t count) {
+	DARRAY(char) *name = &generics->name;
+	name->len = 0;
+	sb_append_sv(name, Symbol_sv(function));
+	for(size_t i = 0; i < count; ++i) {
+		sb_append_cstr(name, "__");
+		Data_Type_mangle(name, arguments[i]);
+	}
+	return Symbol_intern_copy((StringView) { .data = name->data, .size = name->len });
+}
+
+// `type` in the instantiation `instantiation`, or outside of any when it is UINT32_MAX
+Symbol Generics_substitute(Generics *generics, CX_AST *ast, u32 instantiation, Symbol type) {
+	if(instantiation == UINT32_MAX) return type;
+	Data_Type_Kind kind = Data_Type_kind(type);
+	if(kind != DATA_TYPE_NAMED) return Data_Type_compose(Generics_substitute(generics, ast, instantiation, Data_Type_element(type)), kind);
+	Instantiation *instance = &generics->instantiations.data[instantiation];
+	for(size_t i = 0; i < CX_AST_type_parameters_count(ast, instance->function); ++i)
+		if(CX_AST_token(ast, CX_AST_child(ast, instance->function, 2 + i)).value_symbol == type)
+			return generics->arguments.data[instance->arguments + i];
+	return type;
+}
+
+// The instantiation a call with type arguments makes, from within `instantiation`, which is
+// found for the first time unless it has a name already. Returns false when there would be too
+// many instantiations to go on.
+bool Generics_use(Generics *generics, CX_AST *ast, CX_AST_Index call, u32 instantiation, CX_AST_Index before) {
+	Symbol function_name = CX_AST_token(ast, CX_AST_child(ast, call, 0)).value_symbol;
+	size_t arguments_start = generics->arguments.len, count = CX_AST_type_arguments_count(ast, call);
+	for(size_t i = 0; i < count; ++i) {
+		Symbol argument = CX_AST_token(ast, CX_AST_child(ast, call, 1 + i)).value_symbol;
+		DARRAY_PUSH(u32)(&generics->arguments, Generics_substitute(generics, ast, instantiation, argument));
+	}
+
+	Symbol name = Generics_name(generics, function_name, generics->arguments.data + arguments_start, count);
+	u32 existing = SymbolMap_at(&generics->instances, name);
+	if(existing) {
+		generics->arguments.len = arguments_start;
+		Instantiation *instance = &generics->instantiations.data[existing - 1];
+		if(!instance->done && existing - 1 != instantiation) instance->declared_ahead = true; // C sees a function within itself
+		return true;
+	}
+
+	char message[256];
+	if(generics->frames.len >= GENERICS_MAX_DEPTH || generics->instantiations.len >= GENERICS_MAX_INSTANTIATIONS) {
+		bool deep = generics->frames.len >= GENERICS_MAX_DEPTH;
+		snprintf(message, sizeof(message), "instantiating '" PRIsv "' makes more than %d %sinstantiations, do its type arguments keep growing?",
+			PRIsv_arg(Symbol_sv(function_name)), deep ? GENERICS_MAX_DEPTH : GENERICS_MAX_INSTANTIATIONS, deep ? "nested " : "");
+		Generics_error(generics, ast, call, message);
+		generics->arguments.len = arguments_start;
+		return false;
+	}
+
+	CX_AST_Index function = CX_AST_child(ast, ast->root, generics->functions.data[function_name] - 1);
+	if(function > before) {
+		snprintf(message, sizeof(message), "'" PRIsv "' is instantiated before it is declared", PRIsv_arg(Symbol_sv(function_name)));
+		Generics_error(generics, ast, call, message);
+		generics->arguments.len = arguments_start;
+		return true;
+	}
+
+	Instantiation instance = { .function = function, .arguments = arguments_start, .name = name, .before = before };
+	DARRAY_PUSH(Instantiation)(&generics->instantiations, instance);
+	SymbolMap_put(&generics->instances, name, generics->instantiations.len);
+	Generics_Frame frame = { .instantiation = generics->instantiations.len - 1, .next_call = 0 };
+	DARRAY_PUSH(Generics_Frame)(&generics->frames, frame);
+	return true;
+}
+
+typedef struct {
+	CX_AST_Visitor visitor;
+	DARRAY(u32) *calls;
+} Generics_Collector;
+
+void Generics_Collector_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	(void) parent;
+	if(CX_AST_kind(ast, node) == CX_AST_NODE_TYPE_CALL_EXPR && CX_AST_type_arguments_count(ast, node))
+		DARRAY_PUSH(u32)(((Generics_Collector*) visitor)->calls, node);
+}
+
+// Checks calls against the functions they call. Returns false when the program is in error.
+bool instantiate_generics(CX_AST *ast, Generics *generics) {
+	*generics = (Generics) { .ok = true };
+	SymbolMap_init(&generics->instances);
+	DARRAY_INIT(Instantiation)(&generics->instantiations, 0);
+	DARRAY_INIT(u32)(&generics->order, 0);
+	DARRAY_INIT(u32)(&generics->arguments, 0);
+	DARRAY_INIT(u32)(&generics->calls, 0);
+	DARRAY_INIT(u32)(&generics->calls_first, 0);
+	DARRAY_INIT(Generics_Frame)(&generics->frames, 0);
+	DARRAY_INIT(char)(&generics->name, 64);
+	DARRAY_INIT(u32)(&generics->functions, symbols._from.len);
+	memset(generics->functions.data, 0, symbols._from.len * sizeof(u32));
+	generics->functions.len = symbols._from.len;
+
+	char message[256];
+	size_t declarations = CX_AST_children_count(ast, ast->root);
+	for(size_t i = 0; i < declarations; ++i) {
+		CX_AST_Index declaration = CX_AST_child(ast, ast->root, i);
+		if(CX_AST_kind(ast, declaration) != CX_AST_NODE_TYPE_FUNCTION_DECL) continue;
+
+		CX_AST_Index name = CX_AST_child(ast, declaration, 1);
+		Symbol symbol = CX_AST_token(ast, name).value_symbol;
+		u32 previous = generics->functions.data[symbol];
+		bool generic = CX_AST_type_parameters_count(ast, declaration);
+		if(previous && (generic || CX_AST_type_parameters_count(ast, CX_AST_child(ast, ast->root, previous - 1)))) {
+			snprintf(message, sizeof(message), "the generic function '" PRIsv "' is declared more than once", PRIsv_arg(Symbol_sv(symbol)));
+			Generics_error(generics, ast, name, message);
+		}
+		generics->functions.data[symbol] = i + 1;
+	}
+
+	size_t generic_calls = 0;
+	for(CX_AST_Index node = 1; node < ast->kinds.len; ++node) {
+		if(CX_AST_kind(ast, node) != CX_AST_NODE_TYPE_CALL_EXPR) continue;
+		if(CX_AST_kind(ast, CX_AST_child(ast, node, 0)) != CX_AST_NODE_TYPE_NAME_ID) continue; // a method, see resolve_arrays
+
+		Symbol symbol = CX_AST_token(ast, CX_AST_child(ast, node, 0)).value_symbol;
+		u32 function = generics->functions.data[symbol];
+		size_t parameters = function ? CX_AST_type_parameters_count(ast, CX_AST_child(ast, ast->root, function - 1)) : 0;
+		size_t arguments = CX_AST_type_arguments_count(ast, node);
+		if(parameters == arguments) {
+			if(!parameters) continue;
+			// caught here, since the C compiler would reject the instantiation instead
+			size_t value_parameters = CX_AST_parameters_count(ast, CX_AST_child(ast, ast->root, function - 1));
+			size_t value_arguments = CX_AST_arguments_count(ast, node);
+			if(value_parameters == value_arguments) {
+				++generic_calls;
+				continue;
+			}
+			snprintf(message, sizeof(message), "'" PRIsv "' takes %zu arguments, not %zu", PRIsv_arg(Symbol_sv(symbol)), value_parameters, value_arguments);
+		} else if(!parameters) {
+			snprintf(message, sizeof(message), "'" PRIsv "' is not a generic function", PRIsv_arg(Symbol_sv(symbol)));
+		} else {
+			snprintf(message, sizeof(message), "'" PRIsv "' takes %zu type arguments, not %zu", PRIsv_arg(Symbol_sv(symbol)), parameters, arguments);
+		}
+		Generics_error(generics, ast, node, message);
+	}
+	if(!generics->ok || !generic_calls) return generics->ok;
+
+	Generics_Collector collector = {
+		.visitor = { .enter = Generics_Collector_enter },
+		.calls = &generics->calls
+	};
+	DARRAY(CX_AST_Walk_Frame) stack;
+	DARRAY_INIT(CX_AST_Walk_Frame)(&stack, 64);
+	for(size_t i = 0; i < declarations; ++i) {
+		DARRAY_PUSH(u32)(&generics->calls_first, generics->calls.len);
+		CX_AST_walk_with(ast, CX_AST_child(ast, ast->root, i), &collector.visitor, &stack);
+	}
+	DARRAY_PUSH(u32)(&generics->calls_first, generics->calls.len);
+	DARRAY_FREE(CX_AST_Walk_Frame)(&stack);
+
+	// depth first from each declaration, an instantiation is in order once those it makes are
+	for(size_t i = 0; i < declarations; ++i) {
+		CX_AST_Index declaration = CX_AST_child(ast, ast->root, i);
+		if(CX_AST_kind(ast, declaration) == CX_AST_NODE_TYPE_FUNCTION_DECL && CX_AST_type_parameters_count(ast, declaration)) continue;
+
+		for(size_t call = generics->calls_first.data[i]; call < generics->calls_first.data[i + 1]; ++call) {
+			if(!Generics_use(generics, ast, generics->calls.data[call], UINT32_MAX, declaration)) return false;
+
+			while(generics->frames.len) {
+				Generics_Frame *frame = &generics->frames.data[generics->frames.len - 1];
+				Instantiation *instance = &generics->instantiations.data[frame->instantiation];
+				u32 function = generics->functions.data[CX_AST_token(ast, CX_AST_child(ast, instance->function, 1)).value_symbol] - 1;
+
+				if(generics->calls_first.data[function] + frame->next_call < generics->calls_first.data[function + 1]) {
+					CX_AST_Index next = generics->calls.data[generics->calls_first.data[function] + frame->next_call++];
+					if(!Generics_use(generics, ast, next, frame->instantiation, declaration)) return false;
+				} else {
+					instance->done = true;
+					DARRAY_PUSH(u32)(&generics->order, frame->instantiation);
+					--generics->frames.len;
+				}
+			}
+		}
+	}
+
+	return generics->ok;
+}
+
+void Generics_free(Generics *generics) {
+	DARRAY_FREE(Instantiation)(&generics->instantiations);
+	DARRAY_FREE(u32)(&generics->order);
+	DARRAY_FREE(u32)(&generics->arguments);
+	SymbolMap_free(&generics->instances);
+	DARRAY_FREE(u32)(&generics->functions);
+	DARRAY_FREE(u32)(&generics->calls);
+	DARRAY_FREE(u32)(&generics->calls_first);
+	DARRAY_FREE(Generics_Frame)(&generics->frames);
+	DARRAY_FREE(char)(&generics->name);
+}
+
+// Arrays and slices
+
+// `T[]` is lowered to a struct of its own, of the data, length and capacity, and to static inline
+// functions over it which grow it geometrically. So is DARRAY(T) in cx itself: the elements are
+// never behind a void pointer and their size is known where they are copied. `T[..]` is a struct
+// of the data and length of part of an array. Their data pointers are not restrict qualified, a
+// slice points into its array's elements. pop and slice abort when they are out of bounds, as
+// reserve does when it runs out of memory.
+//
+// Arrays are moved, never copied: one is made from what a call returns, or returned by the
+// function whose variable it is. A copy of a variable or an element would share its elements,
+// and point at freed memory once either of them grows.
+//
+// Variables and parameters of these types have a member and methods:
+//   array.len, slice.len       the number of elements, a u64
+//   array[i], slice[i]         an element
+//   array.push(value)          appends an element
+//   array.pop()                removes the last element and returns it
+//   array.reserve(count)       makes room for `count` elements in all
+//   array.free()               frees the elements, the array is then empty
+//   array.slice(from, to)      the elements from `from` to before `to`, as a slice
+//   slice.slice(from, to)
+// resolve_arrays finds the variable in scope each of these is used on, and the array and slice
+// types the unit uses, in the instantiations of generic functions too. They are emitted first.
+
+typedef enum {
+	ARRAY_METHOD_NONE,
+	ARRAY_METHOD_PUSH,
+	ARRAY_METHOD_POP,
+	ARRAY_METHOD_RESERVE,
+	ARRAY_METHOD_FREE,
+	ARRAY_METHOD_SLICE,
+	ARRAY_METHOD_COUNT,
+} Array_Method;
+
+typedef struct {
+	const char *name;
+	u8 arguments;
+	bool on_slices; // and not only on arrays
+	bool by_address; // changes the array, which it takes a pointer to
+} Array_Method_Info;
+
+const Array_Method_Info array_methods[ARRAY_METHOD_COUNT] = {
+	[ARRAY_METHOD_PUSH] = { "push", 1, false, true },
+	[ARRAY_METHOD_POP] = { "pop", 0, false, true },
+	[ARRAY_METHOD_RESERVE] = { "reserve", 1, false, true },
+	[ARRAY_METHOD_FREE] = { "free", 0, false, true },
+	[ARRAY_METHOD_SLICE] = { "slice", 2, true, false },
+};
+
+Array_Method Array_method(Symbol name) {
+	for(Array_Method method = ARRAY_METHOD_NONE + 1; method < ARRAY_METHOD_COUNT; ++method)
+		if(sveq(Symbol_sv(name), sv_from_cstr(array_methods[method].name))) return method;
+	return ARRAY_METHOD_NONE;
+}
+
+typedef struct {
+	Symbol symbol;
+	Symbol previous;
+} Arrays_Binding;
+
+FORWARD_DECLARE_DARRAY(Arrays_Binding)
+DECLARE_DARRAY(Arrays_Binding)
+
+typedef struct {
+	CX_AST_Visitor visitor;
+	SymbolMap variables;     // the data type of each variable in scope
+	DARRAY(Arrays_Binding) bindings; // undone at the end of their scope
+	DARRAY(u32) scopes;      // bindings.len when each open scope started
+	// The data type of the array or slice a MEMBER_EXPR, a method's CALL_EXPR or an INDEX_EXPR is
+	// on, by node, 0 for the other nodes. Empty when the unit has no arrays or slices.
+	DARRAY(u32) objects;
+	DARRAY(u32) types;       // the arrays and slices used, each after those it is made of
+	SymbolMap translations;  // the C name of each of `types`
+	Generics *generics;      // for the functions calls return arrays and slices from
+	DARRAY(char) name;
+	bool ok;
+} Arrays;
+
+void Arrays_error(Arrays *arrays, CX_AST *ast, CX_AST_Index node, const char *message) {
+	Location location = Token_location(CX_AST_token(ast, node));
+	loc_error_cited(location, "%s\n", message);
+	arrays->ok = false;
+}
+
+// Puts `type`, and the types it is made of, among the types to emit
+void Arrays_use(Arrays *arrays, Symbol type) {
+	Data_Type_Kind kind = Data_Type_kind(type);
+	if(kind == DATA_TYPE_NAMED || SymbolMap_at(&arrays->translations, type)) return;
+
+	Symbol element = Data_Type_element(type);
+	Arrays_use(arrays, element);
+	if(kind == DATA_TYPE_ARRAY) Arrays_use(arrays, Data_Type_compose(element, DATA_TYPE_SLICE)); // which .slice() returns
+
+	arrays->name.len = 0;
+	sb_append_cstr(&arrays->name, "cx_");
+	Data_Type_mangle(&arrays->name, type);
+	SymbolMap_put(&arrays->translations, type, Symbol_intern_copy((StringView) { .data = arrays->name.data, .size = arrays->name.len }));
+	DARRAY_PUSH(u32)(&arrays->types, type);
+}
+
+// The array or slice the variable `object` is, reports it and returns 0 when it is neither
+Symbol Arrays_object(Arrays *arrays, CX_AST *ast, CX_AST_Index object) {
+	Symbol name = CX_AST_token(ast, object).value_symbol;
+	Symbol type = SymbolMap_at(&arrays->variables, name);
+	if(type && Data_Type_kind(type) != DATA_TYPE_NAMED) return type;
+
+	char message[256];
+	snprintf(message, sizeof(message), "'" PRIsv "' is not an array or a slice", PRIsv_arg(Symbol_sv(name)));
+	Arrays_error(arrays, ast, object, message);
+	return SYMBOL_NULL;
+}
+
+// `type`, returned by the call `call` to `function`, with the call's type arguments
+Symbol Arrays_returned(CX_AST *ast, CX_AST_Index function, CX_AST_Index call, Symbol type) {
+	Data_Type_Kind kind = Data_Type_kind(type);
+	if(kind != DATA_TYPE_NAMED) return Data_Type_compose(Arrays_returned(ast, function, call, Data_Type_element(type)), kind);
+	for(size_t i = 0; i < CX_AST_type_parameters_count(ast, function); ++i)
+		if(CX_AST_token(ast, CX_AST_child(ast, function, 2 + i)).value_symbol == type)
+			return CX_AST_token(ast, CX_AST_child(ast, call, 1 + i)).value_symbol;
+	return type;
+}
+
+// The data type of a variable, an element, or what a call returns, SYMBOL_NULL for other
+// expressions. Within a generic function it may have its type parameters in it.
+Symbol Arrays_type(Arrays *arrays, CX_AST *ast, CX_AST_Index node) {
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_NAME_ID:
+			return SymbolMap_at(&arrays->variables, CX_AST_token(ast, node).value_symbol);
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			return arrays->objects.data[node] ? Data_Type_element(arrays->objects.data[node]) : SYMBOL_NULL;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				CX_AST_Index callee = CX_AST_child(ast, node, 0);
+				Symbol object = arrays->objects.data[node];
+				if(CX_AST_kind(ast, callee) == CX_AST_NODE_TYPE_MEMBER_EXPR) {
+					if(!object) return SYMBOL_NULL;
+					Array_Method method = Array_method(CX_AST_token(ast, callee).value_symbol);
+					if(method == ARRAY_METHOD_POP) return Data_Type_element(object);
+					if(method == ARRAY_METHOD_SLICE) return Data_Type_compose(Data_Type_element(object), DATA_TYPE_SLICE);
+					return SYMBOL_NULL;
+				}
+
+				Symbol name = CX_AST_token(ast, callee).value_symbol;
+				DARRAY(u32) *functions = &arrays->generics->functions;
+				if(name >= functions->len || !functions->data[name]) return SYMBOL_NULL;
+				CX_AST_Index function = CX_AST_child(ast, ast->root, functions->data[name] - 1);
+				return Arrays_returned(ast, function, node, CX_AST_token(ast, CX_AST_child(ast, function, 0)).value_symbol);
+			}
+		default:
+			return SYMBOL_NULL;
+	}
+}
+
+// Reports `value` when it is an array variable or element, which would be copied where it is used
+void Arrays_check_copy(Arrays *arrays, CX_AST *ast, CX_AST_Index value) {
+	CX_AST_Node_Type kind = CX_AST_kind(ast, value);
+	if(kind != CX_AST_NODE_TYPE_NAME_ID && kind != CX_AST_NODE_TYPE_INDEX_EXPR) return;
+	Symbol type = Arrays_type(arrays, ast, value);
+	if(!type || Data_Type_kind(type) != DATA_TYPE_ARRAY) return;
+
+	char message[256];
+	snprintf(message, sizeof(message), "'" PRIsv "' values are not copied, the copy would share their elements", PRIsv_arg(Symbol_sv(type)));
+	Arrays_error(arrays, ast, value, message);
+}
+
+void Arrays_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	(void) parent;
+	Arrays *arrays = (Arrays*) visitor;
+	CX_AST_Node_Type kind = CX_AST_kind(ast, node);
+	if(kind == CX_AST_NODE_TYPE_FUNCTION_DECL || kind == CX_AST_NODE_TYPE_COMPOUND_STMT)
+		DARRAY_PUSH(u32)(&arrays->scopes, arrays->bindings.len);
+}
+
+void Arrays_leave(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	Arrays *arrays = (Arrays*) visitor;
+	char message[256];
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			{
+				if(CX_AST_children_count(ast, node) > 2) Arrays_check_copy(arrays, ast, CX_AST_child(ast, node, 2)); // the value
+				Symbol name = CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol;
+				Arrays_Binding binding = { .symbol = name, .previous = SymbolMap_at(&arrays->variables, name) };
+				DARRAY_PUSH(Arrays_Binding)(&arrays->bindings, binding);
+				SymbolMap_put(&arrays->variables, name, CX_AST_token(ast, CX_AST_child(ast, node, 0)).value_symbol);
+			}
+			break;
+		case CX_AST_NODE_TYPE_FUNCTION_DECL:
+		case CX_AST_NODE_TYPE_COMPOUND_STMT:
+			{
+				size_t bindings_len = arrays->scopes.data[--arrays->scopes.len];
+				while(arrays->bindings.len > bindings_len) {
+					Arrays_Binding binding = arrays->bindings.data[--arrays->bindings.len];
+					SymbolMap_put(&arrays->variables, binding.symbol, binding.previous);
+				}
+			}
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			{
+				// constant arrays and string literals are indexed too, they have no type here
+				CX_AST_Index object = CX_AST_child(ast, node, 0);
+				Symbol type = Arrays_type(arrays, ast, object);
+				CX_AST_Index callee = CX_AST_kind(ast, object) == CX_AST_NODE_TYPE_CALL_EXPR ? CX_AST_child(ast, object, 0) : 0;
+				if(type && Data_Type_kind(type) != DATA_TYPE_NAMED) {
+					arrays->objects.data[node] = type;
+				} else if(CX_AST_kind(ast, object) == CX_AST_NODE_TYPE_MEMBER_EXPR || (callee && CX_AST_kind(ast, callee) == CX_AST_NODE_TYPE_MEMBER_EXPR)) {
+					Symbol member = CX_AST_token(ast, callee ? callee : object).value_symbol;
+					snprintf(message, sizeof(message), "the result of '." PRIsv "' can not be indexed", PRIsv_arg(Symbol_sv(member)));
+					Arrays_error(arrays, ast, node, message);
+				} else if(type) {
+					snprintf(message, sizeof(message), "'" PRIsv "' values can not be indexed", PRIsv_arg(Symbol_sv(type)));
+					Arrays_error(arrays, ast, node, message);
+				}
+			}
+			break;
+		case CX_AST_NODE_TYPE_MEMBER_EXPR:
+			{
+				if(CX_AST_kind(ast, parent) == CX_AST_NODE_TYPE_CALL_EXPR && CX_AST_child(ast, parent, 0) == node) break; // a method
+				Symbol type = Arrays_object(arrays, ast, CX_AST_child(ast, node, 0));
+				if(!type) break;
+				Symbol member = CX_AST_token(ast, node).value_symbol;
+				if(!sveq(Symbol_sv(member), sv_from_cstr("len"))) {
+					snprintf(message, sizeof(message), "arrays and slices have no member '" PRIsv "'", PRIsv_arg(Symbol_sv(member)));
+					Arrays_error(arrays, ast, node, message);
+					break;
+				}
+				arrays->objects.data[node] = type;
+			}
+			break;
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			if(CX_AST_token(ast, node).type == TOKEN_EQUALS) Arrays_check_copy(arrays, ast, CX_AST_child(ast, node, 1));
+			break;
+		case CX_AST_NODE_TYPE_RETURN_STMT:
+			{
+				// a variable is moved out of the function, an element would still be in its array
+				CX_AST_Index value = CX_AST_child(ast, node, 0);
+				if(CX_AST_kind(ast, value) == CX_AST_NODE_TYPE_INDEX_EXPR) Arrays_check_copy(arrays, ast, value);
+			}
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				for(size_t i = 1 + CX_AST_type_arguments_count(ast, node); i < CX_AST_children_count(ast, node); ++i)
+					Arrays_check_copy(arrays, ast, CX_AST_child(ast, node, i));
+
+				CX_AST_Index function = CX_AST_child(ast, node, 0);
+				if(CX_AST_kind(ast, function) != CX_AST_NODE_TYPE_MEMBER_EXPR) break;
+				Symbol type = Arrays_object(arrays, ast, CX_AST_child(ast, function, 0));
+				if(!type) break;
+
+				Symbol name = CX_AST_token(ast, function).value_symbol;
+				Array_Method method = Array_method(name);
+				bool slice = Data_Type_kind(type) == DATA_TYPE_SLICE;
+				size_t arguments = CX_AST_children_count(ast, node) - 1;
+				if(!method || (slice && !array_methods[method].on_slices)) {
+					snprintf(message, sizeof(message), "%s have no method '" PRIsv "'", slice ? "slices" : "arrays", PRIsv_arg(Symbol_sv(name)));
+					Arrays_error(arrays, ast, function, message);
+				} else if(arguments != array_methods[method].arguments) {
+					snprintf(message, sizeof(message), "'%s' takes %u arguments, not %zu", array_methods[method].name, array_methods[method].arguments, arguments);
+					Arrays_error(arrays, ast, node, message);
+				} else {
+					arrays->objects.data[node] = arrays->objects.data[function] = type;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+// Returns false when a member or a method is used on what is not an array or a slice
+bool resolve_arrays(CX_AST *ast, Generics *generics, Arrays *arrays) {
+	*arrays = (Arrays) {
+		.visitor = { .enter = Arrays_enter, .leave = Arrays_leave },
+		.generics = generics,
+		.ok = true
+	};
+	SymbolMap_init(&arrays->translations);
+	DARRAY_INIT(u32)(&arrays->types, 0);
+
+	bool used = false;
+	for(CX_AST_Index node = 1; node < ast->kinds.len && !used; ++node) {
+		CX_AST_Node_Type kind = CX_AST_kind(ast, node);
+		used = kind == CX_AST_NODE_TYPE_MEMBER_EXPR || (kind == CX_AST_NODE_TYPE_TYPE_ID && Data_Type_kind(CX_AST_token(ast, node).value_symbol) != DATA_TYPE_NAMED);
+	}
+	if(!used) return true;
+
+	SymbolMap_init(&arrays->variables);
+	DARRAY_INIT(Arrays_Binding)(&arrays->bindings, 16);
+	DARRAY_INIT(u32)(&arrays->scopes, 16);
+	DARRAY_INIT(char)(&arrays->name, 64);
+	DARRAY_INIT(u32)(&arrays->objects, ast->kinds.len);
+	memset(arrays->objects.data, 0, ast->kinds.len * sizeof(u32));
+	arrays->objects.len = ast->kinds.len;
+
+	CX_AST_walk(ast, ast->root, &arrays->visitor);
+
+	// a declaration's nodes are those after the declaration before it, the types of a generic
+	// function are used with the arguments of each of its instantiations
+	CX_AST_Index first = 1;
+	for(size_t i = 0; i < CX_AST_children_count(ast, ast->root); ++i) {
+		CX_AST_Index declaration = CX_AST_child(ast, ast->root, i);
+		bool generic = CX_AST_kind(ast, declaration) == CX_AST_NODE_TYPE_FUNCTION_DECL && CX_AST_type_parameters_count(ast, declaration);
+		for(size_t instantiation = 0; instantiation < (generic ? generics->instantiations.len : 1); ++instantiation) {
+			if(generic && generics->instantiations.data[instantiation].function != declaration) continue;
+			for(CX_AST_Index node = first; node < declaration; ++node) {
+				if(CX_AST_kind(ast, node) != CX_AST_NODE_TYPE_TYPE_ID) continue;
+				Symbol type = CX_AST_token(ast, node).value_symbol;
+				Arrays_use(arrays, generic ? Generics_substitute(generics, ast, instantiation, type) : type);
+			}
+		}
+		first = declaration + 1;
+	}
+
+	return arrays->ok;
+}
+
+void Arrays_free(Arrays *arrays) {
+	SymbolMap_free(&arrays->variables);
+	DARRAY_FREE(Arrays_Binding)(&arrays->bindings);
+	DARRAY_FREE(u32)(&arrays->scopes);
+	DARRAY_FREE(u32)(&arrays->objects);
+	DARRAY_FREE(u32)(&arrays->types);
+	SymbolMap_free(&arrays->translations);
+	DARRAY_FREE(char)(&arrays->name);
+}
+
+// Code generation
+
+// The generated code is built up in `out` and handed to the sink in chunks of about this size,
+// so emitting is a matter of copying bytes rather than of formatting them
+#define CODE_GENERATOR_CHUNK_SIZE (1024 * 1024)
+
+// Nesting beyond this is not indented any further, which keeps the output of machine-generated,
+// deeply nested code linear in its size
+#define CODE_GENERATOR_MAX_INDENT 64
+
+#define CODE_GENERATOR_ELEMENTS_PER_LINE 8 // of constant arrays
+
+typedef struct {
+	CX_AST_Visitor visitor;
+	SymbolMap *data_type_translations;
+	Constants *constants; // emitted instead of the expressions they are the value of, may be NULL
+	Generics *generics; // emitted before the declarations which need them, may be NULL
+	Arrays *arrays; // emitted before all declarations, may be NULL
+	size_t next_instantiation; // in Generics::order
+	u32 instantiation; // being emitted, UINT32_MAX for none
+	SymbolMap type_arguments; // of the instantiation being emitted, by type parameter
+	DARRAY(char) out;
+	FILE *sink;
+	DARRAY(char) *copy; // everything written to the sink is appended to it too, may be NULL
+	size_t bytes_emitted;
+	size_t declarations; // emitted at the top level so far
+	int indent_len;
+} CodeGenerator;
+
+// `type` with the type arguments of the instantiation being emitted
+Symbol CodeGenerator_substitute(CodeGenerator *code_gen, Symbol type) {
+	if(code_gen->instantiation == UINT32_MAX) return type;
+	Data_Type_Kind kind = Data_Type_kind(type);
+	if(kind != DATA_TYPE_NAMED) return Data_Type_compose(CodeGenerator_substitute(code_gen, Data_Type_element(type)), kind);
+	Symbol argument = SymbolMap_at(&code_gen->type_arguments, type);
+	return argument ? argument : type;
+}
+
+StringView CodeGenerator_type_name(CodeGenerator *code_gen, Symbol type) {
+	type = CodeGenerator_substitute(code_gen, type);
+	Symbol translation = SymbolMap_at(code_gen->data_type_translations, type);
+	if(!translation && code_gen->arrays) translation = SymbolMap_at(&code_gen->arrays->translations, type);
+	return Symbol_sv(translation ? translation : type);
+}
+
+StringView CodeGenerator_data_type(CodeGenerator *code_gen, Token data_type) {
+	return CodeGenerator_type_name(code_gen, data_type.value_symbol);
+}
+
+// The array or slice a member, a method call or an element is of, SYMBOL_NULL for other nodes
+Symbol CodeGenerator_object(CodeGenerator *code_gen, CX_AST_Index node) {
+	Arrays *arrays = code_gen->arrays;
+	return arrays && node < arrays->objects.len ? arrays->objects.data[node] : SYMBOL_NULL;
+}
+
+// The C of array and slice types: $T is the type's name, $E its elements' and $S the slice of an
+// array's elements. Methods are $T__method, `__` keeps them apart from the types' names.
+const char *code_generator_array_template =
+	"typedef struct {\n"
+	"\t$E *data;\n"
+	"\tsize_t len, cap;\n"
+	"} $T;\n"
+	"\n"
+	"static inline void $T__reserve($T *array, size_t cap)\n"
+	"{\n"
+	"\tif(cap <= array->cap) return;\n"
+	"\tsize_t grown = array->cap ? 2 * array->cap : 8;\n"
+	"\tif(grown < cap) grown = cap;\n"
+	"\t$E *data = realloc(array->data, grown * sizeof($E));\n"
+	"\tif(!data) abort();\n"
+	"\tarray->data = data;\n"
+	"\tarray->cap = grown;\n"
+	"}\n"
+	"\n"
+	"static inline void $T__push($T *array, $E value)\n"
+	"{\n"
+	"\tif(array->len == array->cap) $T__reserve(array, array->len + 1);\n"
+	"\tarray->data[array->len++] = value;\n"
+	"}\n"
+	"\n"
+	"static inline $E $T__pop($T *array)\n"
+	"{\n"
+	"\tif(!array->len) abort();\n"
+	"\treturn array->data[--array->len];\n"
+	"}\n"
+	"\n"
+	"static inline void $T__free($T *array)\n"
+	"{\n"
+	"\tfree(array->data);\n"
+	"\tarray->data = NULL;\n"
+	"\tarray->len = array->cap = 0;\n"
+	"}\n"
+	"\n"
+	"static inline $S $T__slice($T array, size_t from, size_t to)\n"
+	"{\n"
+	"\tif(from > to || to > array.len) abort();\n"
+	"\t$S slice = { array.data + from, to - from };\n"
+	"\treturn slice;\n"
+	"}\n";
+
+const char *code_generator_slice_template =
+	"typedef struct {\n"
+	"\t$E *data;\n"
+	"\tsize_t len;\n"
+	"} $T;\n"
+	"\n"
+	"static inline $T $T__slice($T slice, size_t from, size_t to)\n"
+	"{\n"
+	"\tif(from > to || to > slice.len) abort();\n"
+	"\t$T part = { slice.data + from, to - from };\n"
+	"\treturn part;\n"
+	"}\n";
+
+// The array and slice types the unit uses, before anything which may use them
+void CodeGenerator_array_types(CodeGenerator *code_gen) {
+	DARRAY(char) *out = &code_gen->out;
+	sb_append_cstr(out, "#include <stdlib.h>\n");
+
+	for(size_t i = 0; i < code_gen->arrays->types.len; ++i) {
+		Symbol type = code_gen->arrays->types.data[i], element = Data_Type_element(type);
+		bool array = Data_Type_kind(type) == DATA_TYPE_ARRAY;
+		StringView names[] = {
+			CodeGenerator_type_name(code_gen, type),
+			CodeGenerator_type_name(code_gen, element),
+			array ? CodeGenerator_type_name(code_gen, Data_Type_compose(element, DATA_TYPE_SLICE)) : (StringView) { 0 },
+		};
+
+		sb_append_char(out, '\n');
+		for(const char *c = array ? code_generator_array_template : code_generator_slice_template; *c; ++c) {
+			if(*c != '$') sb_append_char(out, *c);
+			else sb_append_sv(out, names[*++c == 'T' ? 0 : *c == 'E' ? 1 : 2]);
+		}
+	}
+	++code_gen->declarations;
+}
+
+// The C function a call with type arguments calls
+Symbol CodeGenerator_instance_name(CodeGenerator *code_gen, CX_AST *ast, CX_AST_Index call) {
+	Generics *generics = code_gen->generics;
+	size_t arguments_start = generics->arguments.len, count = CX_AST_type_arguments_count(ast, call);
+	for(size_t i = 0; i < count; ++i) {
+		Symbol argument = CX_AST_token(ast, CX_AST_child(ast, call, 1 + i)).value_symbol;
+		DARRAY_PUSH(u32)(&generics->arguments, Generics_substitute(generics, ast, code_gen->instantiation, argument));
+	}
+	Symbol name = Generics_name(generics, CX_AST_token(ast, CX_AST_child(ast, call, 0)).value_symbol, generics->arguments.data + arguments_start, count);
+	generics->arguments.len = arguments_start;
+	return name;
+}
+
+// Whether an expression is emitted as its value
+bool CodeGenerator_is_folded(CodeGenerator *code_gen, CX_AST *ast, CX_AST_Index node) {
+	if(!code_gen->constants || !code_gen->constants->types.data[node]) return false;
+	CX_AST_Node_Type kind = CX_AST_kind(ast, node);
+	return kind == CX_AST_NODE_TYPE_NUMBER_LIT || kind == CX_AST_NODE_TYPE_NAME_ID || kind == CX_AST_NODE_TYPE_UNARY_EXPR || kind == CX_AST_NODE_TYPE_BINARY_EXPR
+		|| kind == CX_AST_NODE_TYPE_INDEX_EXPR;
+}
+
+// A literal C reads back as the same value of the same type
+void CodeGenerator_constant(CodeGenerator *code_gen, Constant value) {
+	Constant_Type type = constant_types[value.type];
+	char literal[64];
+
+	if(type.is_float) {
+		const char *suffix = value.type == SYMBOL_F32 ? "f" : "";
+		if(value.f != value.f) {
+			snprintf(literal, sizeof(literal), "(0.0%s / 0.0%s)", suffix, suffix);
+		} else if(value.f - value.f != 0) { // infinite
+			snprintf(literal, sizeof(literal), "(%s1.0%s / 0.0%s)", value.f < 0 ? "-" : "", suffix, suffix);
+		} else {
+			snprintf(literal, sizeof(literal), value.type == SYMBOL_F32 ? "%.9g" : "%.17g", value.f);
+			if(!strpbrk(literal, ".e")) strcat(literal, ".0");
+			strcat(literal, suffix);
+		}
+	} else if(type.is_signed) {
+		const char *suffix = type.bits == 64 ? "LL" : "";
+		if(value.i == -Constant_Type_max(type) - 1) snprintf(literal, sizeof(literal), "(%lld%s - 1)", (long long) value.i + 1, suffix);
+		else snprintf(literal, sizeof(literal), "%lld%s", (long long) value.i, suffix);
+	} else {
+		snprintf(literal, sizeof(literal), "%llu%s", (unsigned long long) value.u, type.bits == 64 ? "ull" : type.bits == 32 ? "u" : "");
+	}
+
+	DARRAY(char) *out = &code_gen->out;
+	bool narrow = !type.is_float && type.bits < 32; // C has no literals of these types
+	bool negative = literal[0] == '-';
+	if(narrow) {
+		sb_append_cstr(out, "((");
+		sb_append_sv(out, Symbol_sv(SymbolMap_at(code_gen->data_type_translations, value.type)));
+		sb_append_cstr(out, ") ");
+	}
+	if(negative) sb_append_char(out, '(');
+	sb_append_cstr(out, literal);
+	if(negative) sb_append_char(out, ')');
+	if(narrow) sb_append_char(out, ')');
+}
+
+void CodeGenerator_indent(CodeGenerator *code_gen) {
+	int indent_len = code_gen->indent_len < CODE_GENERATOR_MAX_INDENT ? code_gen->indent_len : CODE_GENERATOR_MAX_INDENT;
+	sb_append_chars(&code_gen->out, '\t', indent_len);
+}
+
+
+void CodeGenerator_flush(CodeGenerator *code_gen) {
+	fwrite(code_gen->out.data, 1, code_gen->out.len, code_gen->sink);
+	if(code_gen->copy) sb_append(code_gen->copy, code_gen->out.data, code_gen->out.len);
+	code_gen->bytes_emitted += code_gen->out.len;
+	code_gen->out.len = 0;
+}
+
+// `static const T name[length] = { ... };`, narrow elements are written as i32 literals, which C
+// converts to the element type without a cast
+void CodeGenerator_const_array(CodeGenerator *code_gen, CX_AST *ast, CX_AST_Index node) {
+	DARRAY(char) *out = &code_gen->out;
+	Constants *constants = code_gen->constants;
+	Symbol type = constants->types.data[node];
+	u64 first = constants->values.data[node], length = constants->elements.data[first];
+	bool narrow = !constant_types[type].is_float && constant_types[type].bits < 32;
+
+	sb_append_cstr(out, "static const ");
+	sb_append_sv(out, CodeGenerator_data_type(code_gen, CX_AST_token(ast, CX_AST_child(ast, node, 0))));
+	sb_append_char(out, ' ');
+	sb_append_sv(out, Symbol_sv(CX_AST_token(ast, CX_AST_child(ast, node, 1)).value_symbol));
+	sb_append_char(out, '[');
+	sb_append_int(out, length);
+	sb_append_cstr(out, "] = {");
+
+	for(u64 i = 0; i < length; ++i) {
+		if(i % CODE_GENERATOR_ELEMENTS_PER_LINE == 0) {
+			sb_append_char(out, '\n');
+			CodeGenerator_indent(code_gen);
+			sb_append_char(out, '\t');
+		} else {
+			sb_append_char(out, ' ');
+		}
+
+		Constant element = { .type = type, .u = constants->elements.data[first + 1 + i] };
+		if(narrow) Constant_convert(element, SYMBOL_I32, &element);
+		CodeGenerator_constant(code_gen, element);
+		sb_append_char(out, ',');
+		if(out->len >= CODE_GENERATOR_CHUNK_SIZE) CodeGenerator_flush(code_gen);
+	}
+
+	sb_append_char(out, '\n');
+	CodeGenerator_indent(code_gen);
+	sb_append_cstr(out, "};\n");
+}
+
+// Operators' operands are parenthesized when they are expressions themselves, so the C
+// compiler's precedence rules never come into play
+bool CodeGenerator_is_nested_expr(CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	CX_AST_Node_Type kind = CX_AST_kind(ast, node);
+	CX_AST_Node_Type parent_kind = CX_AST_kind(ast, parent);
+	return (kind == CX_AST_NODE_TYPE_UNARY_EXPR || kind == CX_AST_NODE_TYPE_BINARY_EXPR)
+		&& (parent_kind == CX_AST_NODE_TYPE_UNARY_EXPR || parent_kind == CX_AST_NODE_TYPE_BINARY_EXPR
+			|| (parent_kind == CX_AST_NODE_TYPE_INDEX_EXPR && CX_AST_child(ast, parent, 0) == node));
+}
+
+// A blank line between top level declarations
+void CodeGenerator_separate(CodeGenerator *code_gen) {
+	if(code_gen->declarations) sb_append_char(&code_gen->out, '\n');
+}
+
+void CodeGenerator_enter_instantiation(CodeGenerator *code_gen, CX_AST *ast, u32 instantiation) {
+	Instantiation *instance = &code_gen->generics->instantiations.data[instantiation];
+	code_gen->instantiation = instantiation;
+	for(size_t i = 0; i < CX_AST_type_parameters_count(ast, instance->function); ++i) {
+		Symbol parameter = CX_AST_token(ast, CX_AST_child(ast, instance->function, 2 + i)).value_symbol;
+		SymbolMap_put(&code_gen->type_arguments, parameter, code_gen->generics->arguments.data[instance->arguments + i]);
+	}
+}
+
+// data_type name(parameters...);
+void CodeGenerator_prototype(CodeGenerator *code_gen, CX_AST *ast, CX_AST_Index function, Symbol name) {
+	DARRAY(char) *out = &code_gen->out;
+	size_t children_count = CX_AST_children_count(ast, function), first_parameter = 2 + CX_AST_type_parameters_count(ast, function);
+
+	sb_append_sv(out, CodeGenerator_data_type(code_gen, CX_AST_token(ast, CX_AST_child(ast, function, 0))));
+	sb_append_char(out, ' ');
+	sb_append_sv(out, Symbol_sv(name));
+	sb_append_char(out, '(');
+	for(size_t i = first_parameter; i < children_count - 1; ++i) {
+		CX_AST_Index parameter = CX_AST_child(ast, function, i);
+		if(i > first_parameter) sb_append_cstr(out, ", ");
+		sb_append_sv(out, CodeGenerator_data_type(code_gen, CX_AST_token(ast, CX_AST_child(ast, parameter, 0))));
+		sb_append_char(out, ' ');
+		sb_append_sv(out, Symbol_sv(CX_AST_token(ast, CX_AST_child(ast, parameter, 1)).value_symbol));
+	}
+	sb_append_cstr(out, ");\n");
+}
+
+// Emits the instantiations which go before `declaration`, those called before their definition
+// are declared first
+void CodeGenerator_instantiations(CodeGenerator *code_gen, CX_AST *ast, CX_AST_Index declaration) {
+	Generics *generics = code_gen->generics;
+	size_t first = code_gen->next_instantiation;
+	while(code_gen->next_instantiation < generics->order.len && generics->instantiations.data[generics->order.data[code_gen->next_instantiation]].before == declaration)
+		++code_gen->next_instantiation;
+
+	bool declared_ahead = false;
+	for(size_t i = first; i < code_gen->next_instantiation; ++i) {
+		u32 instantiation = generics->order.data[i];
+		Instantiation *instance = &generics->instantiations.data[instantiation];
+		if(!instance->declared_ahead) continue;
+		if(!declared_ahead) CodeGenerator_separate(code_gen);
+		declared_ahead = true;
+		CodeGenerator_enter_instantiation(code_gen, ast, instantiation);
+		CodeGenerator_prototype(code_gen, ast, instance->function, instance->name);
+	}
+	code_gen->declarations += declared_ahead;
+
+	for(size_t i = first; i < code_gen->next_instantiation; ++i) {
+		u32 instantiation = generics->order.data[i];
+		CodeGenerator_enter_instantiation(code_gen, ast, instantiation);
+		CX_AST_walk(ast, generics->instantiations.data[instantiation].function, &code_gen->visitor);
+	}
+	code_gen->instantiation = UINT32_MAX;
+}
+
+void CodeGenerator_enter(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	CodeGenerator *code_gen = (CodeGenerator*) visitor;
+	DARRAY(char) *out = &code_gen->out;
+
+	if(parent == ast->root && code_gen->generics) CodeGenerator_instantiations(code_gen, ast, node);
+
+	if(CodeGenerator_is_folded(code_gen, ast, node)) {
+		CodeGenerator_constant(code_gen, Constants_at(code_gen->constants, node));
+		visitor->skip = true;
+		return;
+	}
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_NULL:
+			assert(false && "unreachable");
+			break;
+		case CX_AST_NODE_TYPE_ROOT:
+			break;
+		case CX_AST_NODE_TYPE_TYPE_ID:
+			if(CX_AST_kind(ast, parent) == CX_AST_NODE_TYPE_CALL_EXPR) { // a type argument, in the name of the function
+				visitor->skip = true;
+				break;
+			}
+			sb_append_sv(out, CodeGenerator_data_type(code_gen, CX_AST_token(ast, node)));
+			break;
+		case CX_AST_NODE_TYPE_NAME_ID:
+			{
+				Symbol name = CX_AST_token(ast, node).value_symbol;
+				CX_AST_Node_Type parent_kind = CX_AST_kind(ast, parent);
+				if(parent_kind == CX_AST_NODE_TYPE_FUNCTION_DECL && code_gen->instantiation != UINT32_MAX && CX_AST_child(ast, parent, 1) == node)
+					name = code_gen->generics->instantiations.data[code_gen->instantiation].name;
+				else if(parent_kind == CX_AST_NODE_TYPE_CALL_EXPR && CX_AST_child(ast, parent, 0) == node && code_gen->generics && CX_AST_type_arguments_count(ast, parent))
+					name = CodeGenerator_instance_name(code_gen, ast, parent);
+				sb_append_sv(out, Symbol_sv(name));
+			}
+			break;
+		case CX_AST_NODE_TYPE_NUMBER_LIT:
+			sb_append_sv(out, Token_number_sv(CX_AST_token(ast, node)));
+			break;
+		case CX_AST_NODE_TYPE_STRING_LIT:
+			sb_append_char(out, '"');
+			sb_append_sv(out, Token_value_sv(CX_AST_token(ast, node)));
+			sb_append_char(out, '"');
+			break;
+		case CX_AST_NODE_TYPE_UNARY_EXPR:
+			if(CodeGenerator_is_nested_expr(ast, node, parent)) sb_append_char(out, '(');
+			sb_append_cstr(out, operator_spellings[CX_AST_token(ast, node).type]);
+			break;
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			if(CodeGenerator_is_nested_expr(ast, node, parent)) sb_append_char(out, '(');
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+		case CX_AST_NODE_TYPE_MEMBER_EXPR:
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				// object.method(arguments...) calls type__method(object or &object, arguments...)
+				Symbol object = CodeGenerator_object(code_gen, node);
+				if(!object) break;
+				Array_Method method = Array_method(CX_AST_token(ast, CX_AST_child(ast, node, 0)).value_symbol);
+				sb_append_sv(out, CodeGenerator_type_name(code_gen, object));
+				sb_append_cstr(out, "__"); // as the elements' type may end in _slice
+				sb_append_cstr(out, array_methods[method].name);
+				sb_append_cstr(out, array_methods[method].by_address ? "(&" : "(");
+			}
+			break;
+		case CX_AST_NODE_TYPE_RETURN_STMT:
+			CodeGenerator_indent(code_gen);
+			sb_append_cstr(out, "return ");
+			break;
+		case CX_AST_NODE_TYPE_COMPOUND_STMT:
+			CodeGenerator_indent(code_gen);
+			sb_append_cstr(out, "{\n");
+			++code_gen->indent_len;
+			break;
+		case CX_AST_NODE_TYPE_EXPR_STMT:
+			CodeGenerator_indent(code_gen);
+			break;
+		case CX_AST_NODE_TYPE_IF_STMT:
+			// an `else if` goes on the line of the `else`
+			if(CX_AST_kind(ast, parent) != CX_AST_NODE_TYPE_IF_STMT || CX_AST_child(ast, parent, 2) != node) CodeGenerator_indent(code_gen);
+			sb_append_cstr(out, "if(");
+			break;
+		case CX_AST_NODE_TYPE_WHILE_STMT:
+			CodeGenerator_indent(code_gen);
+			sb_append_cstr(out, "while(");
+			break;
+		case CX_AST_NODE_TYPE_FUNCTION_DECL:
+			if(code_gen->instantiation == UINT32_MAX && CX_AST_type_parameters_count(ast, node)) {
+				visitor->skip = true; // emitted for each of its instantiations
+				break;
+			}
+			CodeGenerator_separate(code_gen);
+			CodeGenerator_indent(code_gen);
+			break;
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			CodeGenerator_indent(code_gen);
+			break;
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			break;
+		case CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL:
+			visitor->skip = true;
+			break;
+		case CX_AST_NODE_TYPE_CONST_DECL:
+			visitor->skip = true; // every use of the constant is folded
+			break;
+		case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+			if(parent == ast->root) CodeGenerator_separate(code_gen);
+			CodeGenerator_indent(code_gen);
+			CodeGenerator_const_array(code_gen, ast, node);
+			visitor->skip = true;
+			break;
+	}
+
+	if(out->len >= CODE_GENERATOR_CHUNK_SIZE) CodeGenerator_flush(code_gen);
+}
+
+void CodeGenerator_between(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, size_t next_child) {
+	CodeGenerator *code_gen = (CodeGenerator*) visitor;
+	DARRAY(char) *out = &code_gen->out;
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			sb_append_char(out, ' ');
+			sb_append_cstr(out, operator_spellings[CX_AST_token(ast, node).type]);
+			sb_append_char(out, ' ');
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			sb_append_cstr(out, CodeGenerator_object(code_gen, node) ? ".data[" : "[");
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				// function(arguments...), the type arguments are part of the function's name
+				size_t first_argument = 1 + CX_AST_type_arguments_count(ast, node);
+				bool method = CodeGenerator_object(code_gen, node);
+				if(next_child >= first_argument) sb_append_cstr(out, next_child == first_argument && !method ? "(" : ", ");
+			}
+			break;
+		case CX_AST_NODE_TYPE_IF_STMT:
+			if(next_child == 1) {
+				sb_append_cstr(out, ")\n");
+			} else {
+				CodeGenerator_indent(code_gen);
+				sb_append_cstr(out, CX_AST_kind(ast, CX_AST_child(ast, node, 2)) == CX_AST_NODE_TYPE_IF_STMT ? "else " : "else\n");
+			}
+			break;
+		case CX_AST_NODE_TYPE_WHILE_STMT:
+			sb_append_cstr(out, ")\n");
+			break;
+		case CX_AST_NODE_TYPE_FUNCTION_DECL:
+			{
+				// data_type name(parameter, ...) body, the type parameters are not emitted
+				size_t first_parameter = 2 + CX_AST_type_parameters_count(ast, node);
+				if(next_child == 1) sb_append_char(out, ' ');
+				else if(next_child < first_parameter) break;
+				else if(next_child == CX_AST_children_count(ast, node) - 1) sb_append_cstr(out, next_child == first_parameter ? "()\n" : ")\n");
+				else sb_append_cstr(out, next_child == first_parameter ? "(" : ", ");
+			}
+			break;
+		case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			sb_append_char(out, ' ');
+			break;
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			sb_append_cstr(out, next_child == 1 ? " " : " = ");
+			break;
+		default:
+			break;
+	}
+}
+
+void CodeGenerator_leave(CX_AST_Visitor *visitor, CX_AST *ast, CX_AST_Index node, CX_AST_Index parent) {
+	CodeGenerator *code_gen = (CodeGenerator*) visitor;
+	DARRAY(char) *out = &code_gen->out;
+
+	switch(CX_AST_kind(ast, node)) {
+		case CX_AST_NODE_TYPE_ROOT:
+			if(code_gen->declarations) sb_append_char(out, '\n');
+			break;
+		case CX_AST_NODE_TYPE_UNARY_EXPR:
+		case CX_AST_NODE_TYPE_BINARY_EXPR:
+			if(CodeGenerator_is_nested_expr(ast, node, parent) && !CodeGenerator_is_folded(code_gen, ast, node)) sb_append_char(out, ')');
+			break;
+		case CX_AST_NODE_TYPE_INDEX_EXPR:
+			if(!CodeGenerator_is_folded(code_gen, ast, node)) sb_append_char(out, ']');
+			break;
+		case CX_AST_NODE_TYPE_CALL_EXPR:
+			{
+				bool arguments = CX_AST_children_count(ast, node) > 1 + CX_AST_type_arguments_count(ast, node);
+				sb_append_cstr(out, arguments || CodeGenerator_object(code_gen, node) ? ")" : "()");
+			}
+			break;
+		case CX_AST_NODE_TYPE_MEMBER_EXPR:
+			if(CX_AST_kind(ast, parent) != CX_AST_NODE_TYPE_CALL_EXPR || CX_AST_child(ast, parent, 0) != node) sb_append_cstr(out, ".len");
+			break;
+		case CX_AST_NODE_TYPE_VARIABLE_DECL:
+			if(CX_AST_children_count(ast, node) < 3) sb_append_cstr(out, " = { 0 }"); // an empty array or slice
+			sb_append_cstr(out, ";\n");
+			break;
+		case CX_AST_NODE_TYPE_RETURN_STMT:
+		case CX_AST_NODE_TYPE_EXPR_STMT:
+			sb_append_cstr(out, ";\n");
+			break;
+		case CX_AST_NODE_TYPE_COMPOUND_STMT:
+			--code_gen->indent_len;
+			CodeGenerator_indent(code_gen);
+			sb_append_cstr(out, "}\n");
+			break;
+		case CX_AST_NODE_TYPE_FUNCTION_DECL:
+			if(code_gen->instantiation != UINT32_MAX || !CX_AST_type_parameters_count(ast, node)) ++code_gen->declarations;
+			break;
+		case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+			if(CX_AST_kind(ast, parent) == CX_AST_NODE_TYPE_ROOT) ++code_gen->declarations;
+			break;
+		default:
+			break;
+	}
+
+	if(out->len >= CODE_GENERATOR_CHUNK_SIZE) CodeGenerator_flush(code_gen);
+}
+
+// Returns whether all of the code was written to the sink
+bool generate_code(CodeGenerator *code_gen, CX_AST *ast, FILE *sink) {
+	code_gen->visitor = (CX_AST_Visitor) {
+		.enter = CodeGenerator_enter,
+		.between = CodeGenerator_between,
+		.leave = CodeGenerator_leave
+	};
+	code_gen->sink = sink;
+	code_gen->bytes_emitted = 0;
+	code_gen->declarations = 0;
+	code_gen->indent_len = 0;
+	code_gen->next_instantiation = 0;
+	code_gen->instantiation = UINT32_MAX;
+	SymbolMap_init(&code_gen->type_arguments);
+	DARRAY_INIT(char)(&code_gen->out, CODE_GENERATOR_CHUNK_SIZE + CODE_GENERATOR_CHUNK_SIZE / 4);
+
+	if(code_gen->arrays && code_gen->arrays->types.len) CodeGenerator_array_types(code_gen);
+	CX_AST_walk(ast, ast->root, &code_gen->visitor);
+	CodeGenerator_flush(code_gen);
+
+	DARRAY_FREE(char)(&code_gen->out);
+	SymbolMap_free(&code_gen->type_arguments);
+	return fflush(sink) == 0 && !ferror(sink);
+}
+
+//
+
+void usage(char *program_name, FILE *sink) {
+	fprintf(sink, "Usage: %s [options] <file.cx>...\n", program_name);
+	fprintf(sink, "       %s --server <socket>\n", program_name);
+	fprintf(sink, "       %s --connect <socket> [options] <file.cx>...\n", program_name);
+	fprintf(sink, "Use - as <file.cx> to read the standard input\n");
+	fprintf(sink, "A --server keeps its state warm between the command lines forwarded by --connect\n");
+	fprintf(sink, "Options:\n");
+	fprintf(sink, "    -o <file.c>   Place the output into <file.c>, required for a single input.\n");
+	fprintf(sink, "                  With several inputs the output of dir/name.cx is dir/name.c\n");
+	fprintf(sink, "    -j <N>        Compile up to N files at once\n");
+	fprintf(sink, "    -h, --help    Print this message\n");
+	fprintf(sink, "    --dump-ast    Display the program's syntax tree to stderr\n");
+	fprintf(sink, "    --emit-ast    Write the syntax tree instead of C, dir/name.cxast with several inputs.\n");
+	fprintf(sink, "                  Compiling a .cxast file later skips lexing and parsing\n");
+	fprintf(sink, "    --stats       Print statistics about the compilation to stderr\n");
+	fprintf(sink, "    --time-passes Print the wall and CPU time of each pass to stderr\n");
+	fprintf(sink, "    --trace <file.json>\n");
+	fprintf(sink, "                  Write the passes as Chrome trace events, for chrome://tracing or Perfetto\n");
+	fprintf(sink, "    --cache-dir <dir>\n");
+	fprintf(sink, "                  Reuse the output of files compiled before, kept in <dir>.\n");
+	fprintf(sink, "                  Defaults to $CX_CACHE_DIR when it is set\n");
+	fprintf(sink, "    --cache-max-size <MB>\n");
+	fprintf(sink, "                  Evict the least recently used outputs beyond <MB> megabytes (default 256)\n");
+}
+
+bool dump_ast = false;
+bool emit_ast = false;
+
+SymbolMap data_type_translations;
+
+void data_type_translations_init(void) {
+	SymbolMap_init(&data_type_translations);
+
+	SymbolMap_put(&data_type_translations, SYMBOL_B8,  Symbol_intern(sv_from_cstr("_Bool")));
+	// SymbolMap_put(&data_type_translations, SYMBOL_B32, Symbol_intern(sv_from_cstr("int")));
+	SymbolMap_put(&data_type_translations, SYMBOL_I8,  Symbol_intern(sv_from_cstr("signed char")));
+	SymbolMap_put(&data_type_translations, SYMBOL_I16, Symbol_intern(sv_from_cstr("signed short")));
+	SymbolMap_put(&data_type_translations, SYMBOL_I32, Symbol_intern(sv_from_cstr("signed int")));
+	SymbolMap_put(&data_type_translations, SYMBOL_I64, Symbol_intern(sv_from_cstr("signed long long")));
+	SymbolMap_put(&data_type_translations, SYMBOL_U8,  Symbol_intern(sv_from_cstr("unsigned char")));
+	SymbolMap_put(&data_type_translations, SYMBOL_U16, Symbol_intern(sv_from_cstr("unsigned short")));
+	SymbolMap_put(&data_type_translations, SYMBOL_U32, Symbol_intern(sv_from_cstr("unsigned int")));
+	SymbolMap_put(&data_type_translations, SYMBOL_U64, Symbol_intern(sv_from_cstr("unsigned long long")));
+	SymbolMap_put(&data_type_translations, SYMBOL_F32, Symbol_intern(sv_from_cstr("float")));
+	SymbolMap_put(&data_type_translations, SYMBOL_F64, Symbol_intern(sv_from_cstr("double")));
+}
+
+// Compilation cache
+
+// With --cache-dir, the C generated for a file is kept in the cache directory under a hash of the
+// file's contents, of the compiler's build and of the options which affect the output. A file
+// whose key is found there is not compiled, the cached C is copied to its output instead.
+// Entries are used as a whole or not at all: they are written to a temporary file and renamed.
+// Hits refresh an entry's modification time and eviction removes the least recently used entries
+// until the directory fits in --cache-max-size. Not supported on Windows.
+
+// Identifies cx's source, the Makefile sets it to a checksum of cx.c. Builds without it fall back
+// on when they were compiled, so their entries are not shared with any other build.
+#ifndef CX_BUILD_ID
+#	define CX_BUILD_ID __DATE__ " " __TIME__
+#endif
+#define CACHE_DEFAULT_MAX_SIZE (256 * 1024 * 1024)
+
+char *cache_dir = NULL;
+size_t cache_max_size = CACHE_DEFAULT_MAX_SIZE;
+atomic_size_t cache_temp_count = 0; // keeps temporary entry names of one process unique
+
+// 64 bit hash of `size` bytes, eight at a time (FNV-1a style mixing, murmur3's finalizer)
+u64 hash_bytes(const void *data, size_t size, u64 seed) {
+	const u8 *bytes = data;
+	u64 hash = seed ^ (size * 0x9e3779b97f4a7c15ull);
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8) {
+		u64 word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 0x100000001b3ull;
+		hash ^= hash >> 29;
+	}
+	for(; i < size; ++i) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb34fe1a85ec3ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// None of the options change the generated code yet, new ones which do belong in here
+u64 cache_key(SourceFile *source) {
+	const char *build = CX_BUILD_ID;
+	const char *options = "";
+	u64 seed = hash_bytes(build, strlen(build), 0);
+	seed = hash_bytes(options, strlen(options), seed);
+	// an AST file's tree need not be the one its source parses to, so all of the file is hashed
+	if(source->ast) return hash_bytes(source->ast, source->ast_len, seed);
+	return hash_bytes(source->data, source->len, seed);
+}
+
+bool write_file(char *path, StringView content) {
+	FILE *fp = fopen(path, "wb");
+	if(!fp) return false;
+	bool ok = fwrite(content.data, 1, content.size, fp) == content.size;
+	if(fclose(fp)) ok = false;
+	return ok;
+}
+
+// Appends all of the file at `path` to `out`
+bool append_file(char *path, DARRAY(char) *out) {
+	FILE *fp = fopen(path, "rb");
+	if(!fp) return false;
+	char buffer[SOURCE_READ_CHUNK_SIZE];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), fp))) sb_append(out, buffer, n);
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+bool copy_file(char *from_path, char *to_path) {
+	FILE *from = fopen(from_path, "rb");
+	if(!from) return false;
+	FILE *to = fopen(to_path, "wb");
+	if(!to) {
+		fclose(from);
+		return false;
+	}
+
+	char buffer[SOURCE_READ_CHUNK_SIZE];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), from))) {
+		if(fwrite(buffer, 1, n, to) != n) break;
+	}
+
+	bool ok = !ferror(from) && !ferror(to);
+	fclose(from);
+	if(fclose(to)) ok = false;
+	return ok;
+}
+
+#ifndef _WIN32
+
+// Path of the entry for `key`, or of a temporary file for it when `temp` is not 0
+void cache_entry_path(char *path, size_t size, u64 key, size_t temp) {
+	if(temp) snprintf(path, size, "%s/%016llx.c.%ld.%zu.tmp", cache_dir, (unsigned long long) key, (long) getpid(), temp);
+	else snprintf(path, size, "%s/%016llx.c", cache_dir, (unsigned long long) key);
+}
+
+// Copies the cached output for `key` to `output_filename`, and appends it to `content` unless that
+// is NULL, returns whether there was one. `content` is left as it was when there is none.
+bool cache_fetch(u64 key, char *output_filename, DARRAY(char) *content) {
+	char path[4096];
+	cache_entry_path(path, sizeof(path), key, 0);
+	if(content) {
+		size_t start = content->len;
+		if(!append_file(path, content) || !write_file(output_filename, (StringView) { .data = content->data + start, .size = content->len - start })) {
+			content->len = start;
+			return false;
+		}
+	} else if(!copy_file(path, output_filename)) {
+		return false;
+	}
+	utime(path, NULL); // most recently used
+	return true;
+}
+
+void cache_store(u64 key, char *output_filename) {
+	char temp_path[4096], path[4096];
+	cache_entry_path(temp_path, sizeof(temp_path), key, atomic_fetch_add(&cache_temp_count, 1) + 1);
+	cache_entry_path(path, sizeof(path), key, 0);
+	if(!copy_file(output_filename, temp_path) || rename(temp_path, path)) remove(temp_path);
+}
+
+typedef struct {
+	char name[32];
+	size_t size;
+	time_t used;
+} Cache_Entry;
+
+FORWARD_DECLARE_DARRAY(Cache_Entry)
+DECLARE_DARRAY(Cache_Entry)
+
+int Cache_Entry_compare_used(const void *a, const void *b) {
+	time_t x = ((Cache_Entry*) a)->used, y = ((Cache_Entry*) b)->used;
+	return (x > y) - (x < y);
+}
+
+// Removes the least recently used entries until the cache fits in cache_max_size,
+// returns the number of bytes removed
+size_t cache_evict(size_t *evicted_count) {
+	size_t evicted = 0;
+	*evicted_count = 0;
+
+	DIR *dir = opendir(cache_dir);
+	if(!dir) return 0;
+
+	DARRAY(Cache_Entry) entries;
+	DARRAY_INIT(Cache_Entry)(&entries, 64);
+	size_t total = 0;
+
+	char path[4096];
+	struct dirent *dirent;
+	while((dirent = readdir(dir))) {
+		size_t len = strlen(dirent->d_name);
+		if(len != 18 || strcmp(dirent->d_name + 16, ".c")) continue; // only entries, see cache_entry_path
+
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/%s", cache_dir, dirent->d_name);
+		if(stat(path, &st)) continue;
+
+		Cache_Entry entry = { .size = st.st_size, .used = st.st_mtime };
+		memcpy(entry.name, dirent->d_name, len + 1);
+		DARRAY_PUSH(Cache_Entry)(&entries, entry);
+		total += entry.size;
+	}
+	closedir(dir);
+
+	if(total > cache_max_size) {
+		qsort(entries.data, entries.len, sizeof(Cache_Entry), Cache_Entry_compare_used);
+		for(size_t i = 0; i < entries.len && total - evicted > cache_max_size; ++i) {
+			snprintf(path, sizeof(path), "%s/%s", cache_dir, entries.data[i].name);
+			if(remove(path)) continue;
+			evicted += entries.data[i].size;
+			++*evicted_count;
+		}
+	}
+
+	DARRAY_FREE(Cache_Entry)(&entries);
+	return evicted;
+}
+
+#else
+
+bool cache_fetch(u64 key, char *output_filename, DARRAY(char) *content) {
+	(void) key;
+	(void) output_filename;
+	(void) content;
+	return false;
+}
+
+void cache_store(u64 key, char *output_filename) {
+	(void) key;
+	(void) output_filename;
+}
+
+size_t cache_evict(size_t *evicted_count) {
+	*evicted_count = 0;
+	return 0;
+}
+
+#endif // _WIN32
+
+// CX_AST files
+
+// `--emit-ast` writes a unit's tree instead of its C, and a file starting with CX_AST_FILE_MAGIC
+// is compiled from the tree in it instead of being lexed and parsed. The file is the CX_AST's
+// arrays as they are in memory, so it is mapped back and used in place: the sections are at
+// offsets relative to the start of the file, aligned for their elements. NAME tokens hold symbols,
+// the file lists the names of the unit's symbols past the seed ones in order, interning them
+// again gives back the same ids. The source is kept too, for diagnostics and string literals.
+// Symbols and node layouts may change between builds of cx, a file only loads in the build that
+// wrote it.
+
+#define CX_AST_FILE_MAGIC "CXAST\r\n\x1a" // 8 bytes, the line endings catch text mode transfers
+#define CX_AST_FILE_VERSION 4
+
+typedef enum {
+	CX_AST_FILE_KINDS,
+	CX_AST_FILE_TOKEN_TYPES,
+	CX_AST_FILE_TOKEN_OFFSETS,
+	CX_AST_FILE_TOKEN_VALUES,
+	CX_AST_FILE_CHILDREN_FIRST,
+	CX_AST_FILE_CHILDREN_COUNT,
+	CX_AST_FILE_CHILDREN,
+	CX_AST_FILE_SYMBOLS, // offset and length of each name in STRINGS, as two u32
+	CX_AST_FILE_STRINGS,
+	CX_AST_FILE_SOURCE,
+	CX_AST_FILE_SECTION_COUNT,
+} CX_AST_File_Section;
+
+typedef struct {
+	char magic[8];
+	u32 version;
+	u32 root;
+	u64 build; // see CX_AST_File_build
+	u32 node_count; // the null node included
+	u32 children_len;
+	u32 seed_symbol_count; // symbols every unit starts with, not stored
+	u32 symbol_count;
+	u64 sections[CX_AST_FILE_SECTION_COUNT][2]; // offset from the start of the file and size in bytes
+} CX_AST_File_Header;
+
+#define CX_AST_FILE_ANY_SIZE UINT64_MAX
+
+// Smallest and largest number of children of each kind of node
+const u32 CX_AST_node_arities[CX_AST_NODE_TYPE_CONST_ARRAY_DECL + 1][2] = {
+	[CX_AST_NODE_TYPE_NULL] = { 0, 0 },
+	[CX_AST_NODE_TYPE_ROOT] = { 0, UINT32_MAX },
+	[CX_AST_NODE_TYPE_TYPE_ID] = { 0, 0 },
+	[CX_AST_NODE_TYPE_NAME_ID] = { 0, 0 },
+	[CX_AST_NODE_TYPE_NUMBER_LIT] = { 0, 0 },
+	[CX_AST_NODE_TYPE_STRING_LIT] = { 0, 0 },
+	[CX_AST_NODE_TYPE_UNARY_EXPR] = { 1, 1 },
+	[CX_AST_NODE_TYPE_BINARY_EXPR] = { 2, 2 },
+	[CX_AST_NODE_TYPE_INDEX_EXPR] = { 2, 2 },
+	[CX_AST_NODE_TYPE_CALL_EXPR] = { 1, UINT32_MAX },
+	[CX_AST_NODE_TYPE_MEMBER_EXPR] = { 1, 1 },
+	[CX_AST_NODE_TYPE_RETURN_STMT] = { 1, 1 },
+	[CX_AST_NODE_TYPE_COMPOUND_STMT] = { 0, UINT32_MAX },
+	[CX_AST_NODE_TYPE_EXPR_STMT] = { 1, 1 },
+	[CX_AST_NODE_TYPE_IF_STMT] = { 2, 3 },
+	[CX_AST_NODE_TYPE_WHILE_STMT] = { 2, 2 },
+	[CX_AST_NODE_TYPE_FUNCTION_DECL] = { 3, UINT32_MAX },
+	[CX_AST_NODE_TYPE_PARAMETER_DECL] = { 2, 2 },
+	[CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL] = { 0, 0 },
+	[CX_AST_NODE_TYPE_VARIABLE_DECL] = { 2, 3 },
+	[CX_AST_NODE_TYPE_CONST_DECL] = { 3, 3 },
+	[CX_AST_NODE_TYPE_CONST_ARRAY_DECL] = { 4, 4 },
+};
+
+u64 CX_AST_File_build(void) {
+	return hash_bytes(CX_BUILD_ID, strlen(CX_BUILD_ID), CX_AST_FILE_VERSION);
+}
+
+bool CX_AST_File_is(SourceFile *file) {
+	return file->len >= sizeof(CX_AST_File_Header) && memcmp(file->data, CX_AST_FILE_MAGIC, 8) == 0;
+}
+
+#define CX_AST_FILE_SECTION(header, image, section) ((void*) ((image) + (header)->sections[section][0]))
+
+// What is wrong with an AST file, or NULL. Everything the later passes rely on is checked, so a
+// damaged file is an error and not a crash: one pass over the nodes, much cheaper than parsing.
+const char *CX_AST_File_problem(char *image, size_t size) {
+	CX_AST_File_Header *header = (CX_AST_File_Header*) image;
+	if(header->version != CX_AST_FILE_VERSION) return "unsupported version";
+	if(header->build != CX_AST_File_build() || header->seed_symbol_count != seed_symbols._from.len)
+		return "written by another build of cx";
+
+	u64 n = header->node_count;
+	u64 expected_sizes[CX_AST_FILE_SECTION_COUNT] = {
+		[CX_AST_FILE_KINDS] = n,
+		[CX_AST_FILE_TOKEN_TYPES] = n,
+		[CX_AST_FILE_TOKEN_OFFSETS] = n * sizeof(u32),
+		[CX_AST_FILE_TOKEN_VALUES] = n * sizeof(u32),
+		[CX_AST_FILE_CHILDREN_FIRST] = n * sizeof(u32),
+		[CX_AST_FILE_CHILDREN_COUNT] = n * sizeof(u32),
+		[CX_AST_FILE_CHILDREN] = (u64) header->children_len * sizeof(u32),
+		[CX_AST_FILE_SYMBOLS] = (u64) header->symbol_count * 2 * sizeof(u32),
+		[CX_AST_FILE_STRINGS] = CX_AST_FILE_ANY_SIZE,
+		[CX_AST_FILE_SOURCE] = CX_AST_FILE_ANY_SIZE,
+	};
+	for(size_t i = 0; i < CX_AST_FILE_SECTION_COUNT; ++i) {
+		u64 offset = header->sections[i][0], section_size = header->sections[i][1];
+		if(offset % 8 || offset > size || section_size > size - offset) return "truncated";
+		if(expected_sizes[i] != CX_AST_FILE_ANY_SIZE && section_size != expected_sizes[i]) return "inconsistent section sizes";
+	}
+	if(!n || !header->root || header->root >= n) return "no root node";
+
+	u64 source_len = header->sections[CX_AST_FILE_SOURCE][1];
+	u64 strings_len = header->sections[CX_AST_FILE_STRINGS][1];
+	u64 symbol_end = header->seed_symbol_count + header->symbol_count;
+	if(source_len > UINT32_MAX) return "source too large";
+
+	u32 *symbols = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_SYMBOLS);
+	for(size_t i = 0; i < header->symbol_count; ++i)
+		if(symbols[2 * i] > strings_len || symbols[2 * i + 1] > strings_len - symbols[2 * i]) return "symbol name out of bounds";
+
+	u8 *kinds = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_KINDS);
+	u8 *token_types = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_TYPES);
+	u32 *token_offsets = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_OFFSETS);
+	u32 *token_values = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_VALUES);
+	u32 *children_first = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN_FIRST);
+	u32 *children_count = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN_COUNT);
+	u32 *children = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN);
+	if(kinds[header->root] != CX_AST_NODE_TYPE_ROOT) return "no root node";
+
+	for(u64 node = 1; node < n; ++node) {
+		if(kinds[node] == CX_AST_NODE_TYPE_NULL || kinds[node] > CX_AST_NODE_TYPE_CONST_ARRAY_DECL) return "unknown node kind";
+		if(kinds[node] == CX_AST_NODE_TYPE_ROOT && node != header->root) return "more than one root node";
+		const u32 *arity = CX_AST_node_arities[kinds[node]];
+		if(children_count[node] < arity[0] || children_count[node] > arity[1]) return "wrong number of children";
+		if((u64) children_first[node] + children_count[node] > header->children_len) return "children out of bounds";
+		for(u32 i = 0; i < children_count[node]; ++i) {
+			u32 child = children[children_first[node] + i];
+			if(!child || child >= node) return "children not in post-order"; // which also rules out cycles
+		}
+
+		Token_Type type = token_types[node];
+		if(type > TOKEN_EOF) return "unknown token type";
+		switch(kinds[node]) {
+			case CX_AST_NODE_TYPE_TYPE_ID:
+			case CX_AST_NODE_TYPE_NAME_ID:
+			case CX_AST_NODE_TYPE_MEMBER_EXPR:
+			case CX_AST_NODE_TYPE_IF_STMT:
+			case CX_AST_NODE_TYPE_WHILE_STMT:
+			case CX_AST_NODE_TYPE_PARAMETER_DECL:
+			case CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL:
+			case CX_AST_NODE_TYPE_CONST_DECL:
+			case CX_AST_NODE_TYPE_CONST_ARRAY_DECL:
+				if(type != TOKEN_NAME) return "name without a name token";
+				break;
+			case CX_AST_NODE_TYPE_NUMBER_LIT:
+				if(type != TOKEN_NUMBER) return "number without a number token";
+				break;
+			case CX_AST_NODE_TYPE_STRING_LIT:
+				if(type != TOKEN_STRING) return "string without a string token";
+				break;
+			case CX_AST_NODE_TYPE_UNARY_EXPR:
+				if(!prefix_operators[type]) return "expression without an operator";
+				break;
+			case CX_AST_NODE_TYPE_BINARY_EXPR:
+				if(!binary_precedences[type]) return "expression without an operator";
+				break;
+			default:
+				break;
+		}
+
+		// declarations' children are told apart by their position
+		u32 *node_children = &children[children_first[node]];
+		bool declaration = kinds[node] >= CX_AST_NODE_TYPE_FUNCTION_DECL && kinds[node] != CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL;
+		if(declaration && (kinds[node_children[0]] != CX_AST_NODE_TYPE_TYPE_ID || kinds[node_children[1]] != CX_AST_NODE_TYPE_NAME_ID))
+			return "declaration without a data type and a name";
+		if(kinds[node] == CX_AST_NODE_TYPE_FUNCTION_DECL) {
+			u32 count = children_count[node], i = 2;
+			while(i + 1 < count && kinds[node_children[i]] == CX_AST_NODE_TYPE_TYPE_PARAMETER_DECL) ++i;
+			for(; i + 1 < count; ++i)
+				if(kinds[node_children[i]] != CX_AST_NODE_TYPE_PARAMETER_DECL) return "function with a parameter which is not one";
+			if(kinds[node_children[count - 1]] != CX_AST_NODE_TYPE_COMPOUND_STMT) return "function without a body";
+		}
+		if(kinds[node] == CX_AST_NODE_TYPE_ROOT)
+			for(u32 i = 0; i < children_count[node]; ++i)
+				if(kinds[node_children[i]] != CX_AST_NODE_TYPE_FUNCTION_DECL && kinds[node_children[i]] != CX_AST_NODE_TYPE_CONST_DECL && kinds[node_children[i]] != CX_AST_NODE_TYPE_CONST_ARRAY_DECL)
+					return "root with a child which is not a declaration";
+		if(kinds[node] == CX_AST_NODE_TYPE_CONST_ARRAY_DECL && kinds[node_children[3]] != CX_AST_NODE_TYPE_NAME_ID)
+			return "constant array without a function";
+		if(kinds[node] == CX_AST_NODE_TYPE_CALL_EXPR && kinds[node_children[0]] != CX_AST_NODE_TYPE_NAME_ID && kinds[node_children[0]] != CX_AST_NODE_TYPE_MEMBER_EXPR)
+			return "call without a function";
+
+		if(token_offsets[node] > source_len) return "token out of bounds";
+		if(type == TOKEN_NAME && token_values[node] >= symbol_end) return "unknown symbol";
+		if((type == TOKEN_STRING || type == TOKEN_CHAR) && (u64) token_offsets[node] + 1 + token_values[node] > source_len)
+			return "literal out of bounds";
+		if(type == TOKEN_NUMBER && (u64) token_offsets[node] + token_values[node] > source_len) return "literal out of bounds";
+	}
+
+	return NULL;
+}
+
+// Makes an AST file's SourceFile stand for the source in it, returns false if the file is damaged
+bool CX_AST_File_open(SourceFile *file) {
+	const char *problem = CX_AST_File_problem(file->data, file->len);
+	if(problem) {
+		error("%s: invalid AST file: %s\n", file->path, problem);
+		return false;
+	}
+
+	CX_AST_File_Header *header = (CX_AST_File_Header*) file->data;
+	file->ast = file->data;
+	file->ast_len = file->len;
+	file->data = CX_AST_FILE_SECTION(header, file->ast, CX_AST_FILE_SOURCE);
+	file->len = header->sections[CX_AST_FILE_SOURCE][1];
+	return true;
+}
+
+// Points `ast` at the arrays in an opened AST file and interns its symbols
+bool CX_AST_map(CX_AST *ast, u16 file) {
+	SourceFile *source = &source_files.data[file];
+	char *image = source->ast;
+	CX_AST_File_Header *header = (CX_AST_File_Header*) image;
+	size_t n = header->node_count;
+
+	*ast = (CX_AST) {
+		.kinds = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_KINDS), n, n },
+		.token_types = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_TYPES), n, n },
+		.token_offsets = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_OFFSETS), n, n },
+		.token_values = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_TOKEN_VALUES), n, n },
+		.children_first = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN_FIRST), n, n },
+		.children_count = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN_COUNT), n, n },
+		.children = { CX_AST_FILE_SECTION(header, image, CX_AST_FILE_CHILDREN), header->children_len, header->children_len },
+		.file = file,
+		.root = header->root,
+		._mapped = true
+	};
+
+	u32 *symbols = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_SYMBOLS);
+	char *strings = CX_AST_FILE_SECTION(header, image, CX_AST_FILE_STRINGS);
+	for(size_t i = 0; i < header->symbol_count; ++i) {
+		StringView name = { .data = strings + symbols[2 * i], .size = symbols[2 * i + 1] };
+		if(Symbol_intern(name) != header->seed_symbol_count + i) {
+			error("%s: invalid AST file: symbol '" PRIsv "' listed twice\n", source->path, PRIsv_arg(name));
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CX_AST_write(CX_AST *ast, FILE *sink) {
+	SourceFile *source = &source_files.data[ast->file];
+	size_t seed_symbol_count = seed_symbols._from.len;
+
+	DARRAY(u32) symbol_table;
+	DARRAY(char) strings;
+	DARRAY_INIT(u32)(&symbol_table, 2 * (symbols._from.len - seed_symbol_count) + 1);
+	DARRAY_INIT(char)(&strings, 1024);
+	for(Symbol symbol = seed_symbol_count; symbol < symbols._from.len; ++symbol) {
+		StringView name = Symbol_sv(symbol);
+		DARRAY_PUSH(u32)(&symbol_table, strings.len);
+		DARRAY_PUSH(u32)(&symbol_table, name.size);
+		sb_append_sv(&strings, name);
+	}
+
+	CX_AST_File_Header header = {
+		.version = CX_AST_FILE_VERSION,
+		.root = ast->root,
+		.build = CX_AST_File_build(),
+		.node_count = ast->kinds.len,
+		.children_len = ast->children.len,
+		.seed_symbol_count = seed_symbol_count,
+		.symbol_count = symbols._from.len - seed_symbol_count,
+	};
+	memcpy(header.magic, CX_AST_FILE_MAGIC, 8);
+
+	void *sections[CX_AST_FILE_SECTION_COUNT] = {
+		[CX_AST_FILE_KINDS] = ast->kinds.data,
+		[CX_AST_FILE_TOKEN_TYPES] = ast->token_types.data,
+		[CX_AST_FILE_TOKEN_OFFSETS] = ast->token_offsets.data,
+		[CX_AST_FILE_TOKEN_VALUES] = ast->token_values.data,
+		[CX_AST_FILE_CHILDREN_FIRST] = ast->children_first.data,
+		[CX_AST_FILE_CHILDREN_COUNT] = ast->children_count.data,
+		[CX_AST_FILE_CHILDREN] = ast->children.data,
+		[CX_AST_FILE_SYMBOLS] = symbol_table.data,
+		[CX_AST_FILE_STRINGS] = strings.data,
+		[CX_AST_FILE_SOURCE] = source->data,
+	};
+	u64 sizes[CX_AST_FILE_SECTION_COUNT] = {
+		[CX_AST_FILE_KINDS] = ast->kinds.len,
+		[CX_AST_FILE_TOKEN_TYPES] = ast->token_types.len,
+		[CX_AST_FILE_TOKEN_OFFSETS] = ast->token_offsets.len * sizeof(u32),
+		[CX_AST_FILE_TOKEN_VALUES] = ast->token_values.len * sizeof(u32),
+		[CX_AST_FILE_CHILDREN_FIRST] = ast->children_first.len * sizeof(u32),
+		[CX_AST_FILE_CHILDREN_COUNT] = ast->children_count.len * sizeof(u32),
+		[CX_AST_FILE_CHILDREN] = ast->children.len * sizeof(u32),
+		[CX_AST_FILE_SYMBOLS] = symbol_table.len * sizeof(u32),
+		[CX_AST_FILE_STRINGS] = strings.len,
+		[CX_AST_FILE_SOURCE] = source->len,
+	};
+
+	u64 offset = sizeof(header);
+	for(size_t i = 0; i < CX_AST_FILE_SECTION_COUNT; ++i) {
+		offset = (offset + 7) & ~(u64) 7;
+		header.sections[i][0] = offset;
+		header.sections[i][1] = sizes[i];
+		offset += sizes[i];
+	}
+
+	static const char padding[8] = { 0 };
+	fwrite(&header, sizeof(header), 1, sink);
+	offset = sizeof(header);
+	for(size_t i = 0; i < CX_AST_FILE_SECTION_COUNT; ++i) {
+		fwrite(padding, 1, header.sections[i][0] - offset, sink);
+		fwrite(sections[i], 1, sizes[i], sink);
+		offset = header.sections[i][0] + sizes[i];
+	}
+
+	DARRAY_FREE(u32)(&symbol_table);
+	DARRAY_FREE(char)(&strings);
+	return fflush(sink) == 0 && !ferror(sink);
+}
+
+// Results kept in memory
+
+// A --server keeps the C generated for every file between requests, under the same keys as the
+// cache directory, so a file it compiled before is only hashed and written out again. Worker
+// threads fetch and store results while a request runs, they are only evicted in between: the
+// least recently fetched first, until the rest fit in --cache-max-size.
+
+bool keep_results = false;
+HashMap results; // key in hex -> generated C, both in one allocation starting with the key
+DARRAY(u64) results_used; // by entry of results, the request which last stored or fetched it
+u64 results_request = 0; // requests served so far
+size_t results_size = 0;
+Mutex results_lock;
+
+void Results_init(void) {
+	HashMap_init(&results);
+	DARRAY_INIT(u64)(&results_used, 16);
+	Mutex_init(&results_lock);
+	keep_results = true;
+}
+
+void Results_free(void) {
+	for(size_t i = 0; i < results._from.len; ++i) free(results._from.data[i].data);
+	HashMap_free(&results);
+	DARRAY_FREE(u64)(&results_used);
+	results_size = 0;
+}
+
+// Starts an entry for Results_store with the key it goes under, the C is appended after it
+void Results_entry_init(DARRAY(char) *entry, u64 key) {
+	DARRAY_INIT(char)(entry, SOURCE_READ_CHUNK_SIZE);
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long) key);
+	sb_append(entry, name, 16);
+}
+
+// Writes the result for `key` to `output_filename`, returns whether there was one
+bool Results_fetch(u64 key, char *output_filename) {
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long) key);
+	StringView from = { .data = name, .size = 16 };
+
+	Mutex_lock(&results_lock);
+	HashMap_Slot *slot = HashMap_find_slot(&results, &from, sv_hash(from));
+	StringView output = { 0 };
+	if(slot->index) {
+		output = results._to.data[slot->index - 1];
+		results_used.data[slot->index - 1] = results_request;
+	}
+	Mutex_unlock(&results_lock);
+
+	return output.data && write_file(output_filename, output);
+}
+
+// Takes over `entry`, see Results_entry_init, and leaves it empty
+void Results_store(DARRAY(char) *entry) {
+	StringView from = { .data = entry->data, .size = 16 };
+	StringView to = { .data = entry->data + 16, .size = entry->len - 16 };
+	u32 hash = sv_hash(from);
+
+	Mutex_lock(&results_lock);
+	HashMap_Slot *slot = HashMap_find_slot(&results, &from, hash);
+	if(!slot->index) {
+		HashMap_insert(&results, slot, hash, from, to);
+		DARRAY_PUSH(u64)(&results_used, results_request);
+		results_size += entry->len;
+		*entry = (DARRAY(char)) { 0 };
+	}
+	Mutex_unlock(&results_lock);
+
+	DARRAY_FREE(char)(entry); // the same file twice in one request
+}
+
+typedef struct {
+	u64 used;
+	size_t index;
+} Results_Use;
+
+int Results_Use_compare(const void *a, const void *b) {
+	u64 x = ((Results_Use*) a)->used, y = ((Results_Use*) b)->used;
+	return (x > y) - (x < y);
+}
+
+// Between requests, drops the least recently fetched results until the rest fit in cache_max_size
+void Results_evict(void) {
+	++results_request;
+	if(results_size <= cache_max_size) return;
+
+	size_t count = results._from.len;
+	Results_Use *uses = malloc(count * sizeof(Results_Use));
+	for(size_t i = 0; i < count; ++i) uses[i] = (Results_Use) { .used = results_used.data[i], .index = i };
+	qsort(uses, count, sizeof(Results_Use), Results_Use_compare);
+	for(size_t i = 0; i < count && results_size > cache_max_size; ++i) {
+		StringView *from = &results._from.data[uses[i].index];
+		results_size -= from->size + results._to.data[uses[i].index].size;
+		free(from->data);
+		from->data = NULL;
+	}
+	free(uses);
+
+	// HashMap has no removal, the results kept go into a new one
+	HashMap kept;
+	DARRAY(u64) kept_used;
+	HashMap_init(&kept);
+	DARRAY_INIT(u64)(&kept_used, 16);
+	for(size_t i = 0; i < count; ++i) {
+		StringView from = results._from.data[i];
+		if(!from.data) continue;
+		u32 hash = sv_hash(from);
+		HashMap_insert(&kept, HashMap_find_slot(&kept, &from, hash), hash, from, results._to.data[i]);
+		DARRAY_PUSH(u64)(&kept_used, results_used.data[i]);
+	}
+	HashMap_free(&results);
+	DARRAY_FREE(u64)(&results_used);
+	results = kept;
+	results_used = kept_used;
+}
+
+// Pass timing
+
+// With --time-passes or --trace, every pass of a unit, and those of the command around them,
+// record when they started and how much wall and CPU time they took. A pass runs at most once per
+// unit, so its times are kept in the unit and cost four clock reads.
+// Lexing is not a pass of its own: tokens are lexed as the parser asks for them, see bench/lexer.
+
+typedef enum {
+	PASS_OPEN_FILES,
+	PASS_CHECK_AST,
+	PASS_CACHE_LOOKUP,
+	PASS_MAP_AST,
+	PASS_PARSE,
+	PASS_DUMP_AST,
+	PASS_WRITE_AST,
+	PASS_SEMANTICS,
+	PASS_CONSTANTS,
+	PASS_GENERICS,
+	PASS_ARRAYS,
+	PASS_CODEGEN,
+	PASS_CACHE_STORE,
+	PASS_UNITS,
+	PASS_CACHE_EVICTION,
+	PASS_COUNT,
+} Pass;
+
+_Static_assert(PASS_COUNT <= 32, "Pass_Times::ran has a bit per pass");
+
+const char *pass_names[PASS_COUNT] = {
+	[PASS_OPEN_FILES] = "opening files",
+	[PASS_CHECK_AST] = "checking AST files",
+	[PASS_CACHE_LOOKUP] = "cache lookup",
+	[PASS_MAP_AST] = "mapping AST files",
+	[PASS_PARSE] = "lexing and parsing",
+	[PASS_DUMP_AST] = "dumping the AST",
+	[PASS_WRITE_AST] = "writing AST files",
+	[PASS_SEMANTICS] = "semantic analysis",
+	[PASS_CONSTANTS] = "constant evaluation",
+	[PASS_GENERICS] = "instantiating generics",
+	[PASS_ARRAYS] = "resolving arrays",
+	[PASS_CODEGEN] = "code generation",
+	[PASS_CACHE_STORE] = "cache store",
+	[PASS_UNITS] = "compiling files",
+	[PASS_CACHE_EVICTION] = "cache eviction",
+};
+
+bool time_passes = false;
+char *trace_filename = NULL;
+u64 timing_origin; // wall clock when the command started, times are relative to it
+
+typedef struct {
+	u64 start[PASS_COUNT]; // wall clock since timing_origin, in nanoseconds
+	u64 wall[PASS_COUNT];
+	u64 cpu[PASS_COUNT];
+	u32 ran; // a bit per pass
+	bool whole_process; // CPU time of all threads, for the passes around the units
+} Pass_Times;
+
+u64 Pass_Times_cpu(Pass_Times *times) {
+	return times->whole_process ? clock_process_cpu_ns() : clock_thread_cpu_ns();
+}
+
+void Pass_begin(Pass_Times *times, Pass pass) {
+	if(!time_passes && !trace_filename) return;
+	times->start[pass] = clock_wall_ns() - timing_origin;
+	times->cpu[pass] = Pass_Times_cpu(times);
+}
+
+void Pass_end(Pass_Times *times, Pass pass) {
+	if(!time_passes && !trace_filename) return;
+	times->wall[pass] = clock_wall_ns() - timing_origin - times->start[pass];
+	times->cpu[pass] = Pass_Times_cpu(times) - times->cpu[pass];
+	times->ran |= 1u << pass;
+}
+
+void fprint_json_string(FILE *sink, const char *string) {
+	putc('"', sink);
+	for(const char *c = string; *c; ++c) {
+		if(*c == '"' || *c == '\\') fprintf(sink, "\\%c", *c);
+		else if((unsigned char) *c < 0x20) fprintf(sink, "\\u%04x", *c);
+		else putc(*c, sink);
+	}
+	putc('"', sink);
+}
+
+// Chrome trace events (chrome://tracing, Perfetto) of the passes that ran, in microseconds
+void Pass_Times_trace(Pass_Times *times, u16 thread, char *filename, FILE *sink) {
+	for(size_t pass = 0; pass < PASS_COUNT; ++pass) {
+		if(!(times->ran & (1u << pass))) continue;
+		fprintf(sink, ",\n{\"name\":\"%s\",\"cat\":\"cx\",\"ph\":\"X\",\"pid\":1,\"tid\":%u", pass_names[pass], thread);
+		fprintf(sink, ",\"ts\":%.3f,\"dur\":%.3f,\"args\":{", times->start[pass] / 1e3, times->wall[pass] / 1e3);
+		if(filename) {
+			fprintf(sink, "\"file\":");
+			fprint_json_string(sink, filename);
+			putc(',', sink);
+		}
+		fprintf(sink, "\"cpu_us\":%.3f}}", times->cpu[pass] / 1e3);
+	}
+}
+
+// Compilation units
 
-	Token cp = Parser_next_token(parser);
-	if(cp.type != TOKEN_CLOSE_PARENTHESIS) goto Parser_next_function_decl_cleanup;
+// Every input file is compiled on its own, by whichever worker thread picks it up. A unit owns
+// its tokens, syntax tree and interned symbols. The source files, the seed symbols and
+// data_type_translations are set up before any unit starts and only read while they run.
+// A unit that panics is given up on its own, Unit_release frees what it held.
 
-	if(!Parser_next_compound_stmt(parser, out, out->u_function_decl.body)) goto Parser_next_function_decl_cleanup;
+typedef struct {
+	char *source_filename;
+	char *output_filename;
+	u16 file;
+	bool ok;
+	bool cache_hit;
+	u64 cache_key;
+
+	// held while compiling, outside Unit_compile's frame so they can be freed after a panic
+	TokenStream tokens;
+	CX_AST ast;
+	Parser parser;
+	Constants constants;
+	Generics generics;
+	Arrays arrays;
+	FILE *output_fp;
+	DARRAY(char) result; // for Results_store, filled by cache_fetch or code generation
+
+	// for --stats, --time-passes and --trace
+	size_t token_count, peak_tokens, token_bytes;
+	size_t ast_nodes, ast_bytes, walk_depth;
+	size_t constants_folded, elements_computed;
+	size_t instantiations, array_types;
+	size_t allocations, bytes_emitted;
+	Pass_Times passes;
+	u16 thread; // which worker compiled the unit, 0 is the thread that started them
+} Unit;
+
+FORWARD_DECLARE_DARRAY(Unit)
+DECLARE_DARRAY(Unit)
+
+void Unit_release(Unit *unit) {
+	Parser_free(&unit->parser);
+	if(unit->output_fp) fclose(unit->output_fp);
+	unit->output_fp = NULL;
+	Constants_free(&unit->constants);
+	Generics_free(&unit->generics);
+	Arrays_free(&unit->arrays);
+	CX_AST_free(&unit->ast);
+	TokenStream_free(&unit->tokens);
+	DARRAY_FREE(char)(&unit->result);
+	Symbols_free();
+}
 
-	out->type = CX_AST_NODE_TYPE_FUNCTION_DECL;
-	return true;
+void Unit_compile(Unit *unit) {
+	SourceFile *source = &source_files.data[unit->file];
+	if(CX_AST_File_is(source)) {
+		Pass_begin(&unit->passes, PASS_CHECK_AST);
+		bool valid = CX_AST_File_open(source);
+		Pass_end(&unit->passes, PASS_CHECK_AST);
+		if(!valid) {
+			unit->ok = false;
+			return;
+		}
+	}
 
-Parser_next_function_decl_cleanup:
-	parser->cur = saved_cur;
-	CX_AST_Node_free(*out);
-	return false;
-}
+	bool use_cache = (cache_dir || keep_results) && !dump_ast && !emit_ast; // which need the tree
+	if(use_cache) {
+		Pass_begin(&unit->passes, PASS_CACHE_LOOKUP);
+		unit->cache_key = cache_key(source);
+		bool hit = keep_results && Results_fetch(unit->cache_key, unit->output_filename);
+		if(!hit && keep_results) Results_entry_init(&unit->result, unit->cache_key);
+		if(!hit && cache_dir && cache_fetch(unit->cache_key, unit->output_filename, keep_results ? &unit->result : NULL)) {
+			hit = true;
+			if(keep_results) Results_store(&unit->result);
+		}
+		Pass_end(&unit->passes, PASS_CACHE_LOOKUP);
+		if(hit) {
+			unit->ok = unit->cache_hit = true;
+			return;
+		}
+	}
 
-// end Parser_next declarations
+	size_t errors_before = error_count;
+	CX_AST_walk_peak_depth = 0;
+	Symbols_init_from_seed();
 
-void Parser_next_root_child(Parser *parser, CX_AST_Node *parent, CX_AST_Node *out) {
-	CX_AST_Node zero = { 0 };
-	*out = zero;
+	TokenStream *tokens = &unit->tokens;
+	CX_AST *ast = &unit->ast;
 
-	if(Parser_next_function_decl(parser, parent, out)) return;
+	if(source->ast) {
+		DEBUG_TRACE("Mapping the syntax tree\n");
 
-	*out = zero;
-}
+		Pass_begin(&unit->passes, PASS_MAP_AST);
+		unit->ok = CX_AST_map(ast, unit->file);
+		Pass_end(&unit->passes, PASS_MAP_AST);
+		if(!unit->ok) goto Unit_compile_cleanup;
+	} else {
+		DEBUG_TRACE("Lexical analysis and parsing\n");
 
-// end Parser_nexts
+		Pass_begin(&unit->passes, PASS_PARSE);
+		Lexer lexer = {
+			.file = unit->file,
+			.source = source->data,
+			.source_len = source->len,
+			.eof = false
+		};
 
-// Semantic analysis
+		TokenStream_init(tokens, lexer);
+		CX_AST_init(ast, unit->file, lexer.source_len / 8 + 16);
 
-typedef struct {
-	HashMap *data_type_translations;
-} SemanticStructure;
+		Parser *parser = &unit->parser;
+		Parser_init(parser, tokens, ast);
 
-void analyse_semantics(CX_AST_Node *ast, SemanticStructure *semantic_structure) {
-	if(ast) switch(ast->type) {
-		case CX_AST_NODE_TYPE_NULL:
-			assert(false && "unreachable");
-			break;
-		case CX_AST_NODE_TYPE_ROOT:
-			for(size_t i = 0; i < ast->u_root.len; ++i)
-				analyse_semantics(&ast->u_root.data[i], semantic_structure);
-			break;
-		case CX_AST_NODE_TYPE_TYPE_ID:
-			{
-				StringView *type_translation = HashMap_at(semantic_structure->data_type_translations, ast->u_type_id.value.value_sv);
-				if(!type_translation)
-					loc_error(ast->u_type_id.value.location, " unknown data type: " PRIsv "\n", PRIsv_arg(ast->u_type_id.value.value_sv));
-				ast->u_type_id.value.value_sv = *type_translation;
+		while(!parser->eof && Parser_peek_token(parser).type != TOKEN_EOF) {
+			CX_AST_Index child = Parser_next_root_child(parser);
+			if(child) {
+				DARRAY_PUSH(u32)(&parser->pending_children, child);
+			} else {
+				if(parser->ok_so_far) Parser_error_expected(parser, "a declaration");
+				break;
 			}
-			break;
-		case CX_AST_NODE_TYPE_NAME_ID:
-			// TODO: check validness and redeclaration
-			break;
-		case CX_AST_NODE_TYPE_NUMBER_LIT:
-			// TODO
-			break;
-		case CX_AST_NODE_TYPE_STRING_LIT:
-			// TODO
-			break;
-		case CX_AST_NODE_TYPE_RETURN_STMT:
-			// TODO
-			break;
-		case CX_AST_NODE_TYPE_COMPOUND_STMT:
-			for(size_t i = 0; i < ast->u_compound_stmt.len; ++i)
-				analyse_semantics(&ast->u_compound_stmt.data[i], semantic_structure);
-			break;
-		case CX_AST_NODE_TYPE_FUNCTION_DECL:
-			analyse_semantics(ast->u_function_decl.data_type, semantic_structure);
-			analyse_semantics(ast->u_function_decl.name, semantic_structure);
-			analyse_semantics(ast->u_function_decl.body, semantic_structure);
-			break;
+		};
+
+		ast->root = CX_AST_push_node(ast, CX_AST_NODE_TYPE_ROOT, (Token) { 0 }, parser->pending_children.data, parser->pending_children.len);
+		Parser_free(parser);
+		Pass_end(&unit->passes, PASS_PARSE);
+
+		unit->ok = parser->ok_so_far;
+		if(!unit->ok) {
+			info("Parsing failed, skipping next steps\n");
+			goto Unit_compile_cleanup;
+		}
 	}
-}
 
-// Code generation
+	if(dump_ast) {
+		Pass_begin(&unit->passes, PASS_DUMP_AST);
+		lock_stream(stdout);
+		CX_AST_print_json(ast, ast->root, stdout);
+		putc('\n', stdout);
+		unlock_stream(stdout);
+		Pass_end(&unit->passes, PASS_DUMP_AST);
+	}
 
-typedef struct {
-	HashMap *data_type_translations;
-} CodeGenerator;
+	if(emit_ast) {
+		DEBUG_TRACE("Writing the syntax tree\n");
 
-void __IMPL__generate_code(CodeGenerator *code_gen, CX_AST_Node *ast, FILE *sink, int indent_len) {
-	const char indent = '\t';
+		Pass_begin(&unit->passes, PASS_WRITE_AST);
+		unit->output_fp = fopen(unit->output_filename, "wb");
+		if(!unit->output_fp || !CX_AST_write(ast, unit->output_fp)) {
+			error("writing to file '%s' failed: %s\n", unit->output_filename, strerror(errno));
+			unit->ok = false;
+		} else {
+			unit->bytes_emitted = ftell(unit->output_fp);
+		}
+		Pass_end(&unit->passes, PASS_WRITE_AST);
+		goto Unit_compile_cleanup;
+	}
 
-	if(ast) switch(ast->type) {
-		case CX_AST_NODE_TYPE_NULL:
-			assert(false && "unreachable");
-			break;
-		case CX_AST_NODE_TYPE_ROOT:
-			for(size_t i = 0; i < ast->u_root.len; ++i) {
-				__IMPL__generate_code(code_gen, &ast->u_root.data[i], sink, indent_len);
-				fprintf(sink, "\n");
-			}
-			break;
-		case CX_AST_NODE_TYPE_TYPE_ID:
-			fprintf(sink, PRIsv, PRIsv_arg(ast->u_type_id.value.value_sv));
-			break;
-		case CX_AST_NODE_TYPE_NAME_ID:
-			fprintf(sink, PRIsv, PRIsv_arg(ast->u_name_id.value.value_sv));
-			break;
-		case CX_AST_NODE_TYPE_NUMBER_LIT:
-			fprintf(sink, "%d", ast->u_number_lit.value.value_int);
-			break;
-		case CX_AST_NODE_TYPE_STRING_LIT:
-			fprintf(sink, "\"" PRIsv "\"", PRIsv_arg(ast->u_string_lit.value.value_sv));
-			break;
-		case CX_AST_NODE_TYPE_RETURN_STMT:
-			if(indent_len) fprintf(sink, "%*c", indent_len, indent);
-			fprintf(sink, "return ");
-			__IMPL__generate_code(code_gen, ast->u_return_stmt.expr, sink, indent_len);
-			fprintf(sink, ";\n");
-			break;
-		case CX_AST_NODE_TYPE_COMPOUND_STMT:
-			if(indent_len) fprintf(sink, "%*c", indent_len, indent);
-			fprintf(sink, "{\n");
-			for(size_t i = 0; i < ast->u_compound_stmt.len; ++i) {
-				__IMPL__generate_code(code_gen, &ast->u_compound_stmt.data[i], sink, indent_len + 1);
-			}
-			if(indent_len) fprintf(sink, "%*c", indent_len, indent);
-			fprintf(sink, "}\n");
-			break;
-		case CX_AST_NODE_TYPE_FUNCTION_DECL:
-			if(indent_len) fprintf(sink, "%*c", indent_len, indent);
-			fprintf(sink, PRIsv " " PRIsv "()\n", PRIsv_arg(ast->u_function_decl.data_type->u_type_id.value.value_sv), PRIsv_arg(ast->u_function_decl.name->u_name_id.value.value_sv));
-			__IMPL__generate_code(code_gen, ast->u_function_decl.body, sink, indent_len);
-			break;
+	{
+		DEBUG_TRACE("Semantic analysis\n");
+
+		SemanticStructure semantic_structure = {
+			.data_type_translations = &data_type_translations
+		};
+
+		Pass_begin(&unit->passes, PASS_SEMANTICS);
+		unit->ok = analyse_semantics(ast, &semantic_structure);
+		Pass_end(&unit->passes, PASS_SEMANTICS);
+
+		if(!unit->ok) {
+			info("Semantic analysis failed, skipping next steps\n");
+			goto Unit_compile_cleanup;
+		}
 	}
-}
 
-void generate_code(CodeGenerator *code_gen, CX_AST_Node *ast, FILE *sink) {
-	__IMPL__generate_code(code_gen, ast, sink, 0);
-}
+	{
+		DEBUG_TRACE("Constant evaluation\n");
 
-//
+		Pass_begin(&unit->passes, PASS_CONSTANTS);
+		unit->ok = evaluate_constants(ast, &unit->constants);
+		unit->constants_folded = unit->constants.folded;
+		unit->elements_computed = unit->constants.computed;
+		Pass_end(&unit->passes, PASS_CONSTANTS);
 
-bool streq(char *a, char *b) {
-	return strcmp(a, b) == 0;
+		if(!unit->ok) {
+			info("Constant evaluation failed, skipping next steps\n");
+			goto Unit_compile_cleanup;
+		}
+	}
+
+	{
+		DEBUG_TRACE("Instantiating generics\n");
+
+		Pass_begin(&unit->passes, PASS_GENERICS);
+		unit->ok = instantiate_generics(ast, &unit->generics);
+		unit->instantiations = unit->generics.order.len;
+		Pass_end(&unit->passes, PASS_GENERICS);
+
+		if(!unit->ok) {
+			info("Generic instantiation failed, skipping next steps\n");
+			goto Unit_compile_cleanup;
+		}
+	}
+
+	{
+		DEBUG_TRACE("Resolving arrays\n");
+
+		Pass_begin(&unit->passes, PASS_ARRAYS);
+		unit->ok = resolve_arrays(ast, &unit->generics, &unit->arrays);
+		unit->array_types = unit->arrays.types.len;
+		Pass_end(&unit->passes, PASS_ARRAYS);
+
+		if(!unit->ok) {
+			info("Array resolution failed, skipping next steps\n");
+			goto Unit_compile_cleanup;
+		}
+	}
+
+	{
+		DEBUG_TRACE("Code generation\n");
+
+		CodeGenerator code_gen = {
+			.data_type_translations = &data_type_translations,
+			.constants = &unit->constants,
+			.generics = &unit->generics,
+			.arrays = &unit->arrays,
+			.copy = unit->result.data ? &unit->result : NULL
+		};
+
+		Pass_begin(&unit->passes, PASS_CODEGEN);
+		unit->output_fp = fopen(unit->output_filename, "w");
+
+		if(!unit->output_fp) {
+			error("writing to file '%s' failed: %s\n", unit->output_filename, strerror(errno));
+			unit->ok = false;
+			goto Unit_compile_cleanup;
+		}
+
+		if(!generate_code(&code_gen, ast, unit->output_fp)) {
+			error("writing to file '%s' failed: %s\n", unit->output_filename, strerror(errno));
+			unit->ok = false;
+		}
+		unit->bytes_emitted = code_gen.bytes_emitted;
+		if(fclose(unit->output_fp)) unit->ok = false;
+		unit->output_fp = NULL;
+		Pass_end(&unit->passes, PASS_CODEGEN);
+	}
+
+Unit_compile_cleanup:
+
+	if(unit->output_fp && fclose(unit->output_fp)) unit->ok = false;
+	unit->output_fp = NULL;
+	if(use_cache && unit->ok && error_count == errors_before) {
+		Pass_begin(&unit->passes, PASS_CACHE_STORE);
+		if(cache_dir) cache_store(unit->cache_key, unit->output_filename);
+		if(keep_results) Results_store(&unit->result);
+		Pass_end(&unit->passes, PASS_CACHE_STORE);
+	}
+
+	unit->token_count = tokens->end;
+	unit->peak_tokens = tokens->peak;
+	unit->token_bytes = tokens->capacity * (sizeof(u8) + 2 * sizeof(u32));
+	unit->ast_nodes = ast->kinds.len;
+	unit->ast_bytes = CX_AST_size_in_bytes(ast);
+	unit->walk_depth = CX_AST_walk_peak_depth;
+
+	Unit_release(unit);
 }
 
-void usage(char *program_name, FILE *sink) {
-	fprintf(sink, "Usage: %s [options] <file.cx>\n", program_name);
-	fprintf(sink, "Options:\n");
-	fprintf(sink, "    -o <file.c>   Place the output into <file.c>\n");
-	fprintf(sink, "    -h, --help    Print this message\n");
-	fprintf(sink, "    --dump-ast    Display the program's syntax tree to stderr\n");
+DARRAY(Unit) units;
+atomic_size_t next_unit = 0;
+_Thread_local u16 worker_index = 0;
+
+// A panic gives up on the unit only, the other units keep compiling
+void Unit_try_compile(Unit *unit) {
+	unit->thread = worker_index;
+	size_t allocations_before = darray_allocations;
+	jmp_buf handler, *outer = panic_handler;
+	panic_handler = &handler;
+	if(setjmp(handler)) {
+		unit->ok = false;
+		Unit_release(unit);
+	} else {
+		Unit_compile(unit);
+	}
+	panic_handler = outer;
+	unit->allocations = darray_allocations - allocations_before;
+}
+
+#ifdef _WIN32
+DWORD WINAPI Units_worker(LPVOID arg) {
+#else
+void *Units_worker(void *arg) {
+#endif
+	worker_index = (size_t) arg;
+	for(;;) {
+		size_t i = atomic_fetch_add(&next_unit, 1);
+		if(i >= units.len) break;
+		Unit_try_compile(&units.data[i]);
+	}
+	return 0;
 }
 
-void alloc_file_content(DARRAY(char) *array, char *filename, const char *mode) {
-	FILE *fp = fopen(filename, mode);
+// Compiles all units on `jobs` threads, the calling one included
+void Units_compile(size_t jobs) {
+	Thread *threads = malloc(jobs * sizeof(Thread));
+	size_t started = 0;
+	for(; started + 1 < jobs; ++started)
+		if(!Thread_start(&threads[started], Units_worker, (void*) (started + 1))) break;
+
+	Units_worker(NULL);
+
+	for(size_t i = 0; i < started; ++i) Thread_join(threads[i]);
+	free(threads);
+}
 
-	if(fp) {
-		fseek(fp, 0, SEEK_END);
-		DARRAY_INIT(char)(array, ftell(fp) + 2);
-		fseek(fp, 0, SEEK_SET);
-		array->len = fread(array->data, 1, array->_allocated, fp);
-		if(errno) {
-			DARRAY_FREE(char)(array);
-			fclose(fp);
-			panic("error reading file %s: %s\n", filename, strerror(errno));
+// --time-passes, the passes of the units are summed over all of them
+void Units_report_passes(Pass_Times *command, u64 wall, u64 cpu) {
+	Pass_Times total = *command;
+	for(size_t i = 0; i < units.len; ++i) {
+		Pass_Times *passes = &units.data[i].passes;
+		for(size_t pass = 0; pass < PASS_COUNT; ++pass) {
+			total.wall[pass] += passes->wall[pass];
+			total.cpu[pass] += passes->cpu[pass];
 		}
-		array->data[array->len] = '\n';
-		array->data[array->len + 1] = 0;
-	} else {
-		panic("could not open file: %s\n", filename);
+		total.ran |= passes->ran;
 	}
 
-	fclose(fp);
+	if(units.len > 1) info("times of the passes of each file are summed over all %zu files\n", units.len);
+	info("%-24s %12s %12s\n", "pass", "wall (ms)", "cpu (ms)");
+	for(size_t pass = 0; pass < PASS_COUNT; ++pass) {
+		if(!(total.ran & (1u << pass))) continue;
+		info("  %-22s %12.3f %12.3f\n", pass_names[pass], total.wall[pass] / 1e6, total.cpu[pass] / 1e6);
+	}
+	info("  %-22s %12.3f %12.3f\n", "total", wall / 1e6, cpu / 1e6);
 }
 
-char *program_name = NULL;
-char *source_filename = NULL;
-char *output_filename = NULL;
-bool dump_ast = false;
+bool Units_write_trace(char *filename, Pass_Times *command, size_t jobs) {
+	FILE *fp = fopen(filename, "w");
+	if(!fp) return false;
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"cx\"}}");
+	for(size_t thread = 0; thread < jobs; ++thread)
+		fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"worker %zu\"}}", thread, thread);
+	Pass_Times_trace(command, 0, NULL, fp);
+	for(size_t i = 0; i < units.len; ++i)
+		Pass_Times_trace(&units.data[i].passes, units.data[i].thread, units.data[i].source_filename, fp);
+	fprintf(fp, "\n]}\n");
+
+	bool ok = fflush(fp) == 0 && !ferror(fp);
+	if(fclose(fp)) ok = false;
+	return ok;
+}
 
-DARRAY(char) source_code;
-DARRAY(Token) tokens;
-CX_AST_Node root;
-HashMap data_type_translations;
-FILE *output_fp = NULL;
+void Units_free(void) {
+	for(size_t i = 0; i < units.len; ++i) free(units.data[i].output_filename);
+	DARRAY_FREE(Unit)(&units);
+	SourceFiles_close();
+}
 
-int main(int argc, char **argv) {
-	program_name = consume_arg(&argc, &argv);
+// dir/name.cx and dir/name.cxast become dir/name`extension`, any other name gets it appended
+char *default_output_filename(char *source_filename, char *extension) {
+	size_t len = strlen(source_filename);
+	if(len > 3 && streq(source_filename + len - 3, ".cx")) len -= 3;
+	else if(len > 6 && streq(source_filename + len - 6, ".cxast")) len -= 6;
+	size_t extension_len = strlen(extension);
+	char *output_filename = malloc(len + extension_len + 1);
+	memcpy(output_filename, source_filename, len);
+	memcpy(output_filename + len, extension, extension_len + 1);
+	return output_filename;
+}
+
+// The command line
+
+// Compiles what a command line asks for and returns the exit status. A --server runs this for
+// every request, so options start from their defaults and it frees everything it opened.
+int compile_command_line(char *program_name, int argc, char **argv) {
+	char *output_filename = NULL;
+	bool print_stats = false;
+	size_t jobs = 1;
+	int status = 1;
+	dump_ast = false;
+	emit_ast = false;
+	time_passes = false;
+	trace_filename = NULL;
+	timing_origin = clock_wall_ns();
+	u64 cpu_origin = clock_process_cpu_ns(); // a --server has used some before
+	Pass_Times command_passes = { .whole_process = true };
+	cache_dir = NULL;
+	cache_max_size = CACHE_DEFAULT_MAX_SIZE;
+	next_unit = 0;
+	size_t allocations_before = darray_allocations; // a --server's main thread keeps counting
+	DARRAY_INIT(Unit)(&units, 16);
 
 	while (argc) {
 		char *flag = consume_arg(&argc, &argv);
 		if (streq(flag, "-h") || streq(flag, "--help")) {
 			usage(program_name, stderr);
-			exit(0);
+			status = 0;
+			goto compile_command_line_cleanup;
 		} else if (streq(flag, "-o")) {
 			if(argc) {
 				char *flag_2 = consume_arg(&argc, &argv);
 				if(output_filename) {
 					error("output filename already supplied before '%s'\n", output_filename);
 					usage(program_name, stderr);
-					exit(1);
+					goto compile_command_line_cleanup;
 				} else {
 					output_filename = flag_2;
 				}
 			} else {
 				error("missing output filename after '%s'\n", flag);
 				usage(program_name, stderr);
-				exit(1);
+				goto compile_command_line_cleanup;
+			}
+		} else if (streq(flag, "-j")) {
+			int n = argc ? atoi(consume_arg(&argc, &argv)) : 0;
+			if(n < 1) {
+				error("expected a positive number of jobs after '%s'\n", flag);
+				usage(program_name, stderr);
+				goto compile_command_line_cleanup;
 			}
+			jobs = n;
 		} else if (streq(flag, "--dump-ast")) {
 			dump_ast = true;
-		} else {
-			if(source_filename) {
-				error("At the moment CX does not support compiling multiple files at once\n");
+		} else if (streq(flag, "--emit-ast")) {
+			emit_ast = true;
+		} else if (streq(flag, "--stats")) {
+			print_stats = true;
+		} else if (streq(flag, "--time-passes")) {
+			time_passes = true;
+		} else if (streq(flag, "--trace")) {
+			if(!argc) {
+				error("missing trace filename after '%s'\n", flag);
 				usage(program_name, stderr);
-				exit(1);
-			} else {
-				source_filename = flag;
+				goto compile_command_line_cleanup;
+			}
+			trace_filename = consume_arg(&argc, &argv);
+		} else if (streq(flag, "--cache-dir")) {
+			if(!argc) {
+				error("missing cache directory after '%s'\n", flag);
+				usage(program_name, stderr);
+				goto compile_command_line_cleanup;
+			}
+			cache_dir = consume_arg(&argc, &argv);
+		} else if (streq(flag, "--cache-max-size")) {
+			long long n = argc ? atoll(consume_arg(&argc, &argv)) : 0;
+			if(n < 1) {
+				error("expected a positive number of megabytes after '%s'\n", flag);
+				usage(program_name, stderr);
+				goto compile_command_line_cleanup;
 			}
+			cache_max_size = (size_t) n * 1024 * 1024;
+		} else {
+			DARRAY_PUSH(Unit)(&units, (Unit) { .source_filename = flag });
 		}
 	}
 
-	if(!source_filename) {
+	if(!units.len) {
 		error("no input file provided\n");
 		usage(program_name, stderr);
-		exit(1);
+		goto compile_command_line_cleanup;
+	}
+
+	if(output_filename && units.len > 1) {
+		error("-o can only be used with a single input file\n");
+		usage(program_name, stderr);
+		goto compile_command_line_cleanup;
 	}
 
-	if(!output_filename) {
+	if(!output_filename && units.len == 1) {
 		error("no output filename provided\n");
 		usage(program_name, stderr);
-		exit(1);
+		goto compile_command_line_cleanup;
 	}
 
-	{
-		DEBUG_TRACE("Lexical analysis\n");
+	Pass_begin(&command_passes, PASS_OPEN_FILES);
+	for(size_t i = 0; i < units.len; ++i) {
+		Unit *unit = &units.data[i];
+		if(output_filename) {
+			unit->output_filename = strdup(output_filename);
+		} else if(streq(unit->source_filename, "-")) {
+			error("no output filename provided for the standard input\n");
+			usage(program_name, stderr);
+			goto compile_command_line_cleanup;
+		} else {
+			unit->output_filename = default_output_filename(unit->source_filename, emit_ast ? ".cxast" : ".c");
+		}
+		unit->file = SourceFiles_open(unit->source_filename);
+	}
+	Pass_end(&command_passes, PASS_OPEN_FILES);
+
+	if(!cache_dir) cache_dir = getenv("CX_CACHE_DIR");
+	if(cache_dir && !*cache_dir) cache_dir = NULL;
+#ifdef _WIN32
+	if(cache_dir) {
+		error("--cache-dir is not supported on Windows\n");
+		goto compile_command_line_cleanup;
+	}
+#else
+	if(cache_dir && mkdir(cache_dir, 0777) && errno != EEXIST) {
+		error("creating cache directory '%s' failed: %s\n", cache_dir, strerror(errno));
+		goto compile_command_line_cleanup;
+	}
+#endif
 
-		alloc_file_content(&source_code, source_filename, "r");
-		
-		Lexer lexer = {
-			.file_path = source_filename,
-			.source = source_code.data,
-			.source_len = source_code.len,
-			.eof = false
-		};
+	jobs = jobs < units.len ? jobs : units.len;
+	Pass_begin(&command_passes, PASS_UNITS);
+	Units_compile(jobs);
+	Pass_end(&command_passes, PASS_UNITS);
+
+	status = 0;
+	for(size_t i = 0; i < units.len; ++i) if(!units.data[i].ok) status = 1;
 
-		DARRAY_INIT(Token)(&tokens, 1);
+	size_t evicted_count = 0, evicted_bytes = 0;
+	if(cache_dir) {
+		Pass_begin(&command_passes, PASS_CACHE_EVICTION);
+		evicted_bytes = cache_evict(&evicted_count);
+		Pass_end(&command_passes, PASS_CACHE_EVICTION);
+	}
 
-		while(Lexer_is_not_empty(&lexer)) {
-			Token token = Lexer_next_token(&lexer);
-			DARRAY_PUSH(Token)(&tokens, token);
+	u64 total_wall = clock_wall_ns() - timing_origin;
+	u64 total_cpu = clock_process_cpu_ns() - cpu_origin;
+
+	if(print_stats) {
+		Unit total = { 0 };
+		size_t cache_hits = 0, main_thread_allocations = 0;
+		for(size_t i = 0; i < units.len; ++i) {
+			Unit *unit = &units.data[i];
+			total.token_count += unit->token_count;
+			total.peak_tokens = unit->peak_tokens > total.peak_tokens ? unit->peak_tokens : total.peak_tokens;
+			total.token_bytes = unit->token_bytes > total.token_bytes ? unit->token_bytes : total.token_bytes;
+			total.ast_nodes += unit->ast_nodes;
+			total.ast_bytes += unit->ast_bytes;
+			total.walk_depth = unit->walk_depth > total.walk_depth ? unit->walk_depth : total.walk_depth;
+			total.constants_folded += unit->constants_folded;
+			total.elements_computed += unit->elements_computed;
+			total.instantiations += unit->instantiations;
+			total.array_types += unit->array_types;
+			total.allocations += unit->allocations;
+			if(unit->thread == 0) main_thread_allocations += unit->allocations;
+			total.bytes_emitted += unit->bytes_emitted;
+			cache_hits += unit->cache_hit;
+		}
+		if(units.len > 1) info("files: %zu on %zu threads\n", units.len, jobs);
+		info("tokens: %zu, at most %zu in flight in %zu bytes\n", total.token_count, total.peak_tokens, total.token_bytes);
+		info("AST: %zu nodes in %zu bytes\n", total.ast_nodes, total.ast_bytes);
+		info("AST walks: at most %zu nodes deep\n", total.walk_depth);
+		info("constants: %zu operators folded, %zu array elements computed\n", total.constants_folded, total.elements_computed);
+		info("generics: %zu instantiations\n", total.instantiations);
+		info("arrays: %zu array and slice types\n", total.array_types);
+		// this thread's counter has the units it compiled in it already
+		size_t command_allocations = darray_allocations - allocations_before - main_thread_allocations;
+		info("dynamic array allocations: %zu\n", command_allocations + total.allocations);
+		info("output: %zu bytes emitted\n", total.bytes_emitted);
+		info("peak RSS: %.1f MiB%s\n", peak_rss_bytes() / (1024.0 * 1024.0), keep_results ? ", the server's since it started" : "");
+		if(cache_dir || keep_results) {
+			info("cache: %zu hits, %zu misses, %zu entries evicted (%zu bytes)\n", cache_hits, units.len - cache_hits, evicted_count, evicted_bytes);
 		}
+	}
+
+	if(time_passes) Units_report_passes(&command_passes, total_wall, total_cpu);
+
+	if(trace_filename && !Units_write_trace(trace_filename, &command_passes, jobs)) {
+		error("writing to file '%s' failed: %s\n", trace_filename, strerror(errno));
+		status = 1;
+	}
+
+compile_command_line_cleanup:
+
+	Units_free();
+	return status;
+}
+
+// Compile server
+
+// `cx --server <socket>` listens on a Unix socket and compiles the command lines forwarded by
+// `cx --connect <socket> ...`. The seed symbols, data_type_translations and the results of
+// earlier requests stay in memory, so a file compiled before costs a hash and a write. The
+// client passes its standard streams along with the request, diagnostics and --dump-ast go
+// straight to its terminal. Requests are served one at a time, in the client's working
+// directory. A reply is the request's exit status as a single byte.
+
+#define SERVER_MAX_REQUEST_SIZE (1024 * 1024)
+
+#ifdef _WIN32
+
+int server(char *socket_path) {
+	(void) socket_path;
+	error("--server is not supported on Windows\n");
+	return 1;
+}
+
+int client(char *socket_path, char *program_name, int argc, char **argv) {
+	(void) socket_path;
+	(void) program_name;
+	(void) argc;
+	(void) argv;
+	error("--connect is not supported on Windows\n");
+	return 1;
+}
+
+#else
 
-		Token eof = (Token) { 0 };
-		eof.type = TOKEN_EOF;
+bool read_all(int fd, void *data, size_t size) {
+	for(size_t done = 0; done < size;) {
+		ssize_t n = read(fd, (char*) data + done, size - done);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		done += n;
+	}
+	return true;
+}
 
-		DARRAY_PUSH(Token)(&tokens, eof);
+bool write_all(int fd, const void *data, size_t size) {
+	for(size_t done = 0; done < size;) {
+		ssize_t n = write(fd, (const char*) data + done, size - done);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		done += n;
+	}
+	return true;
+}
 
+bool socket_address(struct sockaddr_un *address, char *socket_path) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if(strlen(socket_path) >= sizeof(address->sun_path)) {
+		error("socket path too long: %s\n", socket_path);
+		return false;
 	}
+	strcpy(address->sun_path, socket_path);
+	return true;
+}
 
-	{
-		DEBUG_TRACE("Parsing\n");
+// A request is its size, sent along with the client's standard input, output and error, then
+// the client's working directory, program name and arguments, each ending with a 0
+typedef union {
+	struct cmsghdr header;
+	char buffer[CMSG_SPACE(3 * sizeof(int))];
+} Request_Control;
+
+int client(char *socket_path, char *program_name, int argc, char **argv) {
+	struct sockaddr_un address;
+	if(!socket_address(&address, socket_path)) return 1;
+
+	int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(connection < 0 || connect(connection, (struct sockaddr*) &address, sizeof(address))) {
+		error("could not connect to the server at '%s': %s\n", socket_path, strerror(errno));
+		if(connection >= 0) close(connection);
+		return 1;
+	}
 
-		Parser parser = {
-			.tokens = &tokens,
-			.cur = 0,
-			.eof = false,
-			.ok_so_far = true
-		};
+	DARRAY(char) request;
+	DARRAY_INIT(char)(&request, 4096);
+	char cwd[4096];
+	if(!getcwd(cwd, sizeof(cwd))) {
+		error("could not get the working directory: %s\n", strerror(errno));
+		DARRAY_FREE(char)(&request);
+		close(connection);
+		return 1;
+	}
+	sb_append(&request, cwd, strlen(cwd) + 1);
+	sb_append(&request, program_name, strlen(program_name) + 1);
+	for(int i = 0; i < argc; ++i) sb_append(&request, argv[i], strlen(argv[i]) + 1);
+
+	u32 size = request.len;
+	struct iovec iov = { .iov_base = &size, .iov_len = sizeof(size) };
+	Request_Control control;
+	memset(&control, 0, sizeof(control));
+	struct msghdr message = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buffer,
+		.msg_controllen = sizeof(control.buffer)
+	};
+	struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(3 * sizeof(int));
+	int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+	u8 status = 1;
+	if(sendmsg(connection, &message, 0) != sizeof(size) || !write_all(connection, request.data, request.len) || !read_all(connection, &status, 1)) {
+		error("the server at '%s' did not answer\n", socket_path);
+		status = 1;
+	}
 
-		CX_AST_Node_root(&root);
+	DARRAY_FREE(char)(&request);
+	close(connection);
+	return status;
+}
 
-		while(!parser.eof) {
-			CX_AST_Node node;
-			Parser_next_root_child(&parser, &root, &node);
-			if(node.type) {
-				DARRAY_PUSH(CX_AST_Node)((DARRAY(CX_AST_Node)*) &root.u_root, node);
-			}
-		};
+// Runs a forwarded command line, a panic only fails the request
+int server_compile(char *program_name, int argc, char **argv) {
+	jmp_buf handler;
+	panic_handler = &handler;
+	int status = 1;
+	if(setjmp(handler)) {
+		Units_free();
+	} else {
+		status = compile_command_line(program_name, argc, argv);
+	}
+	panic_handler = NULL;
+	return status;
+}
 
-		if(!parser.ok_so_far) {
-			info("Parsing failed, skipping next steps\n");
-			goto main_cleanup;
-		}
+void server_serve(int connection) {
+	u32 size;
+	struct iovec iov = { .iov_base = &size, .iov_len = sizeof(size) };
+	Request_Control control;
+	struct msghdr message = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buffer,
+		.msg_controllen = sizeof(control.buffer)
+	};
+	if(recvmsg(connection, &message, 0) != sizeof(size)) return;
 
-		if(dump_ast) {
-			CX_AST_Node_print_json(&root, stdout);
-			putc('\n', stdout);
-		}
+	struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	if(!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+		error("request without the client's standard streams\n");
+		return;
+	}
+	int fds[3];
+	memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+	char *request = size <= SERVER_MAX_REQUEST_SIZE ? malloc(size + 1) : NULL;
+	if(!request || !read_all(connection, request, size)) {
+		error("malformed request\n");
+		free(request);
+		for(int i = 0; i < 3; ++i) close(fds[i]);
+		return;
+	}
+	request[size] = 0;
+
+	size_t argc = 0;
+	char **argv = malloc((size + 1) * sizeof(char*));
+	for(size_t i = 0; i < size; i += strlen(request + i) + 1) argv[argc++] = request + i;
+
+	// the client's streams become this process' for the request
+	int saved[3];
+	for(int i = 0; i < 3; ++i) {
+		saved[i] = dup(i);
+		dup2(fds[i], i);
+		close(fds[i]);
+	}
+	clearerr(stdin);
 
+	u8 status = 1;
+	if(argc < 2) {
+		error("malformed request\n");
+	} else if(chdir(argv[0])) {
+		error("could not enter the client's working directory '%s': %s\n", argv[0], strerror(errno));
+	} else {
+		status = server_compile(argv[1], argc - 2, argv + 2);
 	}
 
-	{
-		DEBUG_TRACE("Semantic analysis\n");
+	fflush(stdout);
+	fflush(stderr);
+	for(int i = 0; i < 3; ++i) {
+		dup2(saved[i], i);
+		close(saved[i]);
+	}
 
-		HashMap_init(&data_type_translations);
-
-		HashMap_put(&data_type_translations, sv_from_cstr("b8"), sv_from_cstr("_Bool"));
-		// HashMap_put(&data_type_translations, sv_from_cstr("b32"), sv_from_cstr("int"));
-		HashMap_put(&data_type_translations, sv_from_cstr("i8"),  sv_from_cstr("signed char"));
-		HashMap_put(&data_type_translations, sv_from_cstr("i16"), sv_from_cstr("signed short"));
-		HashMap_put(&data_type_translations, sv_from_cstr("i32"), sv_from_cstr("signed int"));
-		HashMap_put(&data_type_translations, sv_from_cstr("i64"), sv_from_cstr("signed long long"));
-		HashMap_put(&data_type_translations, sv_from_cstr("u8"),  sv_from_cstr("unsigned char"));
-		HashMap_put(&data_type_translations, sv_from_cstr("u16"), sv_from_cstr("unsigned short"));
-		HashMap_put(&data_type_translations, sv_from_cstr("u32"), sv_from_cstr("unsigned int"));
-		HashMap_put(&data_type_translations, sv_from_cstr("u64"), sv_from_cstr("unsigned long long"));
-		HashMap_put(&data_type_translations, sv_from_cstr("f32"), sv_from_cstr("float"));
-		HashMap_put(&data_type_translations, sv_from_cstr("f64"), sv_from_cstr("double"));
+	write_all(connection, &status, 1);
+	free(argv);
+	free(request);
+}
 
-		SemanticStructure semantic_structure = {
-			.data_type_translations = &data_type_translations
-		};
+volatile sig_atomic_t server_stopping = 0;
 
-		analyse_semantics(&root, &semantic_structure);
+void server_stop(int signal) {
+	(void) signal;
+	server_stopping = 1;
+}
+
+int server(char *socket_path) {
+	struct sockaddr_un address;
+	if(!socket_address(&address, socket_path)) return 1;
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0) {
+		error("could not create a socket: %s\n", strerror(errno));
+		return 1;
 	}
 
-	{
-		DEBUG_TRACE("Code generation\n");
+	// a socket file left behind by a server which is gone would make bind fail
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool taken = probe >= 0 && connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0;
+	if(probe >= 0) close(probe);
+	if(taken) {
+		error("a server is already listening on '%s'\n", socket_path);
+		close(listener);
+		return 1;
+	}
+	unlink(socket_path);
 
-		CodeGenerator code_gen = {
-			.data_type_translations = &data_type_translations
-		};
+	if(bind(listener, (struct sockaddr*) &address, sizeof(address)) || listen(listener, 16)) {
+		error("could not listen on '%s': %s\n", socket_path, strerror(errno));
+		close(listener);
+		return 1;
+	}
+
+	char cwd[4096]; // requests change it, the socket path may be relative to it
+	if(!getcwd(cwd, sizeof(cwd))) {
+		error("could not get the working directory: %s\n", strerror(errno));
+		close(listener);
+		unlink(socket_path);
+		return 1;
+	}
 
-		output_fp = fopen(output_filename, "w");
+	struct sigaction action = { .sa_handler = server_stop }; // without SA_RESTART, so accept returns
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN); // clients may go away before their reply
 
-		if(!output_fp) {
-			error("writing to file '%s' failed: %s\n", output_filename, strerror(errno));
-			goto main_cleanup;
+	Results_init();
+	info("listening on '%s'\n", socket_path);
+
+	while(!server_stopping) {
+		int connection = accept(listener, NULL, NULL);
+		if(connection < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) continue;
+			error("accepting a connection failed: %s\n", strerror(errno));
+			break;
 		}
+		server_serve(connection);
+		close(connection);
+		if(chdir(cwd)) panic("could not return to '%s': %s\n", cwd, strerror(errno));
+		Results_evict();
+	}
+
+	info("stopping\n");
+	close(listener);
+	unlink(socket_path);
+	Results_free();
+	Mutex_free(&results_lock);
+	return 0;
+}
+
+#endif // _WIN32
+
+#ifndef CX_NO_MAIN
 
-		generate_code(&code_gen, &root, output_fp);
+int main(int argc, char **argv) {
+	char *program_name = consume_arg(&argc, &argv);
+	char *server_socket = NULL;
 
-		fclose(output_fp);
+	if(argc && (streq(argv[0], "--server") || streq(argv[0], "--connect"))) {
+		char *flag = consume_arg(&argc, &argv);
+		if(!argc) {
+			error("missing socket path after '%s'\n", flag);
+			usage(program_name, stderr);
+			exit(1);
+		}
+		char *socket_path = consume_arg(&argc, &argv);
+		if(streq(flag, "--connect")) return client(socket_path, program_name, argc, argv);
+		server_socket = socket_path;
+		if(argc) {
+			error("unexpected '%s' after '%s %s', options come with each request\n", argv[0], flag, socket_path);
+			usage(program_name, stderr);
+			exit(1);
+		}
 	}
 
-main_cleanup:
+	Symbols_init();
+	data_type_translations_init();
+	Symbols_seed();
+	Symbols_free(); // this thread compiles units too, with symbols of their own
 
-	if(output_fp) fclose(output_fp);
-	HashMap_free(&data_type_translations);
-	CX_AST_Node_free(root);
-	DARRAY_FREE(Token)(&tokens);
-	DARRAY_FREE(char)(&source_code);
+	int status = server_socket ? server(server_socket) : compile_command_line(program_name, argc, argv);
 
-	return 0;
+	SymbolMap_free(&data_type_translations);
+	HashMap_free(&seed_symbols);
+	return status;
 }
+
+#endif // CX_NO_MAIN
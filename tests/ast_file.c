@@ -0,0 +1,109 @@
+// Checks AST files: one written by --emit-ast compiles to the same C as the source it was written
+// from, and damaged ones are errors, never crashes nor programs made of whatever node they point at.
+//
+// Usage: tests/ast_file <source.cx>
+
+#define CX_NO_MAIN
+#include "../cx.c"
+#include "check.h"
+
+int compile(char *source_filename, char *output_filename, bool emit) {
+	char *argv[] = { "--emit-ast", source_filename, "-o", output_filename };
+	return emit ? compile_command_line("cx", 4, argv) : compile_command_line("cx", 3, argv + 1);
+}
+
+// Writes `image` damaged by `damage`, which AST files must reject
+void check_damaged(DARRAY(char) *image, char *path, const char *what, void (*damage)(char *image, CX_AST_File_Header *header, u32 node), u32 node) {
+	DARRAY(char) copy;
+	DARRAY_INIT(char)(&copy, image->len);
+	sb_append_sv(&copy, (StringView) { .data = image->data, .size = image->len });
+	damage(copy.data, (CX_AST_File_Header*) copy.data, node);
+
+	bool rejected = CX_AST_File_problem(copy.data, copy.len) != NULL;
+	if(!write_file(path, (StringView) { .data = copy.data, .size = copy.len })) panic("writing %s failed: %s\n", path, strerror(errno));
+	char output_filename[PATH_MAX];
+	snprintf(output_filename, sizeof(output_filename), "%s.c", path);
+	check(rejected && compile(path, output_filename, false) != 0, what);
+	DARRAY_FREE(char)(&copy);
+}
+
+#define SECTION(image, header, section) ((u32*) CX_AST_FILE_SECTION(header, image, section))
+
+void damage_null_root(char *image, CX_AST_File_Header *header, u32 node) {
+	(void) node;
+	header->root = 0;
+	SECTION(image, header, CX_AST_FILE_CHILDREN_COUNT)[0] = 0x7fffffff;
+}
+
+void damage_other_root(char *image, CX_AST_File_Header *header, u32 node) {
+	(void) image;
+	header->root = node;
+}
+
+void damage_second_root(char *image, CX_AST_File_Header *header, u32 node) {
+	((u8*) CX_AST_FILE_SECTION(header, image, CX_AST_FILE_KINDS))[node] = CX_AST_NODE_TYPE_ROOT;
+}
+
+void damage_root_child(char *image, CX_AST_File_Header *header, u32 node) {
+	u32 first = SECTION(image, header, CX_AST_FILE_CHILDREN_FIRST)[header->root];
+	SECTION(image, header, CX_AST_FILE_CHILDREN)[first] = node;
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s <source.cx>\n", argv[0]);
+		return 1;
+	}
+	Symbols_init();
+	data_type_translations_init();
+	Symbols_seed();
+	Symbols_free();
+
+	char directory[] = "/tmp/cx-ast-file-XXXXXX";
+	if(!mkdtemp(directory)) panic("creating a temporary directory failed: %s\n", strerror(errno));
+	char ast_filename[PATH_MAX], from_source[PATH_MAX], from_ast[PATH_MAX], damaged[PATH_MAX];
+	snprintf(ast_filename, sizeof(ast_filename), "%s/source.cxast", directory);
+	snprintf(from_source, sizeof(from_source), "%s/from_source.c", directory);
+	snprintf(from_ast, sizeof(from_ast), "%s/from_ast.c", directory);
+	snprintf(damaged, sizeof(damaged), "%s/damaged.cxast", directory);
+
+	DARRAY(char) image, expected, actual;
+	DARRAY_INIT(char)(&image, 4096);
+	DARRAY_INIT(char)(&expected, 4096);
+	DARRAY_INIT(char)(&actual, 4096);
+
+	if(compile(argv[1], ast_filename, true) || compile(argv[1], from_source, false) || compile(ast_filename, from_ast, false))
+		panic("compiling %s failed\n", argv[1]);
+	if(!read_file(ast_filename, &image) || !read_file(from_source, &expected) || !read_file(from_ast, &actual))
+		panic("reading the outputs failed: %s\n", strerror(errno));
+	check(expected.len == actual.len && memcmp(expected.data, actual.data, expected.len) == 0, "round trip gives the same C");
+
+	CX_AST_File_Header *header = (CX_AST_File_Header*) image.data;
+	u8 *kinds = CX_AST_FILE_SECTION(header, image.data, CX_AST_FILE_KINDS);
+	u32 root = header->root;
+	check_damaged(&image, damaged, "the null node as the root", damage_null_root, 0);
+	for(u32 node = 1; node < header->node_count; ++node) {
+		if(node == root) continue;
+		char what[64];
+		snprintf(what, sizeof(what), "node %u, not a root, as the root", node);
+		check_damaged(&image, damaged, what, damage_other_root, node);
+		snprintf(what, sizeof(what), "node %u made a second root", node);
+		check_damaged(&image, damaged, what, damage_second_root, node);
+		if(kinds[node] < CX_AST_NODE_TYPE_FUNCTION_DECL) {
+			snprintf(what, sizeof(what), "node %u, not a declaration, in the root", node);
+			check_damaged(&image, damaged, what, damage_root_child, node);
+		}
+	}
+
+	char command[PATH_MAX + 16];
+	snprintf(command, sizeof(command), "rm -rf '%s'", directory);
+	if(system(command)) fprintf(stderr, "removing %s failed\n", directory);
+	DARRAY_FREE(char)(&image);
+	DARRAY_FREE(char)(&expected);
+	DARRAY_FREE(char)(&actual);
+	SymbolMap_free(&data_type_translations);
+	HashMap_free(&seed_symbols);
+
+	fprintf(stderr, "%d of %d checks failed\n", failures, checks);
+	return failures != 0;
+}
@@ -0,0 +1,25 @@
+signed int sum()
+{
+	return 300;
+}
+
+signed int negated()
+{
+	return 128;
+}
+
+signed int difference()
+{
+	return (-1);
+}
+
+signed long long widened()
+{
+	return 4294967297LL;
+}
+
+_Bool converted()
+{
+	return 0;
+}
+
@@ -0,0 +1,15 @@
+unsigned char byte()
+{
+	return ((unsigned char) 0);
+}
+
+unsigned int wrapped()
+{
+	return 0u;
+}
+
+unsigned short halfword()
+{
+	return ((unsigned short) 65534);
+}
+
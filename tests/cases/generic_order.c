@@ -0,0 +1,54 @@
+signed long long even__i64(signed long long n);
+unsigned char odd__u8(unsigned char n);
+
+signed int twice__i32(signed int x)
+{
+	return x + x;
+}
+
+signed int quadruple__i32(signed int x)
+{
+	return twice__i32(twice__i32(x));
+}
+
+signed long long odd__i64(signed long long n)
+{
+	if(n == 0)
+	{
+		return 0;
+	}
+	return even__i64(n - 1);
+}
+
+signed long long even__i64(signed long long n)
+{
+	if(n == 0)
+	{
+		return 1;
+	}
+	return odd__i64(n - 1);
+}
+
+unsigned char even__u8(unsigned char n)
+{
+	if(n == 0)
+	{
+		return 1;
+	}
+	return odd__u8(n - 1);
+}
+
+unsigned char odd__u8(unsigned char n)
+{
+	if(n == 0)
+	{
+		return 0;
+	}
+	return even__u8(n - 1);
+}
+
+signed int main()
+{
+	return ((quadruple__i32(1) + twice__i32(2)) + even__i64(4)) + odd__u8(3);
+}
+
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+
+typedef struct {
+	signed int *data;
+	size_t len;
+} cx_i32_slice;
+
+static inline cx_i32_slice cx_i32_slice__slice(cx_i32_slice slice, size_t from, size_t to)
+{
+	if(from > to || to > slice.len) abort();
+	cx_i32_slice part = { slice.data + from, to - from };
+	return part;
+}
+
+typedef struct {
+	signed int *data;
+	size_t len, cap;
+} cx_i32_array;
+
+static inline void cx_i32_array__reserve(cx_i32_array *array, size_t cap)
+{
+	if(cap <= array->cap) return;
+	size_t grown = array->cap ? 2 * array->cap : 8;
+	if(grown < cap) grown = cap;
+	signed int *data = realloc(array->data, grown * sizeof(signed int));
+	if(!data) abort();
+	array->data = data;
+	array->cap = grown;
+}
+
+static inline void cx_i32_array__push(cx_i32_array *array, signed int value)
+{
+	if(array->len == array->cap) cx_i32_array__reserve(array, array->len + 1);
+	array->data[array->len++] = value;
+}
+
+static inline signed int cx_i32_array__pop(cx_i32_array *array)
+{
+	if(!array->len) abort();
+	return array->data[--array->len];
+}
+
+static inline void cx_i32_array__free(cx_i32_array *array)
+{
+	free(array->data);
+	array->data = NULL;
+	array->len = array->cap = 0;
+}
+
+static inline cx_i32_slice cx_i32_array__slice(cx_i32_array array, size_t from, size_t to)
+{
+	if(from > to || to > array.len) abort();
+	cx_i32_slice slice = { array.data + from, to - from };
+	return slice;
+}
+
+typedef struct {
+	cx_i32_array *data;
+	size_t len;
+} cx_i32_array_slice;
+
+static inline cx_i32_array_slice cx_i32_array_slice__slice(cx_i32_array_slice slice, size_t from, size_t to)
+{
+	if(from > to || to > slice.len) abort();
+	cx_i32_array_slice part = { slice.data + from, to - from };
+	return part;
+}
+
+typedef struct {
+	cx_i32_array *data;
+	size_t len, cap;
+} cx_i32_array_array;
+
+static inline void cx_i32_array_array__reserve(cx_i32_array_array *array, size_t cap)
+{
+	if(cap <= array->cap) return;
+	size_t grown = array->cap ? 2 * array->cap : 8;
+	if(grown < cap) grown = cap;
+	cx_i32_array *data = realloc(array->data, grown * sizeof(cx_i32_array));
+	if(!data) abort();
+	array->data = data;
+	array->cap = grown;
+}
+
+static inline void cx_i32_array_array__push(cx_i32_array_array *array, cx_i32_array value)
+{
+	if(array->len == array->cap) cx_i32_array_array__reserve(array, array->len + 1);
+	array->data[array->len++] = value;
+}
+
+static inline cx_i32_array cx_i32_array_array__pop(cx_i32_array_array *array)
+{
+	if(!array->len) abort();
+	return array->data[--array->len];
+}
+
+static inline void cx_i32_array_array__free(cx_i32_array_array *array)
+{
+	free(array->data);
+	array->data = NULL;
+	array->len = array->cap = 0;
+}
+
+static inline cx_i32_array_slice cx_i32_array_array__slice(cx_i32_array_array array, size_t from, size_t to)
+{
+	if(from > to || to > array.len) abort();
+	cx_i32_array_slice slice = { array.data + from, to - from };
+	return slice;
+}
+
+cx_i32_array range(signed int n)
+{
+	cx_i32_array numbers = { 0 };
+	signed int i = 0;
+	while(i < n)
+	{
+		cx_i32_array__push(&numbers, i);
+		i = (i + 1);
+	}
+	return numbers;
+}
+
+signed int main()
+{
+	cx_i32_array_array rows = { 0 };
+	cx_i32_array_array__push(&rows, range(2));
+	cx_i32_array_array__push(&rows, range(3));
+	rows.data[1].data[2] = 7;
+	cx_i32_array second = cx_i32_array_array__pop(&rows);
+	cx_i32_slice tail = cx_i32_array__slice(second, 1, 3);
+	signed int result = rows.data[0].data[1] + tail.data[1];
+	cx_i32_array__free(&second);
+	while(rows.len > 0)
+	{
+		cx_i32_array row = cx_i32_array_array__pop(&rows);
+		cx_i32_array__free(&row);
+	}
+	cx_i32_array_array__free(&rows);
+	return result;
+}
+
@@ -0,0 +1,20 @@
+// What the programs in tests/ share: counting checks, and reading back the files cx wrote.
+// Included after cx.c.
+
+int checks = 0, failures = 0;
+
+void check(bool ok, const char *what) {
+	if(!ok) fprintf(stderr, "FAILED: %s\n", what);
+	++checks;
+	failures += !ok;
+}
+
+bool read_file(const char *path, DARRAY(char) *out) {
+	FILE *fp = fopen(path, "rb");
+	if(!fp) return false;
+	out->len = 0;
+	char buffer[4096];
+	for(size_t read; (read = fread(buffer, 1, sizeof(buffer), fp)); ) sb_append_sv(out, (StringView) { .data = buffer, .size = read });
+	fclose(fp);
+	return true;
+}
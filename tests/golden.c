@@ -0,0 +1,92 @@
+// Checks what cx makes of small programs: tests/cases/name.cx compiles to exactly the C in
+// name.c next to it, or fails with exactly the diagnostics in name.err.
+//
+// Usage: tests/golden <name.cx>...
+
+#define CX_NO_MAIN
+#include "../cx.c"
+#include "check.h"
+
+#include <fcntl.h>
+
+bool same(DARRAY(char) *a, DARRAY(char) *b) {
+	return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+// Compiles `source_filename` with what it prints on stderr going to `diagnostics_filename`
+int compile(char *source_filename, char *output_filename, char *diagnostics_filename) {
+	int diagnostics = open(diagnostics_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(diagnostics < 0) panic("opening %s failed: %s\n", diagnostics_filename, strerror(errno));
+	int saved_stderr = dup(STDERR_FILENO);
+	fflush(stderr);
+	dup2(diagnostics, STDERR_FILENO);
+
+	char *argv[] = { source_filename, "-o", output_filename };
+	int status = compile_command_line("cx", 3, argv);
+
+	fflush(stderr);
+	dup2(saved_stderr, STDERR_FILENO);
+	close(saved_stderr);
+	close(diagnostics);
+	return status;
+}
+
+// name.cx's expected output, name.c or name.err, which says whether it compiles
+char *expected_filename(char *source_filename, bool *compiles) {
+	size_t len = strlen(source_filename);
+	if(len > 3 && streq(source_filename + len - 3, ".cx")) len -= 3;
+	char *filename = malloc(len + 5);
+	memcpy(filename, source_filename, len);
+	memcpy(filename + len, ".err", 5);
+	*compiles = access(filename, F_OK) != 0;
+	if(*compiles) memcpy(filename + len, ".c", 3);
+	return filename;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <name.cx>...\n", argv[0]);
+		return 1;
+	}
+	Symbols_init();
+	data_type_translations_init();
+	Symbols_seed();
+	Symbols_free();
+
+	char directory[] = "/tmp/cx-golden-XXXXXX";
+	if(!mkdtemp(directory)) panic("creating a temporary directory failed: %s\n", strerror(errno));
+	bool keep_directory = false;
+
+	DARRAY(char) expected, actual;
+	DARRAY_INIT(char)(&expected, 4096);
+	DARRAY_INIT(char)(&actual, 4096);
+
+	for(int i = 1; i < argc; ++i) {
+		char output_filename[PATH_MAX], diagnostics_filename[PATH_MAX], what[PATH_MAX + 64];
+		snprintf(output_filename, sizeof(output_filename), "%s/%d.c", directory, i);
+		snprintf(diagnostics_filename, sizeof(diagnostics_filename), "%s/%d.err", directory, i);
+
+		bool compiles;
+		char *expected_path = expected_filename(argv[i], &compiles);
+		if(!read_file(expected_path, &expected)) panic("reading %s failed: %s\n", expected_path, strerror(errno));
+
+		int status = compile(argv[i], output_filename, diagnostics_filename);
+		char *actual_path = compiles ? output_filename : diagnostics_filename;
+		bool ok = (status == 0) == compiles && read_file(actual_path, &actual) && same(&expected, &actual);
+		snprintf(what, sizeof(what), "%s %s, see %s", argv[i], compiles ? "compiles to other C" : "fails otherwise", actual_path);
+		check(ok, what);
+		keep_directory |= !ok;
+		free(expected_path);
+	}
+
+	char command[PATH_MAX + 16];
+	snprintf(command, sizeof(command), "rm -rf '%s'", directory);
+	if(!keep_directory && system(command)) fprintf(stderr, "removing %s failed\n", directory);
+	DARRAY_FREE(char)(&expected);
+	DARRAY_FREE(char)(&actual);
+	SymbolMap_free(&data_type_translations);
+	HashMap_free(&seed_symbols);
+
+	fprintf(stderr, "%d of %d checks failed\n", failures, checks);
+	return failures != 0;
+}